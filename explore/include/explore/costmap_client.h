@@ -37,7 +37,14 @@
 #ifndef COSTMAP_CLIENT_
 #define COSTMAP_CLIENT_
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <costmap_2d/costmap_2d.h>
+#include <explore/grid_view.h>
 #include <geometry_msgs/Pose.h>
 #include <map_msgs/OccupancyGridUpdate.h>
 #include <nav_msgs/OccupancyGrid.h>
@@ -47,6 +54,49 @@
 
 namespace explore
 {
+/**
+ * @brief Rectangle of map cells [x0, xn) x [y0, yn) touched by a map update
+ */
+struct MapRegion {
+  unsigned int x0, y0;
+  unsigned int xn, yn;
+};
+
+/**
+ * @brief Appends region to list of updated regions
+ * @details When the list already has max_regions regions, they are all merged
+ * to a single bounding box together with the new region.
+ */
+inline void appendRegion(std::vector<MapRegion>& regions,
+                         const MapRegion& region,
+                         std::size_t max_regions = 64)
+{
+  if (regions.size() < max_regions) {
+    regions.push_back(region);
+    return;
+  }
+
+  // too many small updates, merge them all to single bounding box
+  MapRegion bounds = region;
+  for (auto& r : regions) {
+    bounds.x0 = std::min(bounds.x0, r.x0);
+    bounds.y0 = std::min(bounds.y0, r.y0);
+    bounds.xn = std::max(bounds.xn, r.xn);
+    bounds.yn = std::max(bounds.yn, r.yn);
+  }
+  regions.clear();
+  regions.push_back(bounds);
+}
+
+/**
+ * @brief Immutable map for frontier search together with its storage
+ */
+struct MapSnapshot {
+  frontier_exploration::GridView view;
+  /// keeps data of the view alive
+  std::shared_ptr<const void> holder;
+};
+
 class Costmap2DClient
 {
 public:
@@ -90,14 +140,37 @@ public:
     return &costmap_;
   }
 
+  /**
+   * @brief Returns the latest published snapshot of the costmap
+   * @details Snapshots are published only when `double_buffered_map` parameter
+   * is set. Snapshot is never modified, so it can be used without locking.
+   * Map updates are applied to a back buffer, which is then published in place
+   * of the current snapshot. Back buffer is reused, unless some snapshot user
+   * still holds it.
+   *
+   * @return latest snapshot or nullptr if snapshots are disabled
+   */
+  std::shared_ptr<const costmap_2d::Costmap2D> getCostmapSnapshot() const;
+
+  /**
+   * @brief Returns immutable view of the latest map
+   * @details Available when `double_buffered_map` or `zero_copy_map`
+   * parameter is set. With `zero_copy_map` received maps are not translated to
+   * the costmap, view aliases raw data of the latest nav_msgs::OccupancyGrid.
+   * Partial updates are applied to copies of the received grid, which are
+   * reused in the same way as buffers of `double_buffered_map`. Costmap
+   * returned by getCostmap() stays empty in this mode.
+   *
+   * @param snapshot Filled with the view and its storage
+   * @return false if snapshots are disabled, getCostmap() must be used then
+   */
+  bool getMapSnapshot(MapSnapshot& snapshot) const;
+
   /**
    * @brief  Returns the global frame of the costmap
    * @return The global frame of the costmap
    */
-  const std::string& getGlobalFrameID() const
-  {
-    return global_frame_;
-  }
+  std::string getGlobalFrameID() const;
 
   /**
    * @brief  Returns the local frame of the costmap
@@ -108,17 +181,61 @@ public:
     return robot_base_frame_;
   }
 
+  /**
+   * @brief Returns regions of the costmap changed since the last call
+   * @details Full map update is reported as a single region covering the whole
+   * map. Regions are reported in order of arrival, but when too many of them
+   * pile up between calls they are merged to their bounding box.
+   *
+   * @return regions updated since last call
+   */
+  std::vector<MapRegion> takeUpdatedRegions();
+
 protected:
   void updateFullMap(const nav_msgs::OccupancyGrid::ConstPtr& msg);
   void updatePartialMap(const map_msgs::OccupancyGridUpdate::ConstPtr& msg);
+  void setGlobalFrameID(const std::string& frame_id);
+  // must be called with costmap locked
+  void recordUpdatedRegion(const MapRegion& region);
+  // must be called with costmap locked
+  void publishSnapshot();
+  // must be called with costmap locked
+  void updatePartialGrid(const map_msgs::OccupancyGridUpdate& msg,
+                         const MapRegion& region);
 
   costmap_2d::Costmap2D costmap_;
 
   const tf::TransformListener* const tf_;  ///< @brief Used for transforming
                                            /// point clouds
   std::string global_frame_;      ///< @brief The global frame for the costmap
+  /// protects global_frame_, map callbacks may run in different threads
+  mutable std::mutex frame_mutex_;
   std::string robot_base_frame_;  ///< @brief The frame_id of the robot base
   double transform_tolerance_;    ///< timeout before transform errors
+  /// regions updated since last takeUpdatedRegions(), protected by costmap
+  /// mutex
+  std::vector<MapRegion> updated_regions_;
+
+  bool double_buffered_;
+  /// published snapshot, accessed atomically
+  std::shared_ptr<const costmap_2d::Costmap2D> snapshot_;
+  /// front buffer is the published snapshot, back buffer is the previous one.
+  /// Buffers and their regions are protected by costmap mutex.
+  std::shared_ptr<costmap_2d::Costmap2D> front_buffer_;
+  std::shared_ptr<costmap_2d::Costmap2D> back_buffer_;
+  /// regions updated since buffers were published
+  std::vector<MapRegion> front_dirty_regions_;
+  std::vector<MapRegion> back_dirty_regions_;
+
+  bool zero_copy_;
+  /// received maps are encoded by grid_codec
+  bool compressed_;
+  /// latest received or updated grid, accessed atomically
+  nav_msgs::OccupancyGrid::ConstPtr grid_;
+  /// updated copies of received grid, front grid is published unless received
+  /// grid is. Grids share dirty regions with buffers of double buffered mode.
+  nav_msgs::OccupancyGrid::Ptr front_grid_;
+  nav_msgs::OccupancyGrid::Ptr back_grid_;
 
 private:
   // will be unsubscribed at destruction
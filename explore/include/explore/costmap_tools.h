@@ -1,6 +1,12 @@
 #ifndef COSTMAP_TOOLS_H_
 #define COSTMAP_TOOLS_H_
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 #include <costmap_2d/costmap_2d.h>
 #include <geometry_msgs/PointStamped.h>
 #include <geometry_msgs/PolygonStamped.h>
@@ -8,6 +14,252 @@
 
 namespace frontier_exploration
 {
+/**
+ * @brief Neighbourhood of a cell stored in place
+ * @details Holds at most N cell indexes and never allocates, so it can be used
+ * in the innermost loops of map searches.
+ */
+template <std::size_t N>
+class CellNeighbourhood
+{
+public:
+  CellNeighbourhood() : size_(0)
+  {
+  }
+
+  void push_back(unsigned int idx)
+  {
+    cells_[size_++] = idx;
+  }
+
+  const unsigned int* begin() const
+  {
+    return cells_.data();
+  }
+
+  const unsigned int* end() const
+  {
+    return cells_.data() + size_;
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+private:
+  std::array<unsigned int, N> cells_;
+  std::size_t size_;
+};
+
+/**
+ * @brief Flags over map cells which can be cleared in constant time
+ * @details Each cell stores generation in which it was flagged. Clearing all
+ * flags just starts new generation, storage is wiped only when 16-bit
+ * generation counter wraps around, once per 65535 clears.
+ */
+class CellFlags
+{
+public:
+  CellFlags() : generation_(1), allocations_(0)
+  {
+  }
+
+  /**
+   * @brief Clears all flags and sets number of cells
+   * @details Allocates only when the number of cells changes.
+   */
+  void reset(std::size_t cells)
+  {
+    if (stamps_.size() != cells) {
+      if (stamps_.capacity() < cells) {
+        ++allocations_;
+      }
+      stamps_.assign(cells, 0);
+      generation_ = 1;
+      return;
+    }
+    ++generation_;
+    if (generation_ == 0) {
+      std::fill(stamps_.begin(), stamps_.end(), 0);
+      generation_ = 1;
+    }
+  }
+
+  bool test(unsigned int idx) const
+  {
+    return stamps_[idx] == generation_;
+  }
+
+  void set(unsigned int idx)
+  {
+    stamps_[idx] = generation_;
+  }
+
+  /// number of times storage has been allocated
+  std::size_t allocations() const
+  {
+    return allocations_;
+  }
+
+private:
+  std::vector<std::uint16_t> stamps_;
+  std::uint16_t generation_;
+  std::size_t allocations_;
+};
+
+/**
+ * @brief FIFO queue of cell indexes in a preallocated ring buffer
+ * @details Capacity is set by reset(). Pushing more cells than the capacity is
+ * not allowed, which is never needed for searches pushing each cell at most
+ * once.
+ */
+class CellQueue
+{
+public:
+  CellQueue() : head_(0), size_(0), allocations_(0)
+  {
+  }
+
+  /**
+   * @brief Empties the queue and ensures capacity
+   * @details Allocates only when capacity needs to grow.
+   */
+  void reset(std::size_t capacity)
+  {
+    if (buffer_.size() < capacity) {
+      ++allocations_;
+      buffer_.resize(capacity);
+    }
+    head_ = 0;
+    size_ = 0;
+  }
+
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+
+  unsigned int front() const
+  {
+    return buffer_[head_];
+  }
+
+  void push(unsigned int idx)
+  {
+    std::size_t tail = head_ + size_;
+    if (tail >= buffer_.size()) {
+      tail -= buffer_.size();
+    }
+    buffer_[tail] = idx;
+    ++size_;
+  }
+
+  void pop()
+  {
+    ++head_;
+    if (head_ == buffer_.size()) {
+      head_ = 0;
+    }
+    --size_;
+  }
+
+  /// number of times storage has been allocated
+  std::size_t allocations() const
+  {
+    return allocations_;
+  }
+
+private:
+  std::vector<unsigned int> buffer_;
+  std::size_t head_;
+  std::size_t size_;
+  std::size_t allocations_;
+};
+
+/**
+ * @brief Determine 4-connected neighbourhood of an input cell, checking for map
+ * edges
+ * @details Does not allocate. Neighbours are in the same order as returned by
+ * nhood4(unsigned int, const costmap_2d::Costmap2D&). Input cell must lie
+ * inside the map.
+ *
+ * @param idx input cell index
+ * @param size_x width of the map in cells
+ * @param size_y height of the map in cells
+ * @return neighbour cell indexes
+ */
+inline CellNeighbourhood<4> nhood4(unsigned int idx, unsigned int size_x,
+                                   unsigned int size_y)
+{
+  CellNeighbourhood<4> out;
+  unsigned int x = idx % size_x;
+
+  if (x > 0) {
+    out.push_back(idx - 1);
+  }
+  if (x < size_x - 1) {
+    out.push_back(idx + 1);
+  }
+  if (idx >= size_x) {
+    out.push_back(idx - size_x);
+  }
+  if (idx < size_x * (size_y - 1)) {
+    out.push_back(idx + size_x);
+  }
+  return out;
+}
+
+/**
+ * @brief Determine 8-connected neighbourhood of an input cell, checking for map
+ * edges
+ * @details Does not allocate. Neighbours are in the same order as returned by
+ * nhood8(unsigned int, const costmap_2d::Costmap2D&). Input cell must lie
+ * inside the map.
+ *
+ * @param idx input cell index
+ * @param size_x width of the map in cells
+ * @param size_y height of the map in cells
+ * @return neighbour cell indexes
+ */
+inline CellNeighbourhood<8> nhood8(unsigned int idx, unsigned int size_x,
+                                   unsigned int size_y)
+{
+  CellNeighbourhood<8> out;
+  unsigned int x = idx % size_x;
+  // edge checks are evaluated only once for all neighbours
+  bool left = x > 0;
+  bool right = x < size_x - 1;
+  bool up = idx >= size_x;
+  bool down = idx < size_x * (size_y - 1);
+
+  if (left) {
+    out.push_back(idx - 1);
+  }
+  if (right) {
+    out.push_back(idx + 1);
+  }
+  if (up) {
+    out.push_back(idx - size_x);
+  }
+  if (down) {
+    out.push_back(idx + size_x);
+  }
+  if (left && up) {
+    out.push_back(idx - 1 - size_x);
+  }
+  if (left && down) {
+    out.push_back(idx - 1 + size_x);
+  }
+  if (right && up) {
+    out.push_back(idx + 1 - size_x);
+  }
+  if (right && down) {
+    out.push_back(idx + 1 + size_x);
+  }
+  return out;
+}
+
 /**
  * @brief Determine 4-connected neighbourhood of an input cell, checking for map
  * edges
@@ -15,7 +267,7 @@ namespace frontier_exploration
  * @param costmap Reference to map data
  * @return neighbour cell indexes
  */
-std::vector<unsigned int> nhood4(unsigned int idx,
+inline std::vector<unsigned int> nhood4(unsigned int idx,
                                  const costmap_2d::Costmap2D& costmap)
 {
   // get 4-connected neighbourhood indexes, check for edge of map
@@ -51,7 +303,7 @@ std::vector<unsigned int> nhood4(unsigned int idx,
  * @param costmap Reference to map data
  * @return neighbour cell indexes
  */
-std::vector<unsigned int> nhood8(unsigned int idx,
+inline std::vector<unsigned int> nhood8(unsigned int idx,
                                  const costmap_2d::Costmap2D& costmap)
 {
   // get 8-connected neighbourhood indexes, check for edge of map
@@ -82,14 +334,21 @@ std::vector<unsigned int> nhood8(unsigned int idx,
 
 /**
  * @brief Find nearest cell of a specified value
+ * @details Uses provided storage for the search, which does not allocate once
+ * the storage is big enough for the map.
+ *
  * @param result Index of located cell
  * @param start Index initial cell to search from
  * @param val Specified value to search for
- * @param costmap Reference to map data
+ * @param costmap Reference to map data, costmap_2d::Costmap2D or a map with
+ * the same interface
+ * @param visited_flag Storage for flags of visited cells
+ * @param bfs Storage for the search queue
  * @return True if a cell with the requested value was found
  */
+template <typename Map>
 bool nearestCell(unsigned int& result, unsigned int start, unsigned char val,
-                 const costmap_2d::Costmap2D& costmap)
+                 const Map& costmap, CellFlags& visited_flag, CellQueue& bfs)
 {
   const unsigned char* map = costmap.getCharMap();
   const unsigned int size_x = costmap.getSizeInCellsX(),
@@ -100,12 +359,12 @@ bool nearestCell(unsigned int& result, unsigned int start, unsigned char val,
   }
 
   // initialize breadth first search
-  std::queue<unsigned int> bfs;
-  std::vector<bool> visited_flag(size_x * size_y, false);
+  bfs.reset(size_x * size_y);
+  visited_flag.reset(size_x * size_y);
 
   // push initial cell
   bfs.push(start);
-  visited_flag[start] = true;
+  visited_flag.set(start);
 
   // search for neighbouring cell matching value
   while (!bfs.empty()) {
@@ -119,15 +378,31 @@ bool nearestCell(unsigned int& result, unsigned int start, unsigned char val,
     }
 
     // iterate over all adjacent unvisited cells
-    for (unsigned nbr : nhood8(idx, costmap)) {
-      if (!visited_flag[nbr]) {
+    for (unsigned nbr : nhood8(idx, size_x, size_y)) {
+      if (!visited_flag.test(nbr)) {
         bfs.push(nbr);
-        visited_flag[nbr] = true;
+        visited_flag.set(nbr);
       }
     }
   }
 
   return false;
 }
+
+/**
+ * @brief Find nearest cell of a specified value
+ * @param result Index of located cell
+ * @param start Index initial cell to search from
+ * @param val Specified value to search for
+ * @param costmap Reference to map data
+ * @return True if a cell with the requested value was found
+ */
+inline bool nearestCell(unsigned int& result, unsigned int start,
+                        unsigned char val, const costmap_2d::Costmap2D& costmap)
+{
+  CellFlags visited_flag;
+  CellQueue bfs;
+  return nearestCell(result, start, val, costmap, visited_flag, bfs);
+}
 }
 #endif
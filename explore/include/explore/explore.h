@@ -37,9 +37,15 @@
 #ifndef NAV_EXPLORE_H_
 #define NAV_EXPLORE_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <actionlib/client/simple_action_client.h>
@@ -49,6 +55,7 @@
 #include <visualization_msgs/MarkerArray.h>
 
 #include <explore/costmap_client.h>
+#include <explore/frontier_blacklist.h>
 #include <explore/frontier_search.h>
 
 namespace explore
@@ -73,8 +80,29 @@ private:
    */
   void makePlan();
 
+  /**
+   * @brief Makes single planning attempt
+   * @return true if goal was blacklisted and planning should be repeated
+   */
+  bool planOnce();
+
+  /**
+   * @brief Asks planner thread to run makePlan()
+   * @details Does not block, requests arriving while planner is busy are
+   * coalesced into a single planning.
+   */
+  void requestPlan();
+
+  /**
+   * @brief Body of planner thread
+   */
+  void plannerLoop();
+
   /**
    * @brief  Publish a frontiers as markers
+   * @details Frontiers keep their marker ids between calls, only markers of
+   * added, changed or removed frontiers are published. All markers are
+   * published again when a new subscriber connects.
    */
   void visualizeFrontiers(
       const std::vector<frontier_exploration::Frontier>& frontiers);
@@ -85,9 +113,15 @@ private:
 
   bool goalOnBlacklist(const geometry_msgs::Point& goal);
 
+  /**
+   * @brief Publishes statistics of hot paths as diagnostics
+   */
+  void publishStats();
+
   ros::NodeHandle private_nh_;
   ros::NodeHandle relative_nh_;
   ros::Publisher marker_array_publisher_;
+  ros::Publisher stats_publisher_;
   tf::TransformListener tf_listener_;
 
   Costmap2DClient costmap_client_;
@@ -95,13 +129,39 @@ private:
       move_base_client_;
   frontier_exploration::FrontierSearch search_;
   ros::Timer exploring_timer_;
-  ros::Timer oneshot_;
+  ros::Timer stats_timer_;
 
-  std::vector<geometry_msgs::Point> frontier_blacklist_;
+  FrontierBlacklist frontier_blacklist_;
   geometry_msgs::Point prev_goal_;
   double prev_distance_;
+  // resolution of the map searched by the last planning
+  double map_resolution_;
   ros::Time last_progress_;
-  size_t last_markers_count_;
+
+  // state of published frontier markers
+  struct FrontierMarker {
+    std::uint64_t fingerprint;
+    bool blacklisted;
+    double scale;
+    geometry_msgs::Point initial;
+  };
+  // published frontiers by their ids
+  std::unordered_map<int, FrontierMarker> frontier_markers_;
+  // sorted pairs (cell, frontier id) of published frontiers
+  std::vector<std::pair<std::uint32_t, int>> marker_cells_;
+  int next_marker_id_;
+  int max_marker_points_;
+  // set by subscriber connection, all markers are published again
+  std::atomic<bool> resend_markers_;
+
+  // planner thread, state above is used only by this thread
+  std::thread planner_thread_;
+  std::mutex planner_mutex_;
+  std::condition_variable planner_cv_;
+  /// protected by planner_mutex_
+  bool plan_requested_;
+  bool planner_shutdown_;
+  std::vector<geometry_msgs::Point> aborted_goals_;
 
   // parameters
   double planner_frequency_;
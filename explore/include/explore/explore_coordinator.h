@@ -0,0 +1,135 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef EXPLORE_COORDINATOR_H_
+#define EXPLORE_COORDINATOR_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <actionlib/client/simple_action_client.h>
+#include <geometry_msgs/Point.h>
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <move_base_msgs/MoveBaseAction.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <ros/ros.h>
+#include <tf/transform_listener.h>
+
+#include <explore/frontier_assignment.h>
+#include <explore/frontier_blacklist.h>
+#include <explore/frontier_search.h>
+
+namespace explore
+{
+/**
+ * @class ExploreCoordinator
+ * @brief Explores environment with multiple robots sharing a single map
+ * @details Frontiers are searched once in the shared map, usually the map
+ * merged by map_merge, and assigned to robots in a single assignment
+ * minimizing the total cost. Each frontier is explored by at most one robot.
+ */
+class ExploreCoordinator
+{
+public:
+  ExploreCoordinator();
+  ~ExploreCoordinator();
+
+  void start();
+  void stop();
+
+private:
+  typedef actionlib::SimpleActionClient<move_base_msgs::MoveBaseAction>
+      MoveBaseClient;
+
+  struct Robot {
+    std::string name;
+    std::string base_frame;
+    std::unique_ptr<MoveBaseClient> move_base_client;
+    GoalProgress progress;
+  };
+
+  void mapReceived(const nav_msgs::OccupancyGrid::ConstPtr& msg);
+
+  /**
+   * @brief Applies partial update to the received map
+   * @details Received map is copied on the first update, it is shared with
+   * other subscribers. Updated region is searched again on the next plan.
+   */
+  void mapUpdateReceived(const map_msgs::OccupancyGridUpdate::ConstPtr& msg);
+
+  /**
+   * @brief Searches frontiers and assigns them to robots
+   */
+  void makePlan();
+
+  /**
+   * @brief Looks up position of the robot in the map frame
+   * @return false if transform is not available
+   */
+  bool robotPosition(const Robot& robot, const std::string& global_frame,
+                     geometry_msgs::Point& position) const;
+
+  /**
+   * @brief Sends goal of the robot to its move_base
+   */
+  void sendGoal(size_t robot, const std::string& global_frame);
+  void reachedGoal(size_t robot, const actionlib::SimpleClientGoalState& status,
+                   const geometry_msgs::Point& frontier_goal);
+
+  ros::NodeHandle private_nh_;
+  ros::NodeHandle relative_nh_;
+  tf::TransformListener tf_listener_;
+  ros::Subscriber map_subscriber_;
+  ros::Subscriber map_updates_subscriber_;
+  ros::Timer exploring_timer_;
+
+  nav_msgs::OccupancyGrid::ConstPtr map_;
+  // copy of map_ modified by updates, null until the first update
+  nav_msgs::OccupancyGrid::Ptr updated_map_;
+  // regions of map_ changed since the last search
+  std::vector<MapRegion> updated_regions_;
+  frontier_exploration::FrontierSearch search_;
+  FrontierBlacklist frontier_blacklist_;
+  std::vector<Robot> robots_;
+
+  double planner_frequency_;
+  double potential_scale_, gain_scale_;
+  ros::Duration progress_timeout_;
+  double transform_tolerance_;
+};
+}
+
+#endif
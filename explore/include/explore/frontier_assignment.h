@@ -0,0 +1,136 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef FRONTIER_ASSIGNMENT_H_
+#define FRONTIER_ASSIGNMENT_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <ros/time.h>
+
+#include <explore/frontier_search.h>
+
+namespace explore
+{
+/**
+ * @brief Assigns frontiers to robots minimizing the total cost
+ * @details Solves the rectangular assignment problem with the Hungarian
+ * algorithm in O(n^2 m) time, where n is the smaller and m the larger
+ * dimension of the matrix. Each robot gets at most one frontier and each
+ * frontier at most one robot. When there are fewer frontiers than robots, some
+ * robots stay unassigned.
+ *
+ * @param costs Row-major robots x frontiers matrix, costs[r * frontiers + f]
+ * is the cost of robot r exploring frontier f
+ * @param robots Number of robots
+ * @param frontiers Number of frontiers
+ * @return Index of frontier for each robot, -1 for unassigned robots
+ */
+std::vector<int> assignFrontiers(const std::vector<double>& costs,
+                                 std::size_t robots, std::size_t frontiers);
+
+/**
+ * @brief Distance from position to the closest cell of frontier
+ */
+double frontierDistance(const frontier_exploration::Frontier& frontier,
+                        const geometry_msgs::Point& position);
+
+/**
+ * @brief Computes robots x frontiers cost matrix for assignFrontiers()
+ * @details Cost is the same as in the single robot exploration, but the
+ * distance is measured from each robot to the closest cell of the frontier.
+ *
+ * @param frontiers Frontiers found in the map
+ * @param positions Positions of robots
+ * @param potential_scale Weight of the distance
+ * @param gain_scale Weight of the frontier size
+ * @param distances Distances of robots to frontiers, in the same layout as
+ * costs
+ * @return Row-major robots x frontiers matrix of costs
+ */
+std::vector<double>
+frontierCosts(const std::vector<frontier_exploration::Frontier>& frontiers,
+              const std::vector<geometry_msgs::Point>& positions,
+              double potential_scale, double gain_scale,
+              std::vector<double>& distances);
+
+/**
+ * @brief Whether two goals are the same, up to 1 cm
+ */
+bool sameGoal(const geometry_msgs::Point& one, const geometry_msgs::Point& two);
+
+/**
+ * @brief Goal of a robot and progress of the robot towards it
+ */
+struct GoalProgress {
+  GoalProgress() : has_goal(false), prev_distance(0.)
+  {
+  }
+
+  bool has_goal;
+  geometry_msgs::Point goal;
+  double prev_distance;
+  ros::Time last_progress;
+};
+
+/**
+ * @brief What should happen with the goal of a robot
+ */
+enum class GoalAction { KEEP, SEND, CANCEL, BLACKLIST };
+
+/**
+ * @brief Decides what to do with the goal of a robot after assignment
+ * @details Robot without an assigned frontier cancels its goal, it must not
+ * chase frontiers of other robots. Target is blacklisted when the robot has
+ * made no progress for progress_timeout, the frontier is then reassigned by
+ * the next planning. Otherwise target is sent when it differs from the current
+ * goal.
+ *
+ * @param progress Goal of the robot, updated to the goal after the action
+ * @param target Assigned target, nullptr when robot has no frontier assigned
+ * @param distance Distance of the robot to the target
+ * @param now Current time
+ * @param progress_timeout Time allowed without getting closer to the target
+ * @return Action to be executed
+ */
+GoalAction dispatchGoal(GoalProgress& progress,
+                        const geometry_msgs::Point* target, double distance,
+                        const ros::Time& now,
+                        const ros::Duration& progress_timeout);
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef FRONTIER_BLACKLIST_H_
+#define FRONTIER_BLACKLIST_H_
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <ros/ros.h>
+
+namespace explore
+{
+/**
+ * @brief Set of goals which should not be pursued anymore
+ * @details Goal is blacklisted when it is closer than tolerance to some
+ * blacklisted goal in both axes. Goals are indexed in a uniform hash grid with
+ * buckets of the tolerance size, so lookup checks only the 3x3 neighbouring
+ * buckets. Old goals are removed after timeout or when there are too many of
+ * them.
+ */
+class FrontierBlacklist
+{
+public:
+  /**
+   * @brief Constructs empty blacklist
+   *
+   * @param tolerance_cells Tolerance in map cells
+   * @param timeout Goals older than timeout are removed by expire(), zero
+   * keeps goals forever
+   * @param max_entries Oldest goals are removed when there is more goals, zero
+   * for unlimited blacklist
+   */
+  FrontierBlacklist(double tolerance_cells = 5.,
+                    ros::Duration timeout = ros::Duration(0),
+                    size_t max_entries = 0);
+
+  /**
+   * @brief Sets resolution of the map, tolerance is resolution *
+   * tolerance_cells
+   * @details Index is rebuilt when resolution changes. Nothing is blacklisted
+   * until resolution is set.
+   */
+  void setResolution(double resolution);
+
+  /**
+   * @brief Blacklists goal
+   *
+   * @param goal Goal in the map frame
+   * @param stamp Time when goal was blacklisted
+   */
+  void add(const geometry_msgs::Point& goal, const ros::Time& stamp);
+
+  /**
+   * @brief Checks whether goal is close to some of blacklisted goals
+   */
+  bool contains(const geometry_msgs::Point& goal) const;
+
+  /**
+   * @brief Removes goals blacklisted before now - timeout
+   */
+  void expire(const ros::Time& now);
+
+  size_t size() const
+  {
+    return entries_.size();
+  }
+
+  void clear();
+
+private:
+  struct Entry {
+    geometry_msgs::Point goal;
+    ros::Time stamp;
+  };
+
+  std::uint64_t bucketKey(const geometry_msgs::Point& goal, int dx = 0,
+                          int dy = 0) const;
+  void index(std::uint64_t id);
+  void removeOldest();
+
+  double tolerance_cells_;
+  ros::Duration timeout_;
+  size_t max_entries_;
+  double tolerance_;
+
+  // entries ordered by age, entry id is first_id_ + position in deque
+  std::deque<Entry> entries_;
+  std::uint64_t first_id_;
+  // ids of entries in each bucket, in order of age
+  std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> buckets_;
+};
+
+}  // namespace explore
+
+#endif
@@ -1,26 +1,148 @@
 #ifndef FRONTIER_SEARCH_H_
 #define FRONTIER_SEARCH_H_
 
+#include <functional>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include <costmap_2d/costmap_2d.h>
 #include <explore/costmap_client.h>
-
+#include <explore/costmap_tools.h>
+#include <explore/grid_view.h>
+#include <explore_common/worker_pool.h>
 
 namespace frontier_exploration
 {
+/**
+ * @brief Cells of all frontiers found by one search
+ * @details Frontiers reference spans of cell indexes in the arena, the arena
+ * lives as long as any of them. Grid describes geometry of the searched map,
+ * its data are not referenced.
+ */
+struct FrontierArena {
+  std::vector<std::uint32_t> cells;
+  GridView grid;
+};
+
 /**
  * @brief Represents a frontier
- *
+ * @details Frontier stores only statistics and a span of its cells in the
+ * arena, copying it is cheap. World coordinates of cells are computed by
+ * points() when they are needed.
  */
 struct Frontier {
+  Frontier()
+    : size(0), min_distance(0.), cost(0.), first_cell(0)
+  {
+  }
+
   std::uint32_t size;
   double min_distance;
   double cost;
   geometry_msgs::Point initial;
   geometry_msgs::Point centroid;
   geometry_msgs::Point middle;
-  std::vector<geometry_msgs::Point> points;
+  // frontier cells are arena->cells[first_cell, first_cell + size)
+  std::shared_ptr<const FrontierArena> arena;
+  std::uint32_t first_cell;
+
+  const std::uint32_t* cellsBegin() const
+  {
+    return arena->cells.data() + first_cell;
+  }
+
+  const std::uint32_t* cellsEnd() const
+  {
+    return cellsBegin() + size;
+  }
+
+  /**
+   * @brief Computes world coordinates of frontier cells
+   * @param max_points Cells are decimated to at most max_points evenly spaced
+   * cells, 0 for all cells
+   * @return centres of frontier cells
+   */
+  std::vector<geometry_msgs::Point> points(std::size_t max_points = 0) const
+  {
+    std::size_t step = 1;
+    if (max_points > 0 && size > max_points) {
+      step = (size + max_points - 1) / max_points;
+    }
+    std::vector<geometry_msgs::Point> result;
+    result.reserve((size + step - 1) / step);
+    for (const std::uint32_t* cell = cellsBegin(); cell < cellsEnd();
+         cell += step) {
+      unsigned int mx, my;
+      geometry_msgs::Point point;
+      arena->grid.indexToCells(*cell, mx, my);
+      arena->grid.mapToWorld(mx, my, point.x, point.y);
+      result.push_back(point);
+    }
+    return result;
+  }
+};
+
+/**
+ * @brief Storage reused by FrontierSearch between searches
+ * @details Storage is sized by the first search on the map, following searches
+ * on the map of the same size do not allocate.
+ */
+struct SearchWorkspace {
+  SearchWorkspace() : vector_allocations(0)
+  {
+  }
+
+  CellFlags visited_flag;
+  CellFlags frontier_flag;
+  CellQueue bfs;
+  CellQueue frontier_bfs;
+  // used by incremental search
+  std::vector<unsigned int> seeds;
+  std::vector<unsigned int> stack;
+  // frontier candidates marked by markFrontierCandidates()
+  std::vector<std::uint8_t> candidates;
+  // used by parallel search
+  std::vector<std::uint8_t> cell_class;
+  std::vector<unsigned int> parent;
+  std::vector<std::vector<unsigned int>> tile_frontier_cells;
+  // pairs (component root, cell) of frontier cells and of frontier cells
+  // touching reachable free space
+  std::vector<std::vector<std::pair<unsigned int, unsigned int>>> tile_groups;
+  std::vector<std::vector<std::pair<unsigned int, unsigned int>>> tile_contacts;
+  std::vector<std::pair<unsigned int, unsigned int>> frontier_groups;
+  std::vector<std::pair<unsigned int, unsigned int>> frontier_contacts;
+  // hop distance of cells visited by breadth-first search from the start
+  std::vector<unsigned int> distance;
+  // used by hierarchical search, class of each block of all coarse levels,
+  // where the levels start in block_class, their widths and visited uniformly
+  // free blocks
+  std::vector<std::uint8_t> block_class;
+  std::vector<std::size_t> level_offsets;
+  std::vector<unsigned int> level_widths;
+  CellFlags block_visited;
+  // number of times any of the vectors above grew
+  std::size_t vector_allocations;
 };
 
+/**
+ * @brief Strategy used to find frontiers in the costmap
+ * @details BFS runs breadth-first search over the whole reachable space on
+ * every search. INCREMENTAL keeps frontiers between searches and updates them
+ * only in regions reported by markUpdated(), all frontiers are rebuilt when
+ * size, origin or resolution of the map changes. Unlike other modes, it does
+ * not check whether frontiers are reachable from the position, it finds
+ * frontiers in the whole map. PARALLEL splits the map to tiles and labels
+ * frontier cells and free space in multiple threads. HIERARCHICAL keeps a
+ * pyramid of coarse levels of the map, where each block records whether it
+ * contains free, unknown or other cells. The largest blocks containing only
+ * free space are crossed at once, other blocks are searched at full
+ * resolution.
+ */
+enum class SearchMode { BFS, INCREMENTAL, PARALLEL, HIERARCHICAL };
+
 /**
  * @brief Thread-safe implementation of a frontier-search task for an input
  * costmap.
@@ -35,9 +157,19 @@ public:
   /**
    * @brief Constructor for search task
    * @param costmap Reference to costmap data to search.
+   * @param mode Strategy used for finding frontiers
+   * @param threads Number of threads used by parallel and hierarchical
+   * search, 0 to use all available cores
+   * @param block_size Size of square blocks of the finest coarse level used
+   * by hierarchical search, in cells
+   * @param geodesic_distance Use distance through free space instead of
+   * straight-line distance for Frontier::min_distance and Frontier::middle,
+   * used only by BFS search
    */
   FrontierSearch(costmap_2d::Costmap2D* costmap, double potential_scale,
-                 double gain_scale, double min_frontier_size);
+                 double gain_scale, double min_frontier_size,
+                 SearchMode mode = SearchMode::BFS, unsigned int threads = 0,
+                 unsigned int block_size = 16, bool geodesic_distance = false);
 
   /**
    * @brief Runs search implementation, outward from the start position
@@ -46,29 +178,100 @@ public:
    */
   std::vector<Frontier> searchFrom(geometry_msgs::Point position);
 
+  /**
+   * @brief Runs search on the given map, outward from the start position
+   * @details Map is not locked, it must not change during the search. Map
+   * should have the same size as the map given in constructor, usually it is
+   * a snapshot of it.
+   *
+   * @param costmap Map to search
+   * @param position Initial position to search from
+   * @return List of frontiers, if any
+   */
+  std::vector<Frontier> searchFrom(const costmap_2d::Costmap2D& costmap,
+                                   geometry_msgs::Point position);
+
+  /**
+   * @brief Runs search on the given grid, outward from the start position
+   * @details Same as searchFrom() for costmap, grid can alias raw occupancy
+   * grid data.
+   *
+   * @param grid Map to search
+   * @param position Initial position to search from
+   * @return List of frontiers, if any
+   */
+  std::vector<Frontier> searchFrom(const GridView& grid,
+                                   geometry_msgs::Point position);
+
+  /**
+   * @brief Predicate for frontiers, which should be skipped
+   */
+  typedef std::function<bool(const Frontier&)> FrontierFilter;
+
+  /**
+   * @brief Runs search and returns only the best frontiers
+   * @details Rejected frontiers are dropped before their cost is computed and
+   * only the best k frontiers are sorted, rest is discarded.
+   *
+   * @param position Initial position to search from
+   * @param k Maximum number of returned frontiers
+   * @param reject Frontiers for which reject returns true are skipped, may be
+   * empty
+   * @return Best frontiers sorted according to cost
+   */
+  std::vector<Frontier> searchBest(geometry_msgs::Point position, size_t k,
+                                   const FrontierFilter& reject);
+
+  /**
+   * @brief Runs search on the given grid and returns only the best frontiers
+   * @details Same as searchBest() for costmap given in constructor.
+   */
+  std::vector<Frontier> searchBest(const GridView& grid,
+                                   geometry_msgs::Point position, size_t k,
+                                   const FrontierFilter& reject);
+
+  /**
+   * @brief Notifies search about changed regions of the costmap
+   * @details Used only in incremental mode, where frontiers are updated only in
+   * these regions during next search. Whole costmap is searched again if its
+   * size changes.
+   *
+   * @param regions regions updated since last call
+   */
+  void markUpdated(const std::vector<explore::MapRegion>& regions);
+
+  /**
+   * @brief Number of allocations made by internal search storage
+   * @details Search storage is reused between searches. This counter should
+   * stay constant for searches on the map of the same size. Returned frontiers
+   * are not part of the search storage.
+   *
+   * @return number of allocations since construction
+   */
+  std::size_t workspaceAllocations() const;
+
 protected:
   /**
    * @brief Starting from an initial cell, build a frontier from valid adjacent
    * cells
    * @param initial_cell Index of cell to start frontier building
    * @param reference Reference index to calculate position from
-   * @param frontier_flag Flag vector indicating which cells are already marked
-   * as frontiers
+   * @param frontier_flag Flags indicating which cells are already marked as
+   * frontiers
    * @return new frontier
    */
   Frontier buildNewFrontier(unsigned int initial_cell, unsigned int reference,
-                            std::vector<bool>& frontier_flag);
+                            CellFlags& frontier_flag);
 
   /**
    * @brief isNewFrontierCell Evaluate if candidate cell is a valid candidate
    * for a new frontier.
    * @param idx Index of candidate cell
-   * @param frontier_flag Flag vector indicating which cells are already marked
-   * as frontiers
+   * @param frontier_flag Flags indicating which cells are already marked as
+   * frontiers
    * @return true if the cell is frontier cell
    */
-  bool isNewFrontierCell(unsigned int idx,
-                         const std::vector<bool>& frontier_flag);
+  bool isNewFrontierCell(unsigned int idx, const CellFlags& frontier_flag);
 
   /**
    * @brief computes frontier cost
@@ -79,12 +282,126 @@ protected:
    */
   double frontierCost(const Frontier& frontier, geometry_msgs::Point pose);
 
+  /**
+   * @brief Finds frontiers in grid, their cost is not computed
+   */
+  std::vector<Frontier> findFrontiers(const GridView& grid,
+                                      geometry_msgs::Point position);
+
+  /**
+   * @brief Breadth-first search implementation
+   * @details With geodesic distance, hop count of breadth-first search is
+   * recorded for visited cells. The first cell found on each frontier is
+   * the closest one through free space, it becomes its middle.
+   *
+   * @param pos Index of the robot position to search from
+   * @return List of frontiers, if any
+   */
+  std::vector<Frontier> searchBfs(unsigned int pos);
+
+  /**
+   * @brief Parallel search implementation
+   * @details Classifies cells and labels connected components of frontier
+   * cells and free space in parallel for each tile, components are then merged
+   * across tile borders. Frontiers are reported only if they touch free space
+   * connected to the robot.
+   *
+   * @param pos Index of the robot position to search from
+   * @return List of frontiers, if any
+   */
+  std::vector<Frontier> searchParallel(unsigned int pos);
+
+  /**
+   * @brief Hierarchical search implementation
+   * @details Builds coarse levels of the map and runs breadth-first search
+   * which visits the largest uniformly free block containing a cell at once,
+   * only cells around its border are examined. Finds the same frontiers as
+   * searchBfs().
+   *
+   * @param pos Index of the robot position to search from
+   * @return List of frontiers, if any
+   */
+  std::vector<Frontier> searchHierarchical(unsigned int pos);
+
+  /**
+   * @brief Classifies blocks of all coarse levels by cells they contain
+   * @details Blocks of the finest level are block_size cells square, each
+   * block of a coarser level groups 2x2 blocks of the finer level.
+   */
+  void buildBlockLevels();
+
+  /**
+   * @brief Incremental search implementation
+   * @details Updates persistent frontiers in pending regions and builds
+   * frontiers from them.
+   *
+   * @param reference Reference index to calculate position from
+   * @return List of frontiers, if any
+   */
+  std::vector<Frontier> searchIncremental(unsigned int reference);
+
+  /**
+   * @brief Updates persistent frontiers touched by the region
+   * @details Relabels frontier cells in the region and regrows all frontiers
+   * which could be split or merged by the change.
+   *
+   * @param region updated region of the costmap
+   */
+  void updateFrontierCells(const explore::MapRegion& region);
+
+  /**
+   * @brief Builds frontier from the set of its cells
+   * @param cells frontier cells
+   * @param reference Reference index to calculate position from
+   * @return new frontier
+   */
+  Frontier frontierFromCells(const std::vector<unsigned int>& cells,
+                             unsigned int reference);
+
+  /**
+   * @brief Threads used by parallel algorithms
+   */
+  explore_common::WorkerPool& workers();
+
+  /**
+   * @brief isFrontierCell Evaluate if cell is unknown and has free cell in its
+   * 4-connected neighbourhood.
+   * @param idx Index of candidate cell
+   * @return true if the cell is frontier cell
+   */
+  bool isFrontierCell(unsigned int idx);
+
 private:
   costmap_2d::Costmap2D* costmap_;
-  unsigned char* map_;
+  // map used by the running search
+  GridView grid_;
+  const unsigned char* map_;
   unsigned int size_x_, size_y_;
   double potential_scale_, gain_scale_;
   double min_frontier_size_;
+  SearchMode mode_;
+  unsigned int threads_;
+  unsigned int block_size_;
+  bool geodesic_distance_;
+  // cells of frontiers found by the running search, reused when returned
+  // frontiers are gone
+  std::shared_ptr<FrontierArena> arena_;
+  // noise generator used by frontierCost
+  std::mt19937 rng_;
+  SearchWorkspace workspace_;
+  // started lazily, searches which are not parallel do not need threads
+  std::unique_ptr<explore_common::WorkerPool> workers_;
+
+  // persistent state for incremental search
+  std::vector<explore::MapRegion> pending_regions_;
+  std::vector<bool> frontier_cell_;
+  // id of frontier for each cell, 0 for cells not on frontier
+  std::vector<unsigned int> frontier_id_;
+  std::unordered_map<unsigned int, std::vector<unsigned int>> frontier_cells_;
+  unsigned int next_frontier_id_;
+  unsigned int tracked_size_x_, tracked_size_y_;
+  double tracked_origin_x_, tracked_origin_y_;
+  double tracked_resolution_;
 };
 }
 #endif
\ No newline at end of file
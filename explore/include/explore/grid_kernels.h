@@ -0,0 +1,63 @@
+#ifndef GRID_KERNELS_H_
+#define GRID_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace frontier_exploration
+{
+/**
+ * @brief Marks frontier candidates in a rectangular region of a char map
+ * @details Candidate is an unknown (NO_INFORMATION) cell with at least one
+ * free (FREE_SPACE) cell in its 4-connected neighbourhood. Mask has the same
+ * layout as the map, for cells in the region 1 is stored for candidates and 0
+ * otherwise. Cells outside the region are not written, but neighbours of the
+ * region are read from the map.
+ *
+ * Uses AVX2, SSE2 or NEON when available, the best implementation is chosen
+ * at runtime.
+ *
+ * @param map Map in costmap_2d cost values
+ * @param size_x Width of the map
+ * @param size_y Height of the map
+ * @param x0 First column of the region
+ * @param y0 First row of the region
+ * @param xn Column after the last column of the region
+ * @param yn Row after the last row of the region
+ * @param mask Output mask, size_x * size_y bytes
+ */
+void markFrontierCandidates(const unsigned char* map, unsigned int size_x,
+                            unsigned int size_y, unsigned int x0,
+                            unsigned int y0, unsigned int xn, unsigned int yn,
+                            std::uint8_t* mask);
+
+/**
+ * @brief Marks frontier candidates in the whole char map
+ */
+inline void markFrontierCandidates(const unsigned char* map,
+                                   unsigned int size_x, unsigned int size_y,
+                                   std::uint8_t* mask)
+{
+  markFrontierCandidates(map, size_x, size_y, 0, 0, size_x, size_y, mask);
+}
+
+/**
+ * @brief Translates occupancy grid values to costmap costs
+ * @details Values [0..100] are mapped lineary to costs, 99 is mapped to
+ * INSCRIBED_INFLATED_OBSTACLE, 100 to LETHAL_OBSTACLE and -1 to
+ * NO_INFORMATION. Runs of valid values are translated with SIMD, other values
+ * go through a lookup table.
+ *
+ * @param occupancy Values as in nav_msgs::OccupancyGrid
+ * @param count Number of values
+ * @param costs Output costs, count bytes
+ */
+void translateCosts(const std::int8_t* occupancy, std::size_t count,
+                    unsigned char* costs);
+
+/**
+ * @brief Name of the instruction set used by grid kernels
+ */
+const char* gridKernelsIsa();
+}
+#endif
@@ -0,0 +1,141 @@
+#ifndef GRID_VIEW_H_
+#define GRID_VIEW_H_
+
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/costmap_2d.h>
+#include <nav_msgs/OccupancyGrid.h>
+
+namespace frontier_exploration
+{
+// frontier search distinguishes only free and unknown cells. Their values are
+// the same in costmap costs and in raw occupancy grid data (-1 read as
+// unsigned char), so both can be searched without translation.
+static_assert(costmap_2d::FREE_SPACE == 0, "free cell must be 0");
+static_assert(costmap_2d::NO_INFORMATION ==
+                  static_cast<unsigned char>(static_cast<signed char>(-1)),
+              "unknown cell must be -1 in occupancy grid");
+
+/**
+ * @brief Read-only view of a map searched by FrontierSearch
+ * @details Aliases data of either costmap_2d::Costmap2D or
+ * nav_msgs::OccupancyGrid, view does not own the data. Coordinate conversions
+ * are the same as in costmap_2d::Costmap2D.
+ */
+class GridView
+{
+public:
+  GridView()
+    : data_(nullptr)
+    , size_x_(0)
+    , size_y_(0)
+    , resolution_(0.)
+    , origin_x_(0.)
+    , origin_y_(0.)
+  {
+  }
+
+  GridView(const unsigned char* data, unsigned int size_x, unsigned int size_y,
+           double resolution, double origin_x, double origin_y)
+    : data_(data)
+    , size_x_(size_x)
+    , size_y_(size_y)
+    , resolution_(resolution)
+    , origin_x_(origin_x)
+    , origin_y_(origin_y)
+  {
+  }
+
+  /**
+   * @brief View of costmap data in costmap_2d costs
+   */
+  static GridView fromCostmap(const costmap_2d::Costmap2D& costmap)
+  {
+    return GridView(costmap.getCharMap(), costmap.getSizeInCellsX(),
+                    costmap.getSizeInCellsY(), costmap.getResolution(),
+                    costmap.getOriginX(), costmap.getOriginY());
+  }
+
+  /**
+   * @brief View of raw occupancy grid data
+   * @details Map orientation is ignored, as in costmap_2d. Grid with less
+   * data than its size is viewed as an empty map.
+   */
+  static GridView fromOccupancyGrid(const nav_msgs::OccupancyGrid& grid)
+  {
+    if (grid.data.size() < size_t(grid.info.width) * grid.info.height) {
+      return GridView();
+    }
+    return GridView(reinterpret_cast<const unsigned char*>(grid.data.data()),
+                    grid.info.width, grid.info.height, grid.info.resolution,
+                    grid.info.origin.position.x, grid.info.origin.position.y);
+  }
+
+  const unsigned char* getCharMap() const
+  {
+    return data_;
+  }
+
+  unsigned int getSizeInCellsX() const
+  {
+    return size_x_;
+  }
+
+  unsigned int getSizeInCellsY() const
+  {
+    return size_y_;
+  }
+
+  double getResolution() const
+  {
+    return resolution_;
+  }
+
+  double getOriginX() const
+  {
+    return origin_x_;
+  }
+
+  double getOriginY() const
+  {
+    return origin_y_;
+  }
+
+  unsigned int getIndex(unsigned int mx, unsigned int my) const
+  {
+    return my * size_x_ + mx;
+  }
+
+  void indexToCells(unsigned int index, unsigned int& mx,
+                    unsigned int& my) const
+  {
+    my = index / size_x_;
+    mx = index - (my * size_x_);
+  }
+
+  void mapToWorld(unsigned int mx, unsigned int my, double& wx,
+                  double& wy) const
+  {
+    wx = origin_x_ + (mx + 0.5) * resolution_;
+    wy = origin_y_ + (my + 0.5) * resolution_;
+  }
+
+  bool worldToMap(double wx, double wy, unsigned int& mx,
+                  unsigned int& my) const
+  {
+    if (size_x_ == 0 || size_y_ == 0 || wx < origin_x_ || wy < origin_y_) {
+      return false;
+    }
+
+    mx = static_cast<unsigned int>((wx - origin_x_) / resolution_);
+    my = static_cast<unsigned int>((wy - origin_y_) / resolution_);
+    return mx < size_x_ && my < size_y_;
+  }
+
+private:
+  const unsigned char* data_;
+  unsigned int size_x_, size_y_;
+  double resolution_;
+  double origin_x_, origin_y_;
+};
+}
+#endif
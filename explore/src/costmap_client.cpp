@@ -35,22 +35,51 @@
  *********************************************************************/
 
 #include <explore/costmap_client.h>
+#include <explore/grid_kernels.h>
+#include <explore_common/grid_codec.h>
+#include <explore_common/stats.h>
 
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 
+#include <boost/make_shared.hpp>
+#include <costmap_2d/cost_values.h>
+
 namespace explore
 {
-// static translation table to speed things up
-std::array<unsigned char, 256> init_translation_table();
-static const std::array<unsigned char, 256> cost_translation_table__ =
-    init_translation_table();
+namespace grid_codec = explore_common::grid_codec;
+namespace stats = explore_common::stats;
+
+// map data copied from received maps, in bytes
+static stats::Counter& bytesCopied()
+{
+  static stats::Counter& counter = stats::counter("map bytes copied");
+  return counter;
+}
+
+// costs of decoded free, occupied and unknown cells
+static const unsigned char decoded_costs[3] = {costmap_2d::FREE_SPACE,
+                                               costmap_2d::LETHAL_OBSTACLE,
+                                               costmap_2d::NO_INFORMATION};
+
+// decodes encoded map to raw grid, null if the map is malformed
+static nav_msgs::OccupancyGrid::ConstPtr
+decodeGrid(const nav_msgs::OccupancyGrid& msg);
+// decodes encoded update to raw update, false if the update is malformed
+static bool decodeUpdate(const map_msgs::OccupancyGridUpdate& msg,
+                         map_msgs::OccupancyGridUpdate& decoded);
+// copies region of map data between maps of the same size
+template <typename T>
+static void copyRegion(const T* source, T* target, unsigned int size_x,
+                       const MapRegion& region);
 
 Costmap2DClient::Costmap2DClient(ros::NodeHandle& param_nh,
                                  ros::NodeHandle& subscription_nh,
                                  const tf::TransformListener* tf)
-  : tf_(tf)
+  : tf_(tf), double_buffered_(false), zero_copy_(false), compressed_(false)
 {
   std::string costmap_topic;
   std::string footprint_topic;
@@ -62,6 +91,13 @@ Costmap2DClient::Costmap2DClient(ros::NodeHandle& param_nh,
                  std::string("base_link"));
   // transform tolerance is used for all tf transforms here
   param_nh.param("transform_tolerance", transform_tolerance_, 0.3);
+  param_nh.param("double_buffered_map", double_buffered_, false);
+  param_nh.param("zero_copy_map", zero_copy_, false);
+  param_nh.param("compressed_map", compressed_, false);
+  if (zero_copy_ && double_buffered_) {
+    ROS_WARN("zero_copy_map is set, double_buffered_map has no effect");
+    double_buffered_ = false;
+  }
 
   /* initialize costmap */
   costmap_sub_ = subscription_nh.subscribe<nav_msgs::OccupancyGrid>(
@@ -114,7 +150,9 @@ Costmap2DClient::Costmap2DClient(ros::NodeHandle& param_nh,
 
 void Costmap2DClient::updateFullMap(const nav_msgs::OccupancyGrid::ConstPtr& msg)
 {
-  global_frame_ = msg->header.frame_id;
+  static stats::Histogram& latency = stats::histogram("updateFullMap");
+  stats::ScopedTimer timer(latency);
+  setGlobalFrameID(msg->header.frame_id);
 
   unsigned int size_in_cells_x = msg->info.width;
   unsigned int size_in_cells_y = msg->info.height;
@@ -122,31 +160,79 @@ void Costmap2DClient::updateFullMap(const nav_msgs::OccupancyGrid::ConstPtr& msg
   double origin_x = msg->info.origin.position.x;
   double origin_y = msg->info.origin.position.y;
 
+  if (zero_copy_) {
+    // alias received map, it is never modified. Encoded map is decoded
+    // outside of the lock.
+    nav_msgs::OccupancyGrid::ConstPtr grid = compressed_ ? decodeGrid(*msg)
+                                                         : msg;
+    if (!grid) {
+      return;
+    }
+    std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*costmap_.getMutex());
+    if (grid->data.size() < size_t(size_in_cells_x) * size_in_cells_y) {
+      ROS_ERROR("received map has less data than its size, ignoring it");
+      return;
+    }
+    ROS_DEBUG("received full new map: %d, %d", size_in_cells_x,
+              size_in_cells_y);
+    boost::atomic_store(&grid_, grid);
+    front_grid_.reset();
+    updated_regions_.clear();
+    front_dirty_regions_.clear();
+    back_dirty_regions_.clear();
+    recordUpdatedRegion({0, 0, size_in_cells_x, size_in_cells_y});
+    return;
+  }
+
+  // lock as we are accessing raw underlying map. Resize under the lock too,
+  // partial updates may be served concurrently by other spinner thread.
+  auto* mutex = costmap_.getMutex();
+  std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*mutex);
+
   ROS_DEBUG("received full new map, resizing to: %d, %d", size_in_cells_x,
             size_in_cells_y);
   costmap_.resizeMap(size_in_cells_x, size_in_cells_y, resolution, origin_x,
                      origin_y);
 
-  // lock as we are accessing raw underlying map
-  auto* mutex = costmap_.getMutex();
-  std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*mutex);
-
   // fill map with data
   unsigned char* costmap_data = costmap_.getCharMap();
   size_t costmap_size = costmap_.getSizeInCellsX() * costmap_.getSizeInCellsY();
   ROS_DEBUG("full map update, %lu values", costmap_size);
-  for (size_t i = 0; i < costmap_size && i < msg->data.size(); ++i) {
-    unsigned char cell_cost = static_cast<unsigned char>(msg->data[i]);
-    costmap_data[i] = cost_translation_table__[cell_cost];
+  if (compressed_) {
+    // encoded map is decoded directly to costs
+    if (!grid_codec::decode(msg->data, size_in_cells_x, size_in_cells_y,
+                            decoded_costs, [&](unsigned int y) {
+                              return costmap_data + size_t(y) * size_in_cells_x;
+                            })) {
+      ROS_ERROR("received encoded map is malformed, map is incomplete");
+    }
+  } else {
+    frontier_exploration::translateCosts(
+        msg->data.data(), std::min(costmap_size, msg->data.size()),
+        costmap_data);
+    bytesCopied().add(std::min(costmap_size, msg->data.size()));
   }
   ROS_DEBUG("map updated, written %lu values", costmap_size);
+
+  // previous updates are superseded by the full map
+  updated_regions_.clear();
+  front_dirty_regions_.clear();
+  back_dirty_regions_.clear();
+  recordUpdatedRegion(
+      {0, 0, costmap_.getSizeInCellsX(), costmap_.getSizeInCellsY()});
+
+  if (double_buffered_) {
+    publishSnapshot();
+  }
 }
 
 void Costmap2DClient::updatePartialMap(
     const map_msgs::OccupancyGridUpdate::ConstPtr& msg)
 {
+  static stats::Histogram& latency = stats::histogram("updatePartialMap");
+  stats::ScopedTimer timer(latency);
   ROS_DEBUG("received partial map update");
-  global_frame_ = msg->header.frame_id;
+  setGlobalFrameID(msg->header.frame_id);
 
   if (msg->x < 0 || msg->y < 0) {
     ROS_ERROR("negative coordinates, invalid update. x: %d, y: %d", msg->x,
@@ -159,32 +245,271 @@ void Costmap2DClient::updatePartialMap(
   size_t xn = msg->width + x0;
   size_t yn = msg->height + y0;
 
+  // grids of zero copy mode take raw updates, decode them outside of the lock
+  map_msgs::OccupancyGridUpdate decoded;
+  if (compressed_ && zero_copy_) {
+    if (!decodeUpdate(*msg, decoded)) {
+      return;
+    }
+  }
+
   // lock as we are accessing raw underlying map
   auto* mutex = costmap_.getMutex();
   std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*mutex);
 
   size_t costmap_xn = costmap_.getSizeInCellsX();
   size_t costmap_yn = costmap_.getSizeInCellsY();
+  if (zero_copy_) {
+    costmap_xn = grid_ ? grid_->info.width : 0;
+    costmap_yn = grid_ ? grid_->info.height : 0;
+  }
 
   if (xn > costmap_xn || x0 > costmap_xn || yn > costmap_yn ||
       y0 > costmap_yn) {
+    if (compressed_ && !zero_copy_) {
+      ROS_ERROR("received encoded update doesn't fit into existing map, "
+                "skipping. received: [%lu, %lu], [%lu, %lu] map is: [0, %lu], "
+                "[0, %lu]",
+                x0, xn, y0, yn, costmap_xn, costmap_yn);
+      return;
+    }
     ROS_WARN("received update doesn't fully fit into existing map, "
              "only part will be copied. received: [%lu, %lu], [%lu, %lu] "
              "map is: [0, %lu], [0, %lu]",
              x0, xn, y0, yn, costmap_xn, costmap_yn);
   }
 
-  // update map with data
+  MapRegion region = {static_cast<unsigned int>(std::min(x0, costmap_xn)),
+                      static_cast<unsigned int>(std::min(y0, costmap_yn)),
+                      static_cast<unsigned int>(std::min(xn, costmap_xn)),
+                      static_cast<unsigned int>(std::min(yn, costmap_yn))};
+  if (zero_copy_) {
+    updatePartialGrid(compressed_ ? decoded : *msg, region);
+    return;
+  }
+
   unsigned char* costmap_data = costmap_.getCharMap();
-  size_t i = 0;
-  for (size_t y = y0; y < yn && y < costmap_yn; ++y) {
-    for (size_t x = x0; x < xn && x < costmap_xn; ++x) {
-      size_t idx = costmap_.getIndex(x, y);
-      unsigned char cell_cost = static_cast<unsigned char>(msg->data[i]);
-      costmap_data[idx] = cost_translation_table__[cell_cost];
-      ++i;
+  if (compressed_) {
+    // encoded update is decoded directly to costs
+    if (!grid_codec::decode(msg->data, msg->width, msg->height, decoded_costs,
+                            [&](unsigned int y) {
+                              return costmap_data +
+                                     costmap_.getIndex(region.x0,
+                                                       region.y0 + y);
+                            })) {
+      ROS_ERROR("received encoded update is malformed, update is incomplete");
+    }
+    recordUpdatedRegion(region);
+    if (double_buffered_) {
+      publishSnapshot();
+    }
+    return;
+  }
+
+  // update map with data, row by row
+  size_t row_size = region.xn - region.x0;
+  for (size_t y = region.y0; y < region.yn; ++y) {
+    size_t i = (y - y0) * msg->width;
+    if (i + row_size > msg->data.size()) {
+      ROS_ERROR("partial map update has less data than its size");
+      break;
+    }
+    frontier_exploration::translateCosts(&msg->data[i], row_size,
+                                         costmap_data +
+                                             costmap_.getIndex(x0, y));
+    bytesCopied().add(row_size);
+  }
+
+  recordUpdatedRegion(region);
+
+  if (double_buffered_) {
+    publishSnapshot();
+  }
+}
+
+void Costmap2DClient::recordUpdatedRegion(const MapRegion& region)
+{
+  if (region.x0 >= region.xn || region.y0 >= region.yn) {
+    return;
+  }
+
+  appendRegion(updated_regions_, region);
+  if (double_buffered_ || zero_copy_) {
+    appendRegion(front_dirty_regions_, region);
+    appendRegion(back_dirty_regions_, region);
+  }
+}
+
+void Costmap2DClient::publishSnapshot()
+{
+  bool same_geometry =
+      back_buffer_ &&
+      back_buffer_->getSizeInCellsX() == costmap_.getSizeInCellsX() &&
+      back_buffer_->getSizeInCellsY() == costmap_.getSizeInCellsY() &&
+      back_buffer_->getResolution() == costmap_.getResolution() &&
+      back_buffer_->getOriginX() == costmap_.getOriginX() &&
+      back_buffer_->getOriginY() == costmap_.getOriginY();
+
+  // back buffer can be modified only if no search is using it
+  if (!back_buffer_ || back_buffer_.use_count() > 1) {
+    ROS_DEBUG("back buffer in use, allocating new one");
+    back_buffer_ = std::make_shared<costmap_2d::Costmap2D>(costmap_);
+  } else if (!same_geometry) {
+    *back_buffer_ = costmap_;
+  } else {
+    // bring back buffer up to date, it misses updates since it was published
+    for (auto& region : back_dirty_regions_) {
+      copyRegion(costmap_.getCharMap(), back_buffer_->getCharMap(),
+                 costmap_.getSizeInCellsX(), region);
+    }
+  }
+  ROS_DEBUG("publishing map snapshot, replayed %lu regions",
+            back_dirty_regions_.size());
+
+  std::swap(front_buffer_, back_buffer_);
+  // buffer demoted to back buffer misses updates since it was published
+  std::swap(front_dirty_regions_, back_dirty_regions_);
+  front_dirty_regions_.clear();
+  std::atomic_store(&snapshot_, std::shared_ptr<const costmap_2d::Costmap2D>(
+                                    front_buffer_));
+}
+
+void Costmap2DClient::updatePartialGrid(
+    const map_msgs::OccupancyGridUpdate& msg, const MapRegion& region)
+{
+  if (!grid_) {
+    return;
+  }
+
+  // back grid can be modified only if no search is using it, received grids
+  // are never modified
+  if (!back_grid_ || back_grid_.use_count() > 1 ||
+      back_grid_->info.width != grid_->info.width ||
+      back_grid_->data.size() != grid_->data.size()) {
+    ROS_DEBUG("copying map for partial update");
+    back_grid_ = boost::make_shared<nav_msgs::OccupancyGrid>(*grid_);
+    bytesCopied().add(grid_->data.size());
+  } else {
+    // bring back grid up to date, it misses updates since it was published
+    back_grid_->header = grid_->header;
+    back_grid_->info = grid_->info;
+    for (auto& dirty : back_dirty_regions_) {
+      copyRegion(grid_->data.data(), back_grid_->data.data(),
+                 grid_->info.width, dirty);
+    }
+  }
+
+  // update map with data, row by row
+  size_t row_size = region.xn - region.x0;
+  for (size_t y = region.y0; y < region.yn; ++y) {
+    size_t i = (y - static_cast<size_t>(msg.y)) * msg.width;
+    if (i + row_size > msg.data.size()) {
+      ROS_ERROR("partial map update has less data than its size");
+      break;
+    }
+    std::copy(msg.data.begin() + i, msg.data.begin() + i + row_size,
+              back_grid_->data.begin() + y * grid_->info.width + region.x0);
+    bytesCopied().add(row_size);
+  }
+  recordUpdatedRegion(region);
+
+  // publish updated grid, grid demoted to back grid misses updates since it
+  // was published
+  std::swap(front_grid_, back_grid_);
+  std::swap(front_dirty_regions_, back_dirty_regions_);
+  front_dirty_regions_.clear();
+  boost::atomic_store(&grid_,
+                      nav_msgs::OccupancyGrid::ConstPtr(front_grid_));
+}
+
+static nav_msgs::OccupancyGrid::ConstPtr
+decodeGrid(const nav_msgs::OccupancyGrid& msg)
+{
+  nav_msgs::OccupancyGrid::Ptr grid(new nav_msgs::OccupancyGrid);
+  grid->header = msg.header;
+  grid->info = msg.info;
+  grid->data.resize(size_t(msg.info.width) * msg.info.height);
+  const size_t width = msg.info.width;
+  if (!grid_codec::decode(msg.data, msg.info.width, msg.info.height,
+                          grid_codec::occupancy_values, [&](unsigned int y) {
+                            return grid->data.data() + y * width;
+                          })) {
+    ROS_ERROR("received encoded map is malformed, ignoring it");
+    return nullptr;
+  }
+  return grid;
+}
+
+static bool decodeUpdate(const map_msgs::OccupancyGridUpdate& msg,
+                         map_msgs::OccupancyGridUpdate& decoded)
+{
+  decoded.header = msg.header;
+  decoded.x = msg.x;
+  decoded.y = msg.y;
+  decoded.width = msg.width;
+  decoded.height = msg.height;
+  decoded.data.resize(size_t(msg.width) * msg.height);
+  const size_t width = msg.width;
+  if (!grid_codec::decode(msg.data, msg.width, msg.height,
+                          grid_codec::occupancy_values, [&](unsigned int y) {
+                            return decoded.data.data() + y * width;
+                          })) {
+    ROS_ERROR("received encoded update is malformed, ignoring it");
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<const costmap_2d::Costmap2D>
+Costmap2DClient::getCostmapSnapshot() const
+{
+  return std::atomic_load(&snapshot_);
+}
+
+bool Costmap2DClient::getMapSnapshot(MapSnapshot& snapshot) const
+{
+  if (zero_copy_) {
+    nav_msgs::OccupancyGrid::ConstPtr grid = boost::atomic_load(&grid_);
+    if (!grid) {
+      snapshot = MapSnapshot();
+      return true;
     }
+    snapshot.view = frontier_exploration::GridView::fromOccupancyGrid(*grid);
+    // deleter keeps the message alive
+    snapshot.holder =
+        std::shared_ptr<const void>(grid.get(), [grid](const void*) {});
+    return true;
   }
+
+  if (double_buffered_) {
+    std::shared_ptr<const costmap_2d::Costmap2D> costmap =
+        getCostmapSnapshot();
+    snapshot.view = frontier_exploration::GridView::fromCostmap(*costmap);
+    snapshot.holder = costmap;
+    return true;
+  }
+
+  return false;
+}
+
+std::string Costmap2DClient::getGlobalFrameID() const
+{
+  std::lock_guard<std::mutex> lock(frame_mutex_);
+  return global_frame_;
+}
+
+void Costmap2DClient::setGlobalFrameID(const std::string& frame_id)
+{
+  std::lock_guard<std::mutex> lock(frame_mutex_);
+  global_frame_ = frame_id;
+}
+
+std::vector<MapRegion> Costmap2DClient::takeUpdatedRegions()
+{
+  std::vector<MapRegion> regions;
+  std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*costmap_.getMutex());
+  std::swap(regions, updated_regions_);
+  return regions;
 }
 
 geometry_msgs::Pose Costmap2DClient::getRobotPose() const
@@ -200,7 +525,7 @@ geometry_msgs::Pose Costmap2DClient::getRobotPose() const
 
   // get the global pose of the robot
   try {
-    tf_->transformPose(global_frame_, robot_pose, global_pose);
+    tf_->transformPose(getGlobalFrameID(), robot_pose, global_pose);
   } catch (tf::LookupException& ex) {
     ROS_ERROR_THROTTLE(1.0, "No Transform available Error looking up robot "
                             "pose: %s\n",
@@ -230,23 +555,15 @@ geometry_msgs::Pose Costmap2DClient::getRobotPose() const
   return msg.pose;
 }
 
-std::array<unsigned char, 256> init_translation_table()
+template <typename T>
+static void copyRegion(const T* source, T* target, unsigned int size_x,
+                       const MapRegion& region)
 {
-  std::array<unsigned char, 256> cost_translation_table;
-
-  // lineary mapped from [0..100] to [0..255]
-  for (size_t i = 0; i < 256; ++i) {
-    cost_translation_table[i] =
-        static_cast<unsigned char>(1 + (251 * (i - 1)) / 97);
+  for (unsigned int y = region.y0; y < region.yn; ++y) {
+    size_t row = static_cast<size_t>(y) * size_x;
+    std::copy(source + row + region.x0, source + row + region.xn,
+              target + row + region.x0);
   }
-
-  // special values:
-  cost_translation_table[0] = 0;      // NO obstacle
-  cost_translation_table[99] = 253;   // INSCRIBED obstacle
-  cost_translation_table[100] = 254;  // LETHAL obstacle
-  cost_translation_table[static_cast<unsigned char>(-1)] = 255;  // UNKNOWN
-
-  return cost_translation_table;
 }
 
 }  // namespace explore
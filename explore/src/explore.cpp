@@ -36,9 +36,14 @@
  *********************************************************************/
 
 #include <explore/explore.h>
+#include <explore_common/stats.h>
 
+#include <algorithm>
+#include <limits>
 #include <thread>
 
+#include <diagnostic_msgs/DiagnosticArray.h>
+
 inline static bool operator==(const geometry_msgs::Point& one,
                               const geometry_msgs::Point& two)
 {
@@ -50,16 +55,43 @@ inline static bool operator==(const geometry_msgs::Point& one,
 
 namespace explore
 {
+namespace stats = explore_common::stats;
+
+// order independent hash of frontier cells
+static std::uint64_t cellsFingerprint(const frontier_exploration::Frontier& f)
+{
+  std::uint64_t hash = f.size;
+  for (const std::uint32_t* cell = f.cellsBegin(); cell != f.cellsEnd();
+       ++cell) {
+    // splitmix64 finalizer
+    std::uint64_t z = *cell + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    hash += z ^ (z >> 31);
+  }
+  return hash;
+}
+
 Explore::Explore()
   : private_nh_("~")
   , tf_listener_(ros::Duration(10.0))
   , costmap_client_(private_nh_, relative_nh_, &tf_listener_)
   , move_base_client_("move_base")
   , prev_distance_(0)
-  , last_markers_count_(0)
+  , map_resolution_(0)
+  , next_marker_id_(0)
+  , resend_markers_(false)
+  , plan_requested_(false)
+  , planner_shutdown_(false)
 {
   double timeout;
   double min_frontier_size;
+  std::string search_mode;
+  int search_threads;
+  int search_block_size;
+  bool geodesic_distance;
+  double blacklist_timeout;
+  int blacklist_max_entries;
   private_nh_.param("planner_frequency", planner_frequency_, 1.0);
   private_nh_.param("progress_timeout", timeout, 30.0);
   progress_timeout_ = ros::Duration(timeout);
@@ -68,28 +100,112 @@ Explore::Explore()
   private_nh_.param("orientation_scale", orientation_scale_, 0.0);
   private_nh_.param("gain_scale", gain_scale_, 1.0);
   private_nh_.param("min_frontier_size", min_frontier_size, 0.5);
+  private_nh_.param("search_mode", search_mode, std::string("bfs"));
+  private_nh_.param("search_threads", search_threads, 0);
+  private_nh_.param("search_block_size", search_block_size, 16);
+  private_nh_.param("geodesic_distance", geodesic_distance, false);
+  private_nh_.param("blacklist_timeout", blacklist_timeout, 0.0);
+  private_nh_.param("blacklist_max_entries", blacklist_max_entries, 1000);
+  private_nh_.param("max_marker_points", max_marker_points_, 0);
+  double stats_rate;
+  private_nh_.param("stats_rate", stats_rate, 0.0);
+
+  frontier_exploration::SearchMode mode = frontier_exploration::SearchMode::BFS;
+  if (search_mode == "incremental") {
+    mode = frontier_exploration::SearchMode::INCREMENTAL;
+  } else if (search_mode == "parallel") {
+    mode = frontier_exploration::SearchMode::PARALLEL;
+  } else if (search_mode == "hierarchical") {
+    mode = frontier_exploration::SearchMode::HIERARCHICAL;
+  } else if (search_mode != "bfs") {
+    ROS_WARN("unknown search_mode: %s, using bfs", search_mode.c_str());
+  }
 
   search_ = frontier_exploration::FrontierSearch(costmap_client_.getCostmap(),
                                                  potential_scale_, gain_scale_,
-                                                 min_frontier_size);
+                                                 min_frontier_size, mode,
+                                                 std::max(search_threads, 0),
+                                                 std::max(search_block_size, 1),
+                                                 geodesic_distance);
+  // goals within 5 cells of blacklisted ones are blacklisted as well
+  frontier_blacklist_ = FrontierBlacklist(
+      5., ros::Duration(std::max(blacklist_timeout, 0.0)),
+      static_cast<size_t>(std::max(blacklist_max_entries, 0)));
 
   if (visualize_) {
+    // markers are published as changes, new subscriber needs all of them
     marker_array_publisher_ =
-        private_nh_.advertise<visualization_msgs::MarkerArray>("frontiers", 10);
+        private_nh_.advertise<visualization_msgs::MarkerArray>(
+            "frontiers", 10, [this](const ros::SingleSubscriberPublisher&) {
+              resend_markers_ = true;
+            });
+  }
+
+  // statistics are collected only when they are published
+  if (stats_rate > 0.) {
+    stats::setEnabled(true);
+    stats_publisher_ =
+        relative_nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics",
+                                                                 1);
+    stats_timer_ = relative_nh_.createTimer(
+        ros::Duration(1. / stats_rate),
+        [this](const ros::TimerEvent&) { publishStats(); });
   }
 
   ROS_INFO("Waiting to connect to move_base server");
   move_base_client_.waitForServer();
   ROS_INFO("Connected to move_base server");
 
+  planner_thread_ = std::thread([this]() { plannerLoop(); });
   exploring_timer_ =
       relative_nh_.createTimer(ros::Duration(1. / planner_frequency_),
-                               [this](const ros::TimerEvent&) { makePlan(); });
+                               [this](const ros::TimerEvent&) { requestPlan(); });
 }
 
 Explore::~Explore()
 {
   stop();
+  {
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    planner_shutdown_ = true;
+  }
+  planner_cv_.notify_all();
+  planner_thread_.join();
+}
+
+void Explore::requestPlan()
+{
+  {
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    // requests coming before planner wakes up are served by single planning
+    plan_requested_ = true;
+  }
+  planner_cv_.notify_one();
+}
+
+void Explore::plannerLoop()
+{
+  std::unique_lock<std::mutex> lock(planner_mutex_);
+  while (true) {
+    planner_cv_.wait(lock,
+                     [this]() { return plan_requested_ || planner_shutdown_; });
+    if (planner_shutdown_) {
+      return;
+    }
+    plan_requested_ = false;
+    std::vector<geometry_msgs::Point> aborted_goals;
+    std::swap(aborted_goals, aborted_goals_);
+    lock.unlock();
+
+    // planner state is touched only by this thread
+    for (auto& goal : aborted_goals) {
+      frontier_blacklist_.add(goal, ros::Time::now());
+      ROS_DEBUG("Adding current goal to black list");
+    }
+    makePlan();
+
+    lock.lock();
+  }
 }
 
 void Explore::visualizeFrontiers(
@@ -133,55 +249,147 @@ void Explore::visualizeFrontiers(
   // weighted frontiers are always sorted
   double min_cost = frontiers.empty() ? 0. : frontiers.front().cost;
 
+  // publish all markers for new subscriber
+  bool resend = resend_markers_.exchange(false);
+
+  // fingerprints of published frontiers
+  std::unordered_map<std::uint64_t, int> published;
+  for (auto& marker : frontier_markers_) {
+    published.emplace(marker.second.fingerprint, marker.first);
+  }
+  std::unordered_map<int, FrontierMarker> current;
+  std::vector<std::pair<std::uint32_t, int>> current_cells;
+
   m.action = visualization_msgs::Marker::ADD;
-  size_t id = 0;
   for (auto& frontier : frontiers) {
-    m.type = visualization_msgs::Marker::POINTS;
-    m.id = int(id);
-    m.pose.position = {};
-    m.scale.x = 0.1;
-    m.scale.y = 0.1;
-    m.scale.z = 0.1;
-    m.points = frontier.points;
-    if (goalOnBlacklist(frontier.centroid)) {
-      m.color = red;
+    FrontierMarker state;
+    state.fingerprint = cellsFingerprint(frontier);
+    state.blacklisted = goalOnBlacklist(frontier.centroid);
+    // scale frontier according to its cost (costier frontiers will be smaller)
+    state.scale = std::min(std::abs(min_cost * 0.4 / frontier.cost), 0.5);
+    state.initial = frontier.initial;
+
+    // frontier with the same cells keeps its id, changed frontier takes id of
+    // some frontier it overlaps
+    int id = -1;
+    bool cells_changed = true;
+    auto same = published.find(state.fingerprint);
+    if (same != published.end() && !current.count(same->second)) {
+      id = same->second;
+      cells_changed = false;
     } else {
-      m.color = blue;
+      for (const std::uint32_t* cell = frontier.cellsBegin();
+           cell != frontier.cellsEnd() && id < 0; ++cell) {
+        auto overlap =
+            std::lower_bound(marker_cells_.begin(), marker_cells_.end(),
+                             std::make_pair(*cell, 0));
+        if (overlap != marker_cells_.end() && overlap->first == *cell &&
+            !current.count(overlap->second)) {
+          id = overlap->second;
+        }
+      }
     }
-    markers.push_back(m);
-    ++id;
-    m.type = visualization_msgs::Marker::SPHERE;
-    m.id = int(id);
-    m.pose.position = frontier.initial;
-    // scale frontier according to its cost (costier frontiers will be smaller)
-    double scale = std::min(std::abs(min_cost * 0.4 / frontier.cost), 0.5);
-    m.scale.x = scale;
-    m.scale.y = scale;
-    m.scale.z = scale;
-    m.points = {};
-    m.color = green;
-    markers.push_back(m);
-    ++id;
+    if (id < 0) {
+      id = next_marker_id_++;
+    }
+    for (const std::uint32_t* cell = frontier.cellsBegin();
+         cell != frontier.cellsEnd(); ++cell) {
+      current_cells.emplace_back(*cell, id);
+    }
+
+    auto previous = frontier_markers_.find(id);
+    bool added = resend || previous == frontier_markers_.end();
+    if (added || cells_changed ||
+        previous->second.blacklisted != state.blacklisted) {
+      m.type = visualization_msgs::Marker::POINTS;
+      m.id = 2 * id;
+      m.pose.position = {};
+      m.scale.x = 0.1;
+      m.scale.y = 0.1;
+      m.scale.z = 0.1;
+      m.points = frontier.points(static_cast<size_t>(max_marker_points_));
+      m.color = state.blacklisted ? red : blue;
+      markers.push_back(m);
+    }
+    // small changes of cost are not worth publishing
+    if (added || !(previous->second.initial == state.initial) ||
+        std::abs(previous->second.scale - state.scale) > 0.01) {
+      m.type = visualization_msgs::Marker::SPHERE;
+      m.id = 2 * id + 1;
+      m.pose.position = frontier.initial;
+      m.scale.x = state.scale;
+      m.scale.y = state.scale;
+      m.scale.z = state.scale;
+      m.points = {};
+      m.color = green;
+      markers.push_back(m);
+    } else {
+      // keep the published state, so that changes do not accumulate unseen
+      state.scale = previous->second.scale;
+      state.initial = previous->second.initial;
+    }
+    current.emplace(id, state);
   }
-  size_t current_markers_count = markers.size();
 
-  // delete previous markers, which are now unused
+  // delete markers of frontiers, which are gone
   m.action = visualization_msgs::Marker::DELETE;
-  for (; id < last_markers_count_; ++id) {
-    m.id = int(id);
+  m.points = {};
+  for (auto& marker : frontier_markers_) {
+    if (current.count(marker.first)) {
+      continue;
+    }
+    m.id = 2 * marker.first;
+    markers.push_back(m);
+    m.id = 2 * marker.first + 1;
     markers.push_back(m);
   }
 
-  last_markers_count_ = current_markers_count;
-  marker_array_publisher_.publish(markers_msg);
+  std::sort(current_cells.begin(), current_cells.end());
+  frontier_markers_.swap(current);
+  marker_cells_.swap(current_cells);
+  if (!markers.empty()) {
+    marker_array_publisher_.publish(markers_msg);
+  }
 }
 
 void Explore::makePlan()
+{
+  static stats::Histogram& latency = stats::histogram("makePlan");
+  stats::ScopedTimer timer(latency);
+  // plan again, when current goal is blacklisted
+  while (planOnce()) {
+  }
+}
+
+bool Explore::planOnce()
 {
   // find frontiers
   auto pose = costmap_client_.getRobotPose();
-  // get frontiers sorted according to cost
-  auto frontiers = search_.searchFrom(pose.position);
+  search_.markUpdated(costmap_client_.takeUpdatedRegions());
+  // get frontiers sorted according to cost. Snapshot includes all regions
+  // taken above.
+  explore::MapSnapshot snapshot;
+  bool has_snapshot = costmap_client_.getMapSnapshot(snapshot);
+  map_resolution_ = has_snapshot ?
+                        snapshot.view.getResolution() :
+                        costmap_client_.getCostmap()->getResolution();
+  frontier_blacklist_.setResolution(map_resolution_);
+  frontier_blacklist_.expire(ros::Time::now());
+
+  // visualization shows all frontiers, otherwise only the best frontier which
+  // is not blacklisted is needed
+  size_t k = visualize_ ? std::numeric_limits<size_t>::max() : 1;
+  auto blacklisted = [this](const frontier_exploration::Frontier& f) {
+    return goalOnBlacklist(f.centroid);
+  };
+  frontier_exploration::FrontierSearch::FrontierFilter reject;
+  if (!visualize_) {
+    reject = blacklisted;
+  }
+  std::vector<frontier_exploration::Frontier> frontiers =
+      has_snapshot ?
+          search_.searchBest(snapshot.view, pose.position, k, reject) :
+          search_.searchBest(pose.position, k, reject);
   ROS_DEBUG("found %lu frontiers", frontiers.size());
   for (size_t i = 0; i < frontiers.size(); ++i) {
     ROS_DEBUG("frontier %zd cost: %f", i, frontiers[i].cost);
@@ -189,7 +397,7 @@ void Explore::makePlan()
 
   if (frontiers.empty()) {
     stop();
-    return;
+    return false;
   }
 
   // publish frontiers as visualization markers
@@ -217,15 +425,16 @@ void Explore::makePlan()
 
   // ROS_INFO("HELLO");
 
-  // find non blacklisted frontier
-  auto frontier =
-      std::find_if_not(frontiers.begin(), frontiers.end(),
-                       [this](const frontier_exploration::Frontier& f) {
-                         return goalOnBlacklist(f.centroid);
-                       });
+  // search rejected blacklisted frontiers already, unless all of them are kept
+  // for visualization
+  auto frontier = frontiers.begin();
+  if (visualize_) {
+    frontier =
+        std::find_if_not(frontiers.begin(), frontiers.end(), blacklisted);
+  }
   if (frontier == frontiers.end()) {
     stop();
-    return;
+    return false;
   }
   geometry_msgs::Point target_position = frontier->centroid;
 
@@ -239,15 +448,14 @@ void Explore::makePlan()
   }
   // black list if we've made no progress for a long time
   if (ros::Time::now() - last_progress_ > progress_timeout_) {
-    frontier_blacklist_.push_back(target_position);
+    frontier_blacklist_.add(target_position, ros::Time::now());
     ROS_DEBUG("Adding current goal to black list");
-    makePlan();
-    return;
+    return true;
   }
 
   // we don't need to do anything if we still pursuing the same goal
   if (same_goal) {
-    return;
+    return false;
   }
 
   // send goal to move_base if we have something new to pursue
@@ -262,23 +470,13 @@ void Explore::makePlan()
                 const move_base_msgs::MoveBaseResultConstPtr& result) {
         reachedGoal(status, result, target_position);
       });
+  return false;
 }
 
 bool Explore::goalOnBlacklist(const geometry_msgs::Point& goal)
 {
-  constexpr static size_t tolerace = 5;
-  costmap_2d::Costmap2D* costmap2d = costmap_client_.getCostmap();
-
   // check if a goal is on the blacklist for goals that we're pursuing
-  for (auto& frontier_goal : frontier_blacklist_) {
-    double x_diff = fabs(goal.x - frontier_goal.x);
-    double y_diff = fabs(goal.y - frontier_goal.y);
-
-    if (x_diff < tolerace * costmap2d->getResolution() &&
-        y_diff < tolerace * costmap2d->getResolution())
-      return true;
-  }
-  return false;
+  return frontier_blacklist_.contains(goal);
 }
 
 void Explore::reachedGoal(const actionlib::SimpleClientGoalState& status,
@@ -287,17 +485,26 @@ void Explore::reachedGoal(const actionlib::SimpleClientGoalState& status,
 {
   ROS_DEBUG("Reached goal with status: %s", status.toString().c_str());
   if (status == actionlib::SimpleClientGoalState::ABORTED) {
-    frontier_blacklist_.push_back(frontier_goal);
-    ROS_DEBUG("Adding current goal to black list");
+    // blacklisted by planner thread, which owns the blacklist
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    aborted_goals_.push_back(frontier_goal);
   }
 
-  // find new goal immediatelly regardless of planning frequency.
-  // execute via timer to prevent dead lock in move_base_client (this is
-  // callback for sendGoal, which is called in makePlan). the timer must live
-  // until callback is executed.
-  oneshot_ = relative_nh_.createTimer(
-      ros::Duration(0, 0), [this](const ros::TimerEvent&) { makePlan(); },
-      true);
+  // find new goal immediatelly regardless of planning frequency. Planning runs
+  // in the planner thread, so it will not dead lock move_base_client (this is
+  // callback for sendGoal).
+  requestPlan();
+}
+
+void Explore::publishStats()
+{
+  diagnostic_msgs::DiagnosticArray::Ptr msg(
+      new diagnostic_msgs::DiagnosticArray());
+  msg->header.stamp = ros::Time::now();
+  msg->status.push_back(stats::Registry::instance().toDiagnosticStatus());
+  msg->status.back().name = ros::this_node::getName() + ": statistics";
+  msg->status.back().message = "hot path latencies and counters";
+  stats_publisher_.publish(msg);
 }
 
 void Explore::start()
@@ -317,12 +524,14 @@ void Explore::stop()
 int main(int argc, char** argv)
 {
   ros::init(argc, argv, "explore");
-  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
-                                     ros::console::levels::Debug)) {
-    ros::console::notifyLoggerLevelsChanged();
-  }
+  // callbacks are served by spinner threads, planning by planner thread of
+  // Explore
+  int spinner_threads;
+  ros::NodeHandle("~").param("spinner_threads", spinner_threads, 1);
+  ros::AsyncSpinner spinner(static_cast<uint32_t>(std::max(spinner_threads, 1)));
   explore::Explore explore;
-  ros::spin();
+  spinner.start();
+  ros::waitForShutdown();
 
   return 0;
 }
\ No newline at end of file
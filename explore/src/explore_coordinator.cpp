@@ -0,0 +1,340 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/explore_coordinator.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/make_shared.hpp>
+
+namespace explore
+{
+ExploreCoordinator::ExploreCoordinator()
+  : private_nh_("~"), tf_listener_(ros::Duration(10.0))
+{
+  std::vector<std::string> robot_names;
+  std::string robot_base_frame;
+  std::string map_topic;
+  std::string map_updates_topic;
+  double timeout;
+  double min_frontier_size;
+  double blacklist_timeout;
+  int blacklist_max_entries;
+  private_nh_.param("robots", robot_names, std::vector<std::string>());
+  private_nh_.param("robot_base_frame", robot_base_frame,
+                    std::string("base_link"));
+  private_nh_.param("map_topic", map_topic, std::string("map"));
+  private_nh_.param("map_updates_topic", map_updates_topic,
+                    std::string("map_updates"));
+  private_nh_.param("planner_frequency", planner_frequency_, 1.0);
+  private_nh_.param("progress_timeout", timeout, 30.0);
+  progress_timeout_ = ros::Duration(timeout);
+  private_nh_.param("potential_scale", potential_scale_, 1e-3);
+  private_nh_.param("gain_scale", gain_scale_, 1.0);
+  private_nh_.param("min_frontier_size", min_frontier_size, 0.5);
+  private_nh_.param("transform_tolerance", transform_tolerance_, 0.3);
+  private_nh_.param("blacklist_timeout", blacklist_timeout, 0.0);
+  private_nh_.param("blacklist_max_entries", blacklist_max_entries, 1000);
+
+  // frontiers are searched in the whole map regardless of robot positions,
+  // robots can be in parts of the map which are not connected yet.
+  // Incremental search relabels only regions changed by map updates.
+  // Costmap is never used, grids are passed to each search.
+  search_ = frontier_exploration::FrontierSearch(
+      nullptr, potential_scale_, gain_scale_, min_frontier_size,
+      frontier_exploration::SearchMode::INCREMENTAL);
+  // goals within 5 cells of blacklisted ones are blacklisted as well
+  frontier_blacklist_ = FrontierBlacklist(
+      5., ros::Duration(std::max(blacklist_timeout, 0.0)),
+      static_cast<size_t>(std::max(blacklist_max_entries, 0)));
+
+  if (robot_names.empty()) {
+    ROS_ERROR("no robots to coordinate, set ~robots parameter");
+  }
+  for (auto& name : robot_names) {
+    Robot robot;
+    robot.name = name;
+    robot.base_frame =
+        name.empty() ? robot_base_frame : name + "/" + robot_base_frame;
+    robot.move_base_client.reset(
+        new MoveBaseClient(ros::names::append(name, "move_base")));
+    robots_.push_back(std::move(robot));
+  }
+
+  ROS_INFO("Waiting to connect to move_base servers");
+  for (auto& robot : robots_) {
+    robot.move_base_client->waitForServer();
+  }
+  ROS_INFO("Connected to %lu move_base servers", robots_.size());
+
+  map_subscriber_ = relative_nh_.subscribe<nav_msgs::OccupancyGrid>(
+      map_topic, 1,
+      [this](const nav_msgs::OccupancyGrid::ConstPtr& msg) { mapReceived(msg); });
+  map_updates_subscriber_ =
+      relative_nh_.subscribe<map_msgs::OccupancyGridUpdate>(
+          map_updates_topic, 50,
+          [this](const map_msgs::OccupancyGridUpdate::ConstPtr& msg) {
+            mapUpdateReceived(msg);
+          });
+  exploring_timer_ =
+      relative_nh_.createTimer(ros::Duration(1. / planner_frequency_),
+                               [this](const ros::TimerEvent&) { makePlan(); });
+}
+
+ExploreCoordinator::~ExploreCoordinator()
+{
+  stop();
+}
+
+void ExploreCoordinator::mapReceived(
+    const nav_msgs::OccupancyGrid::ConstPtr& msg)
+{
+  map_ = msg;
+  updated_map_.reset();
+  updated_regions_.clear();
+  updated_regions_.push_back({0, 0, msg->info.width, msg->info.height});
+}
+
+void ExploreCoordinator::mapUpdateReceived(
+    const map_msgs::OccupancyGridUpdate::ConstPtr& msg)
+{
+  if (!map_) {
+    return;
+  }
+  const size_t width = map_->info.width;
+  if (msg->x < 0 || msg->y < 0 ||
+      size_t(msg->x) + msg->width > map_->info.width ||
+      size_t(msg->y) + msg->height > map_->info.height ||
+      msg->data.size() < size_t(msg->width) * msg->height) {
+    ROS_ERROR("received map update doesn't fit into the map, ignoring it");
+    return;
+  }
+
+  if (!updated_map_) {
+    updated_map_ = boost::make_shared<nav_msgs::OccupancyGrid>(*map_);
+    map_ = updated_map_;
+  }
+  const unsigned int x0 = static_cast<unsigned int>(msg->x);
+  const unsigned int y0 = static_cast<unsigned int>(msg->y);
+  for (unsigned int y = 0; y < msg->height; ++y) {
+    auto row = msg->data.begin() + size_t(y) * msg->width;
+    std::copy(row, row + msg->width,
+              updated_map_->data.begin() + (y0 + y) * width + x0);
+  }
+  appendRegion(updated_regions_,
+               {x0, y0, x0 + msg->width, y0 + msg->height});
+}
+
+void ExploreCoordinator::makePlan()
+{
+  if (!map_) {
+    ROS_DEBUG("waiting for map");
+    return;
+  }
+  frontier_exploration::GridView view =
+      frontier_exploration::GridView::fromOccupancyGrid(*map_);
+  const std::string& global_frame = map_->header.frame_id;
+  if (view.getSizeInCellsX() == 0 || view.getSizeInCellsY() == 0) {
+    ROS_WARN_THROTTLE(1.0, "received map is empty");
+    return;
+  }
+  if (!updated_regions_.empty()) {
+    search_.markUpdated(updated_regions_);
+    updated_regions_.clear();
+  }
+
+  // robots with known position take part in assignment
+  std::vector<size_t> active;
+  std::vector<geometry_msgs::Point> positions;
+  for (size_t i = 0; i < robots_.size(); ++i) {
+    geometry_msgs::Point position;
+    if (robotPosition(robots_[i], global_frame, position)) {
+      active.push_back(i);
+      positions.push_back(position);
+    }
+  }
+  if (active.empty()) {
+    ROS_WARN_THROTTLE(1.0, "no robot is localized in the map");
+    return;
+  }
+
+  // search frontiers once for all robots. Distances to robots are computed
+  // below, any position inside the map will do as a reference.
+  geometry_msgs::Point reference;
+  view.mapToWorld(view.getSizeInCellsX() / 2, view.getSizeInCellsY() / 2,
+                  reference.x, reference.y);
+  frontier_blacklist_.setResolution(view.getResolution());
+  frontier_blacklist_.expire(ros::Time::now());
+  auto frontiers = search_.searchBest(
+      view, reference, std::numeric_limits<size_t>::max(),
+      [this](const frontier_exploration::Frontier& f) {
+        return frontier_blacklist_.contains(f.centroid);
+      });
+  ROS_DEBUG("found %lu frontiers for %lu robots", frontiers.size(),
+            active.size());
+  if (frontiers.empty()) {
+    stop();
+    return;
+  }
+
+  std::vector<double> distances;
+  std::vector<double> costs = frontierCosts(frontiers, positions,
+                                            potential_scale_, gain_scale_,
+                                            distances);
+  std::vector<int> assignment =
+      assignFrontiers(costs, active.size(), frontiers.size());
+
+  ros::Time now = ros::Time::now();
+  for (size_t r = 0; r < active.size(); ++r) {
+    Robot& robot = robots_[active[r]];
+    const geometry_msgs::Point* target = nullptr;
+    double distance = 0.;
+    if (assignment[r] >= 0) {
+      size_t f = static_cast<size_t>(assignment[r]);
+      target = &frontiers[f].centroid;
+      distance = distances[r * frontiers.size() + f];
+    }
+
+    switch (dispatchGoal(robot.progress, target, distance, now,
+                         progress_timeout_)) {
+      case GoalAction::KEEP:
+        break;
+      case GoalAction::SEND:
+        sendGoal(active[r], global_frame);
+        break;
+      case GoalAction::CANCEL:
+        robot.move_base_client->cancelGoal();
+        break;
+      case GoalAction::BLACKLIST:
+        frontier_blacklist_.add(*target, now);
+        ROS_DEBUG("%s: adding current goal to black list", robot.name.c_str());
+        break;
+    }
+  }
+}
+
+bool ExploreCoordinator::robotPosition(const Robot& robot,
+                                       const std::string& global_frame,
+                                       geometry_msgs::Point& position) const
+{
+  tf::Stamped<tf::Pose> global_pose;
+  global_pose.setIdentity();
+  tf::Stamped<tf::Pose> robot_pose;
+  robot_pose.setIdentity();
+  robot_pose.frame_id_ = robot.base_frame;
+  robot_pose.stamp_ = ros::Time();
+  ros::Time current_time = ros::Time::now();
+
+  try {
+    tf_listener_.transformPose(global_frame, robot_pose, global_pose);
+  } catch (tf::TransformException& ex) {
+    ROS_ERROR_THROTTLE(1.0, "%s: error looking up robot pose: %s",
+                       robot.name.c_str(), ex.what());
+    return false;
+  }
+  if (current_time.toSec() - global_pose.stamp_.toSec() >
+      transform_tolerance_) {
+    ROS_WARN_THROTTLE(1.0, "%s: transform timeout", robot.name.c_str());
+    return false;
+  }
+
+  geometry_msgs::PoseStamped msg;
+  tf::poseStampedTFToMsg(global_pose, msg);
+  position = msg.pose.position;
+  return true;
+}
+
+void ExploreCoordinator::sendGoal(size_t robot, const std::string& global_frame)
+{
+  geometry_msgs::Point target = robots_[robot].progress.goal;
+
+  move_base_msgs::MoveBaseGoal goal;
+  goal.target_pose.pose.position = target;
+  goal.target_pose.pose.orientation.w = 1.;
+  goal.target_pose.header.frame_id = global_frame;
+  goal.target_pose.header.stamp = ros::Time::now();
+  robots_[robot].move_base_client->sendGoal(
+      goal, [this, robot, target](
+                const actionlib::SimpleClientGoalState& status,
+                const move_base_msgs::MoveBaseResultConstPtr&) {
+        reachedGoal(robot, status, target);
+      });
+}
+
+void ExploreCoordinator::reachedGoal(
+    size_t robot, const actionlib::SimpleClientGoalState& status,
+    const geometry_msgs::Point& frontier_goal)
+{
+  ROS_DEBUG("%s: reached goal with status: %s", robots_[robot].name.c_str(),
+            status.toString().c_str());
+  if (status == actionlib::SimpleClientGoalState::ABORTED) {
+    frontier_blacklist_.add(frontier_goal, ros::Time::now());
+    ROS_DEBUG("Adding current goal to black list");
+  }
+  // goal may have been replaced already. New goal is assigned by the next
+  // planning, sending goals from this callback would dead lock
+  // move_base_client.
+  if (sameGoal(robots_[robot].progress.goal, frontier_goal)) {
+    robots_[robot].progress.has_goal = false;
+  }
+}
+
+void ExploreCoordinator::start()
+{
+  exploring_timer_.start();
+}
+
+void ExploreCoordinator::stop()
+{
+  for (auto& robot : robots_) {
+    robot.move_base_client->cancelAllGoals();
+    robot.progress.has_goal = false;
+  }
+  exploring_timer_.stop();
+  ROS_INFO("Exploration stopped.");
+}
+
+}  // namespace explore
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "explore_coordinator");
+  explore::ExploreCoordinator coordinator;
+  ros::spin();
+
+  return 0;
+}
@@ -0,0 +1,207 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/frontier_assignment.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace explore
+{
+std::vector<int> assignFrontiers(const std::vector<double>& costs,
+                                 std::size_t robots, std::size_t frontiers)
+{
+  std::vector<int> assignment(robots, -1);
+  if (robots == 0 || frontiers == 0) {
+    return assignment;
+  }
+
+  // algorithm assigns every row, rows must be the smaller dimension
+  const bool transposed = robots > frontiers;
+  const std::size_t rows = transposed ? frontiers : robots;
+  const std::size_t cols = transposed ? robots : frontiers;
+  auto cost = [&](std::size_t row, std::size_t col) {
+    return transposed ? costs[col * frontiers + row] :
+                        costs[row * frontiers + col];
+  };
+
+  // potentials of rows and columns, column 0 is a virtual start column.
+  // Indexes of rows and columns are shifted by one.
+  const double inf = std::numeric_limits<double>::infinity();
+  std::vector<double> row_potential(rows + 1, 0.);
+  std::vector<double> col_potential(cols + 1, 0.);
+  // row matched to each column, 0 for free columns
+  std::vector<std::size_t> col_row(cols + 1, 0);
+  std::vector<std::size_t> way(cols + 1, 0);
+  std::vector<double> min_slack(cols + 1);
+  std::vector<bool> used(cols + 1);
+
+  for (std::size_t row = 1; row <= rows; ++row) {
+    // find augmenting path for row by Dijkstra on reduced costs
+    col_row[0] = row;
+    std::size_t col0 = 0;
+    std::fill(min_slack.begin(), min_slack.end(), inf);
+    std::fill(used.begin(), used.end(), false);
+    do {
+      used[col0] = true;
+      std::size_t row0 = col_row[col0];
+      double delta = inf;
+      std::size_t col1 = 0;
+      for (std::size_t col = 1; col <= cols; ++col) {
+        if (used[col]) {
+          continue;
+        }
+        double slack = cost(row0 - 1, col - 1) - row_potential[row0] -
+                       col_potential[col];
+        if (slack < min_slack[col]) {
+          min_slack[col] = slack;
+          way[col] = col0;
+        }
+        if (min_slack[col] < delta) {
+          delta = min_slack[col];
+          col1 = col;
+        }
+      }
+      for (std::size_t col = 0; col <= cols; ++col) {
+        if (used[col]) {
+          row_potential[col_row[col]] += delta;
+          col_potential[col] -= delta;
+        } else {
+          min_slack[col] -= delta;
+        }
+      }
+      col0 = col1;
+    } while (col_row[col0] != 0);
+
+    // flip matching along the path
+    do {
+      std::size_t col1 = way[col0];
+      col_row[col0] = col_row[col1];
+      col0 = col1;
+    } while (col0 != 0);
+  }
+
+  for (std::size_t col = 1; col <= cols; ++col) {
+    if (col_row[col] == 0) {
+      continue;
+    }
+    std::size_t row = col_row[col] - 1;
+    if (transposed) {
+      assignment[col - 1] = static_cast<int>(row);
+    } else {
+      assignment[row] = static_cast<int>(col - 1);
+    }
+  }
+
+  return assignment;
+}
+
+double frontierDistance(const frontier_exploration::Frontier& frontier,
+                        const geometry_msgs::Point& position)
+{
+  const frontier_exploration::GridView& grid = frontier.arena->grid;
+  double min_distance = std::numeric_limits<double>::infinity();
+  for (const std::uint32_t* cell = frontier.cellsBegin();
+       cell != frontier.cellsEnd(); ++cell) {
+    unsigned int mx, my;
+    double wx, wy;
+    grid.indexToCells(*cell, mx, my);
+    grid.mapToWorld(mx, my, wx, wy);
+    min_distance = std::min(min_distance,
+                            std::hypot(position.x - wx, position.y - wy));
+  }
+  return min_distance;
+}
+
+std::vector<double>
+frontierCosts(const std::vector<frontier_exploration::Frontier>& frontiers,
+              const std::vector<geometry_msgs::Point>& positions,
+              double potential_scale, double gain_scale,
+              std::vector<double>& distances)
+{
+  std::vector<double> costs(positions.size() * frontiers.size());
+  distances.resize(costs.size());
+  for (std::size_t r = 0; r < positions.size(); ++r) {
+    for (std::size_t f = 0; f < frontiers.size(); ++f) {
+      double resolution = frontiers[f].arena->grid.getResolution();
+      double distance = frontierDistance(frontiers[f], positions[r]);
+      distances[r * frontiers.size() + f] = distance;
+      costs[r * frontiers.size() + f] =
+          potential_scale * distance * resolution -
+          gain_scale * frontiers[f].size * resolution;
+    }
+  }
+  return costs;
+}
+
+bool sameGoal(const geometry_msgs::Point& one, const geometry_msgs::Point& two)
+{
+  return std::hypot(one.x - two.x, one.y - two.y) < 0.01;
+}
+
+GoalAction dispatchGoal(GoalProgress& progress,
+                        const geometry_msgs::Point* target, double distance,
+                        const ros::Time& now,
+                        const ros::Duration& progress_timeout)
+{
+  if (!target) {
+    // more robots than frontiers, do not chase frontiers of other robots
+    if (!progress.has_goal) {
+      return GoalAction::KEEP;
+    }
+    progress.has_goal = false;
+    return GoalAction::CANCEL;
+  }
+
+  bool same_goal = progress.has_goal && sameGoal(progress.goal, *target);
+  if (!same_goal || progress.prev_distance > distance) {
+    // we have different goal or we made some progress
+    progress.last_progress = now;
+    progress.prev_distance = distance;
+  }
+  // black list if we've made no progress for a long time
+  if (now - progress.last_progress > progress_timeout) {
+    return GoalAction::BLACKLIST;
+  }
+  if (same_goal) {
+    return GoalAction::KEEP;
+  }
+  progress.has_goal = true;
+  progress.goal = *target;
+  return GoalAction::SEND;
+}
+}
@@ -0,0 +1,155 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/frontier_blacklist.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace explore
+{
+FrontierBlacklist::FrontierBlacklist(double tolerance_cells,
+                                     ros::Duration timeout, size_t max_entries)
+  : tolerance_cells_(tolerance_cells)
+  , timeout_(timeout)
+  , max_entries_(max_entries)
+  , tolerance_(0.)
+  , first_id_(0)
+{
+}
+
+void FrontierBlacklist::setResolution(double resolution)
+{
+  double tolerance = resolution * tolerance_cells_;
+  if (tolerance == tolerance_) {
+    return;
+  }
+
+  // bucket size changed, rebuild index
+  tolerance_ = tolerance;
+  buckets_.clear();
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    index(first_id_ + i);
+  }
+}
+
+void FrontierBlacklist::add(const geometry_msgs::Point& goal,
+                            const ros::Time& stamp)
+{
+  entries_.push_back({goal, stamp});
+  index(first_id_ + entries_.size() - 1);
+  if (max_entries_ > 0 && entries_.size() > max_entries_) {
+    removeOldest();
+  }
+}
+
+bool FrontierBlacklist::contains(const geometry_msgs::Point& goal) const
+{
+  if (tolerance_ <= 0.) {
+    return false;
+  }
+
+  // goals within tolerance are at most in neighbouring buckets
+  for (int dy = -1; dy <= 1; ++dy) {
+    for (int dx = -1; dx <= 1; ++dx) {
+      auto bucket = buckets_.find(bucketKey(goal, dx, dy));
+      if (bucket == buckets_.end()) {
+        continue;
+      }
+      for (std::uint64_t id : bucket->second) {
+        const geometry_msgs::Point& blacklisted =
+            entries_[id - first_id_].goal;
+        if (std::fabs(goal.x - blacklisted.x) < tolerance_ &&
+            std::fabs(goal.y - blacklisted.y) < tolerance_) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void FrontierBlacklist::expire(const ros::Time& now)
+{
+  if (timeout_.isZero()) {
+    return;
+  }
+  while (!entries_.empty() && entries_.front().stamp + timeout_ < now) {
+    ROS_DEBUG("removing goal [%f, %f] from black list",
+              entries_.front().goal.x, entries_.front().goal.y);
+    removeOldest();
+  }
+}
+
+void FrontierBlacklist::clear()
+{
+  first_id_ += entries_.size();
+  entries_.clear();
+  buckets_.clear();
+}
+
+std::uint64_t FrontierBlacklist::bucketKey(const geometry_msgs::Point& goal,
+                                           int dx, int dy) const
+{
+  auto x = static_cast<std::int32_t>(std::floor(goal.x / tolerance_)) + dx;
+  auto y = static_cast<std::int32_t>(std::floor(goal.y / tolerance_)) + dy;
+  return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) |
+         static_cast<std::uint32_t>(y);
+}
+
+void FrontierBlacklist::index(std::uint64_t id)
+{
+  if (tolerance_ <= 0.) {
+    return;
+  }
+  buckets_[bucketKey(entries_[id - first_id_].goal)].push_back(id);
+}
+
+void FrontierBlacklist::removeOldest()
+{
+  if (tolerance_ > 0.) {
+    // oldest entry is the first one in its bucket
+    auto bucket = buckets_.find(bucketKey(entries_.front().goal));
+    bucket->second.erase(bucket->second.begin());
+    if (bucket->second.empty()) {
+      buckets_.erase(bucket);
+    }
+  }
+  entries_.pop_front();
+  ++first_id_;
+}
+
+}  // namespace explore
@@ -8,8 +8,11 @@
 
 #include <explore/costmap_tools.h>
 #include <explore/costmap_client.h>
+#include <explore/grid_kernels.h>
+#include <explore_common/stats.h>
 
 #include <iostream>
+#include <limits>
 #include <random>
 
 namespace frontier_exploration
@@ -17,91 +20,771 @@ namespace frontier_exploration
 using costmap_2d::LETHAL_OBSTACLE;
 using costmap_2d::NO_INFORMATION;
 using costmap_2d::FREE_SPACE;
+namespace stats = explore_common::stats;
+
+namespace
+{
+// classes of cells used by parallel search, frontier cells are marked by
+// markFrontierCandidates()
+enum CellClass : std::uint8_t { OTHER_CELL = 0, FRONTIER_CELL = 1, FREE_CELL };
+
+// size of square tiles processed by parallel search
+constexpr unsigned int tile_size = 128;
+
+// flags of blocks used by hierarchical search, block of only free cells is
+// FREE_BLOCK
+enum BlockClass : std::uint8_t {
+  FREE_BLOCK = 1,
+  UNKNOWN_BLOCK = 2,
+  OTHER_BLOCK = 4
+};
+
+// cells examined by searches
+stats::Counter& cellsVisited()
+{
+  static stats::Counter& counter = stats::counter("cells visited");
+  return counter;
+}
+
+// union-find over cells, parent of root is the root itself
+unsigned int findRoot(std::vector<unsigned int>& parent, unsigned int idx)
+{
+  while (parent[idx] != idx) {
+    // path halving
+    parent[idx] = parent[parent[idx]];
+    idx = parent[idx];
+  }
+  return idx;
+}
+
+unsigned int findRootConst(const std::vector<unsigned int>& parent,
+                           unsigned int idx)
+{
+  while (parent[idx] != idx) {
+    idx = parent[idx];
+  }
+  return idx;
+}
+
+void unite(std::vector<unsigned int>& parent, unsigned int a, unsigned int b)
+{
+  a = findRoot(parent, a);
+  b = findRoot(parent, b);
+  // lower index becomes root, keeps roots inside the tile of processed cells
+  if (a < b) {
+    parent[b] = a;
+  } else if (b < a) {
+    parent[a] = b;
+  }
+}
+}  // namespace
 
 FrontierSearch::FrontierSearch(costmap_2d::Costmap2D* costmap,
                                double potential_scale, double gain_scale,
-                               double min_frontier_size)
+                               double min_frontier_size, SearchMode mode,
+                               unsigned int threads, unsigned int block_size,
+                               bool geodesic_distance)
   : costmap_(costmap)
   , potential_scale_(potential_scale)
   , gain_scale_(gain_scale)
   , min_frontier_size_(min_frontier_size)
+  , mode_(mode)
+  , threads_(threads)
+  , block_size_(std::max(block_size, 1u))
+  // other searches do not record distances
+  , geodesic_distance_(geodesic_distance && mode == SearchMode::BFS)
+  // use a different seed for each simulation run
+  , rng_(std::random_device()())
+  , next_frontier_id_(1)
+  , tracked_size_x_(0)
+  , tracked_size_y_(0)
+  , tracked_origin_x_(0.)
+  , tracked_origin_y_(0.)
+  , tracked_resolution_(0.)
+{
+}
+
+void FrontierSearch::markUpdated(
+    const std::vector<explore::MapRegion>& regions)
+{
+  if (mode_ != SearchMode::INCREMENTAL) {
+    return;
+  }
+  pending_regions_.insert(pending_regions_.end(), regions.begin(),
+                          regions.end());
+}
+
+std::size_t FrontierSearch::workspaceAllocations() const
 {
+  return workspace_.visited_flag.allocations() +
+         workspace_.frontier_flag.allocations() +
+         workspace_.bfs.allocations() + workspace_.frontier_bfs.allocations() +
+         workspace_.block_visited.allocations() +
+         workspace_.vector_allocations;
 }
 
 std::vector<Frontier> FrontierSearch::searchFrom(geometry_msgs::Point position)
+{
+  return searchBest(position, std::numeric_limits<size_t>::max(), {});
+}
+
+std::vector<Frontier>
+FrontierSearch::searchFrom(const costmap_2d::Costmap2D& costmap,
+                           geometry_msgs::Point position)
+{
+  return searchFrom(GridView::fromCostmap(costmap), position);
+}
+
+std::vector<Frontier> FrontierSearch::searchFrom(const GridView& grid,
+                                                 geometry_msgs::Point position)
+{
+  return searchBest(grid, position, std::numeric_limits<size_t>::max(), {});
+}
+
+std::vector<Frontier> FrontierSearch::searchBest(geometry_msgs::Point position,
+                                                 size_t k,
+                                                 const FrontierFilter& reject)
+{
+  // make sure map is consistent and locked for duration of search
+  std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*(costmap_->getMutex()));
+  return searchBest(GridView::fromCostmap(*costmap_), position, k, reject);
+}
+
+std::vector<Frontier> FrontierSearch::searchBest(const GridView& grid,
+                                                 geometry_msgs::Point position,
+                                                 size_t k,
+                                                 const FrontierFilter& reject)
+{
+  static stats::Histogram& latency = stats::histogram("searchFrom");
+  static stats::Counter& frontiers_found = stats::counter("frontiers found");
+  stats::ScopedTimer timer(latency);
+  std::vector<Frontier> frontier_list = findFrontiers(grid, position);
+  frontiers_found.add(frontier_list.size());
+
+  // skip rejected frontiers before computing their costs
+  if (reject) {
+    frontier_list.erase(std::remove_if(frontier_list.begin(),
+                                       frontier_list.end(), reject),
+                        frontier_list.end());
+  }
+
+  // set costs of frontiers
+  for (auto& frontier : frontier_list) {
+    frontier.cost = frontierCost(frontier, position);
+  }
+  auto cheaper = [](const Frontier& f1, const Frontier& f2) {
+    return f1.cost < f2.cost;
+  };
+  if (k < frontier_list.size()) {
+    std::partial_sort(frontier_list.begin(), frontier_list.begin() + k,
+                      frontier_list.end(), cheaper);
+    frontier_list.resize(k);
+  } else {
+    std::sort(frontier_list.begin(), frontier_list.end(), cheaper);
+  }
+
+  return frontier_list;
+}
+
+std::vector<Frontier> FrontierSearch::findFrontiers(const GridView& grid,
+                                                    geometry_msgs::Point position)
 {
   std::vector<Frontier> frontier_list;
+  grid_ = grid;
 
   // Sanity check that robot is inside costmap bounds before searching
   unsigned int mx, my;
-  if (!costmap_->worldToMap(position.x, position.y, mx, my)) {
+  if (!grid_.worldToMap(position.x, position.y, mx, my)) {
     ROS_ERROR("Robot out of costmap bounds, cannot search for frontiers");
     return frontier_list;
   }
 
-  // make sure map is consistent and locked for duration of search
-  std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*(costmap_->getMutex()));
+  map_ = grid_.getCharMap();
+  size_x_ = grid_.getSizeInCellsX();
+  size_y_ = grid_.getSizeInCellsY();
 
-  map_ = costmap_->getCharMap();
-  size_x_ = costmap_->getSizeInCellsX();
-  size_y_ = costmap_->getSizeInCellsY();
+  // frontiers of the previous search may still reference the arena
+  if (!arena_ || arena_.use_count() > 1) {
+    arena_ = std::make_shared<FrontierArena>();
+    ++workspace_.vector_allocations;
+  }
+  arena_->cells.clear();
+  arena_->grid = GridView(nullptr, size_x_, size_y_, grid_.getResolution(),
+                          grid_.getOriginX(), grid_.getOriginY());
+  size_t arena_capacity = arena_->cells.capacity();
 
-  // initialize flag arrays to keep track of visited and frontier cells
-  std::vector<bool> frontier_flag(size_x_ * size_y_, false);
-  std::vector<bool> visited_flag(size_x_ * size_y_, false);
+  unsigned int pos = grid_.getIndex(mx, my);
+  switch (mode_) {
+    case SearchMode::BFS:
+      frontier_list = searchBfs(pos);
+      break;
+    case SearchMode::INCREMENTAL:
+      frontier_list = searchIncremental(pos);
+      break;
+    case SearchMode::PARALLEL:
+      frontier_list = searchParallel(pos);
+      break;
+    case SearchMode::HIERARCHICAL:
+      frontier_list = searchHierarchical(pos);
+      break;
+  }
 
-  // initialize breadth first search
-  std::queue<unsigned int> bfs;
+  if (arena_->cells.capacity() != arena_capacity) {
+    ++workspace_.vector_allocations;
+  }
+
+  return frontier_list;
+}
+
+std::vector<Frontier> FrontierSearch::searchBfs(unsigned int pos)
+{
+  std::vector<Frontier> frontier_list;
 
   // find closest clear cell to start search
-  unsigned int clear, pos = costmap_->getIndex(mx, my);
-  if (nearestCell(clear, pos, FREE_SPACE, *costmap_)) {
+  CellFlags& visited_flag = workspace_.visited_flag;
+  CellQueue& bfs = workspace_.bfs;
+  unsigned int clear;
+  bool found_clear =
+      nearestCell(clear, pos, FREE_SPACE, grid_, visited_flag, bfs);
+
+  // initialize flags to keep track of visited and frontier cells
+  CellFlags& frontier_flag = workspace_.frontier_flag;
+  frontier_flag.reset(size_x_ * size_y_);
+  visited_flag.reset(size_x_ * size_y_);
+
+  // hop distances are valid only for visited cells
+  std::vector<unsigned int>& distance = workspace_.distance;
+  if (geodesic_distance_ && distance.size() != size_x_ * size_y_) {
+    if (distance.capacity() < size_x_ * size_y_) {
+      ++workspace_.vector_allocations;
+    }
+    distance.resize(size_x_ * size_y_);
+  }
+
+  // initialize breadth first search
+  bfs.reset(size_x_ * size_y_);
+  if (found_clear) {
     bfs.push(clear);
   } else {
     bfs.push(pos);
     ROS_WARN("Could not find nearby clear cell to start search");
   }
-  visited_flag[bfs.front()] = true;
+  visited_flag.set(bfs.front());
+  if (geodesic_distance_) {
+    distance[bfs.front()] = 0;
+  }
 
+  size_t visited = 0;
   while (!bfs.empty()) {
     unsigned int idx = bfs.front();
     bfs.pop();
+    ++visited;
 
     // iterate over 4-connected neighbourhood
-    for (unsigned nbr : nhood4(idx, *costmap_)) {
+    for (unsigned nbr : nhood4(idx, size_x_, size_y_)) {
       // add to queue all free, unvisited cells, use descending search in case
       // initialized on non-free cell
-      if (map_[nbr] <= map_[idx] && !visited_flag[nbr]) {
-        visited_flag[nbr] = true;
+      if (map_[nbr] <= map_[idx] && !visited_flag.test(nbr)) {
+        visited_flag.set(nbr);
+        if (geodesic_distance_) {
+          distance[nbr] = distance[idx] + 1;
+        }
         bfs.push(nbr);
         // check if cell is new frontier cell (unvisited, NO_INFORMATION, free
         // neighbour)
       } else if (isNewFrontierCell(nbr, frontier_flag)) {
-        frontier_flag[nbr] = true;
+        frontier_flag.set(nbr);
         Frontier new_frontier = buildNewFrontier(nbr, pos, frontier_flag);
-        if (new_frontier.size * costmap_->getResolution() >=
+        if (geodesic_distance_) {
+          // cells are popped in order of their hop distance, no other cell of
+          // this frontier is closer
+          new_frontier.min_distance =
+              (distance[idx] + 1) * grid_.getResolution();
+          new_frontier.middle = new_frontier.initial;
+        }
+        if (new_frontier.size * grid_.getResolution() >=
             min_frontier_size_) {
           frontier_list.push_back(new_frontier);
+        } else {
+          // drop cells of the last frontier
+          arena_->cells.resize(new_frontier.first_cell);
         }
       }
     }
   }
+  cellsVisited().add(visited);
 
-  // set costs of frontiers
-  for (auto& frontier : frontier_list) {
-    frontier.cost = frontierCost(frontier, position);
+  return frontier_list;
+}
+
+std::vector<Frontier> FrontierSearch::searchParallel(unsigned int pos)
+{
+  std::vector<Frontier> frontier_list;
+
+  // reachable space is the free space connected to the closest clear cell
+  unsigned int start;
+  if (!nearestCell(start, pos, FREE_SPACE, grid_, workspace_.visited_flag,
+                   workspace_.bfs)) {
+    ROS_WARN("Could not find nearby clear cell to start search");
+    return searchBfs(pos);
+  }
+
+  size_t cells = size_x_ * size_y_;
+  std::vector<std::uint8_t>& cell_class = workspace_.cell_class;
+  std::vector<unsigned int>& parent = workspace_.parent;
+  std::vector<std::vector<unsigned int>>& tile_frontier_cells =
+      workspace_.tile_frontier_cells;
+  if (cell_class.size() != cells) {
+    if (cell_class.capacity() < cells) {
+      workspace_.vector_allocations += 2;
+    }
+    cell_class.resize(cells);
+    parent.resize(cells);
+  }
+  const unsigned int tiles_x = (size_x_ + tile_size - 1) / tile_size;
+  const unsigned int tiles_y = (size_y_ + tile_size - 1) / tile_size;
+  const size_t tiles = size_t(tiles_x) * tiles_y;
+  if (tile_frontier_cells.size() < tiles) {
+    workspace_.vector_allocations += 3;
+    tile_frontier_cells.resize(tiles);
+    workspace_.tile_groups.resize(tiles);
+    workspace_.tile_contacts.resize(tiles);
+  }
+  // sum of capacities of vectors growing with the number of frontier cells
+  auto workspaceCapacity = [this]() {
+    size_t result = workspace_.frontier_groups.capacity() +
+                    workspace_.frontier_contacts.capacity() +
+                    workspace_.stack.capacity();
+    for (size_t tile = 0; tile < workspace_.tile_frontier_cells.size();
+         ++tile) {
+      result += workspace_.tile_frontier_cells[tile].capacity() +
+                workspace_.tile_groups[tile].capacity() +
+                workspace_.tile_contacts[tile].capacity();
+    }
+    return result;
+  };
+  const size_t capacity = workspaceCapacity();
+  // all cells are classified
+  cellsVisited().add(cells);
+
+  // classify cells and label components inside each tile. Tiles touch only
+  // their own cells in cell_class and parent.
+  workers().parallelFor(tiles, [&, this](size_t tile) {
+    unsigned int x0 = static_cast<unsigned int>(tile % tiles_x) * tile_size;
+    unsigned int y0 = static_cast<unsigned int>(tile / tiles_x) * tile_size;
+    unsigned int xn = std::min(x0 + tile_size, size_x_);
+    unsigned int yn = std::min(y0 + tile_size, size_y_);
+    std::vector<unsigned int>& frontier_cells = tile_frontier_cells[tile];
+    frontier_cells.clear();
+    markFrontierCandidates(map_, size_x_, size_y_, x0, y0, xn, yn,
+                           cell_class.data());
+
+    for (unsigned int y = y0; y < yn; ++y) {
+      for (unsigned int x = x0; x < xn; ++x) {
+        unsigned int idx = y * size_x_ + x;
+        parent[idx] = idx;
+        if (map_[idx] == FREE_SPACE) {
+          // free space is 4-connected
+          cell_class[idx] = FREE_CELL;
+          if (x > x0 && cell_class[idx - 1] == FREE_CELL) {
+            unite(parent, idx - 1, idx);
+          }
+          if (y > y0 && cell_class[idx - size_x_] == FREE_CELL) {
+            unite(parent, idx - size_x_, idx);
+          }
+        } else if (cell_class[idx] == FRONTIER_CELL) {
+          // frontiers are 8-connected
+          frontier_cells.push_back(idx);
+          if (x > x0 && cell_class[idx - 1] == FRONTIER_CELL) {
+            unite(parent, idx - 1, idx);
+          }
+          if (y > y0) {
+            unsigned int up = idx - size_x_;
+            if (cell_class[up] == FRONTIER_CELL) {
+              unite(parent, up, idx);
+            }
+            if (x > x0 && cell_class[up - 1] == FRONTIER_CELL) {
+              unite(parent, up - 1, idx);
+            }
+            if (x + 1 < xn && cell_class[up + 1] == FRONTIER_CELL) {
+              unite(parent, up + 1, idx);
+            }
+          }
+        }
+      }
+    }
+  });
+
+  // merge components across tile borders
+  for (unsigned int x = tile_size; x < size_x_; x += tile_size) {
+    for (unsigned int y = 0; y < size_y_; ++y) {
+      unsigned int idx = y * size_x_ + x;
+      unsigned int left = idx - 1;
+      if (cell_class[idx] == FREE_CELL && cell_class[left] == FREE_CELL) {
+        unite(parent, left, idx);
+      } else if (cell_class[idx] == FRONTIER_CELL) {
+        if (cell_class[left] == FRONTIER_CELL) {
+          unite(parent, left, idx);
+        }
+        if (y > 0 && cell_class[left - size_x_] == FRONTIER_CELL) {
+          unite(parent, left - size_x_, idx);
+        }
+        if (y + 1 < size_y_ && cell_class[left + size_x_] == FRONTIER_CELL) {
+          unite(parent, left + size_x_, idx);
+        }
+      }
+    }
+  }
+  for (unsigned int y = tile_size; y < size_y_; y += tile_size) {
+    for (unsigned int x = 0; x < size_x_; ++x) {
+      unsigned int idx = y * size_x_ + x;
+      unsigned int up = idx - size_x_;
+      if (cell_class[idx] == FREE_CELL && cell_class[up] == FREE_CELL) {
+        unite(parent, up, idx);
+      } else if (cell_class[idx] == FRONTIER_CELL) {
+        if (cell_class[up] == FRONTIER_CELL) {
+          unite(parent, up, idx);
+        }
+        if (x > 0 && cell_class[up - 1] == FRONTIER_CELL) {
+          unite(parent, up - 1, idx);
+        }
+        if (x + 1 < size_x_ && cell_class[up + 1] == FRONTIER_CELL) {
+          unite(parent, up + 1, idx);
+        }
+      }
+    }
+  }
+
+  // check reachability of frontier cells. Parent links are only read here.
+  const unsigned int start_root = findRoot(parent, start);
+  workers().parallelFor(tiles, [&, this](size_t tile) {
+    std::vector<std::pair<unsigned int, unsigned int>>& tile_groups =
+        workspace_.tile_groups[tile];
+    std::vector<std::pair<unsigned int, unsigned int>>& tile_contacts =
+        workspace_.tile_contacts[tile];
+    tile_groups.clear();
+    tile_contacts.clear();
+    for (unsigned int idx : tile_frontier_cells[tile]) {
+      unsigned int root = findRootConst(parent, idx);
+      tile_groups.emplace_back(root, idx);
+      for (unsigned int nbr : nhood4(idx, size_x_, size_y_)) {
+        if (cell_class[nbr] == FREE_CELL &&
+            findRootConst(parent, nbr) == start_root) {
+          tile_contacts.emplace_back(root, idx);
+          break;
+        }
+      }
+    }
+  });
+
+  // group frontier cells by their components
+  std::vector<std::pair<unsigned int, unsigned int>>& groups =
+      workspace_.frontier_groups;
+  std::vector<std::pair<unsigned int, unsigned int>>& contacts =
+      workspace_.frontier_contacts;
+  groups.clear();
+  contacts.clear();
+  for (size_t tile = 0; tile < tiles; ++tile) {
+    groups.insert(groups.end(), workspace_.tile_groups[tile].begin(),
+                  workspace_.tile_groups[tile].end());
+    contacts.insert(contacts.end(), workspace_.tile_contacts[tile].begin(),
+                    workspace_.tile_contacts[tile].end());
+  }
+  std::sort(groups.begin(), groups.end());
+  std::sort(contacts.begin(), contacts.end());
+
+  // build frontiers touching free space reachable from the robot
+  std::vector<unsigned int>& frontier_cells = workspace_.stack;
+  auto contact = contacts.begin();
+  for (auto it = groups.begin(); it != groups.end();) {
+    unsigned int root = it->first;
+    frontier_cells.clear();
+    for (; it != groups.end() && it->first == root; ++it) {
+      frontier_cells.push_back(it->second);
+    }
+
+    while (contact != contacts.end() && contact->first < root) {
+      ++contact;
+    }
+    if (contact == contacts.end() || contact->first != root) {
+      continue;
+    }
+    if (frontier_cells.size() * grid_.getResolution() >=
+        min_frontier_size_) {
+      frontier_list.push_back(frontierFromCells(frontier_cells, pos));
+      // record initial contact point for frontier
+      unsigned int ix, iy;
+      grid_.indexToCells(contact->second, ix, iy);
+      grid_.mapToWorld(ix, iy, frontier_list.back().initial.x,
+                           frontier_list.back().initial.y);
+    }
+  }
+
+  // capacities only grow, any difference means reallocation
+  if (workspaceCapacity() != capacity) {
+    ++workspace_.vector_allocations;
   }
-  std::sort(
-      frontier_list.begin(), frontier_list.end(),
-      [](const Frontier& f1, const Frontier& f2) { return f1.cost < f2.cost; });
 
   return frontier_list;
 }
 
+std::vector<Frontier> FrontierSearch::searchHierarchical(unsigned int pos)
+{
+  std::vector<Frontier> frontier_list;
+
+  // find closest clear cell to start search
+  unsigned int start;
+  if (!nearestCell(start, pos, FREE_SPACE, grid_, workspace_.visited_flag,
+                   workspace_.bfs)) {
+    ROS_WARN("Could not find nearby clear cell to start search");
+    return searchBfs(pos);
+  }
+
+  buildBlockLevels();
+  const unsigned int block_size = block_size_;
+  const std::vector<std::uint8_t>& block_class = workspace_.block_class;
+  const std::vector<size_t>& level_offsets = workspace_.level_offsets;
+  const std::vector<unsigned int>& level_widths = workspace_.level_widths;
+  const unsigned int levels = static_cast<unsigned int>(level_widths.size());
+  const unsigned int blocks_x = level_widths[0];
+
+  CellFlags& visited_flag = workspace_.visited_flag;
+  CellFlags& block_visited = workspace_.block_visited;
+  CellFlags& frontier_flag = workspace_.frontier_flag;
+  CellQueue& bfs = workspace_.bfs;
+  visited_flag.reset(size_x_ * size_y_);
+  block_visited.reset(level_offsets[levels]);
+  frontier_flag.reset(size_x_ * size_y_);
+  // every cell is queued at most once, free blocks only by one of their cells
+  bfs.reset(size_x_ * size_y_);
+
+  // finds the largest uniformly free block containing cell, returns false if
+  // the block of the finest level is not free. Block is identified by its
+  // level and coordinates in the level.
+  auto freeBlock = [&, this](unsigned int idx, unsigned int& level,
+                             unsigned int& bx, unsigned int& by) {
+    unsigned int mx, my;
+    grid_.indexToCells(idx, mx, my);
+    bx = mx / block_size;
+    by = my / block_size;
+    if (block_class[by * blocks_x + bx] != FREE_BLOCK) {
+      return false;
+    }
+    level = 0;
+    while (level + 1 < levels &&
+           block_class[level_offsets[level + 1] +
+                       (by / 2) * level_widths[level + 1] + bx / 2] ==
+               FREE_BLOCK) {
+      bx /= 2;
+      by /= 2;
+      ++level;
+    }
+    return true;
+  };
+  // queues free cell, free block is visited as a whole
+  auto visit = [&](unsigned int idx) {
+    unsigned int level, bx, by;
+    if (freeBlock(idx, level, bx, by)) {
+      size_t block =
+          level_offsets[level] + size_t(by) * level_widths[level] + bx;
+      if (!block_visited.test(block)) {
+        block_visited.set(block);
+        bfs.push(idx);
+      }
+    } else if (!visited_flag.test(idx)) {
+      visited_flag.set(idx);
+      bfs.push(idx);
+    }
+  };
+  // examines neighbour of reachable free cell
+  auto expand = [&, this](unsigned int nbr) {
+    if (map_[nbr] == FREE_SPACE) {
+      visit(nbr);
+    } else if (isNewFrontierCell(nbr, frontier_flag)) {
+      frontier_flag.set(nbr);
+      Frontier new_frontier = buildNewFrontier(nbr, pos, frontier_flag);
+      if (new_frontier.size * grid_.getResolution() >= min_frontier_size_) {
+        frontier_list.push_back(new_frontier);
+      } else {
+        // drop cells of the last frontier
+        arena_->cells.resize(new_frontier.first_cell);
+      }
+    }
+  };
+  // examines cells [x0, xn) of row y by blocks of the finest level, free block
+  // is visited without examining its cells. x0 is aligned to blocks.
+  auto expandRow = [&, this](unsigned int y, unsigned int x0,
+                             unsigned int xn) {
+    const size_t row = size_t(y / block_size) * blocks_x;
+    for (unsigned int bx0 = x0; bx0 < xn; bx0 += block_size) {
+      if (block_class[row + bx0 / block_size] == FREE_BLOCK) {
+        visit(grid_.getIndex(bx0, y));
+        continue;
+      }
+      unsigned int bxn = std::min(bx0 + block_size, xn);
+      for (unsigned int x = bx0; x < bxn; ++x) {
+        expand(grid_.getIndex(x, y));
+      }
+    }
+  };
+  // the same for cells [y0, yn) of column x
+  auto expandColumn = [&, this](unsigned int x, unsigned int y0,
+                                unsigned int yn) {
+    const unsigned int column = x / block_size;
+    for (unsigned int by0 = y0; by0 < yn; by0 += block_size) {
+      if (block_class[size_t(by0 / block_size) * blocks_x + column] ==
+          FREE_BLOCK) {
+        visit(grid_.getIndex(x, by0));
+        continue;
+      }
+      unsigned int byn = std::min(by0 + block_size, yn);
+      for (unsigned int y = by0; y < byn; ++y) {
+        expand(grid_.getIndex(x, y));
+      }
+    }
+  };
+
+  visit(start);
+  size_t visited = 0;
+  while (!bfs.empty()) {
+    unsigned int idx = bfs.front();
+    bfs.pop();
+    ++visited;
+
+    unsigned int level, bx, by;
+    if (!freeBlock(idx, level, bx, by)) {
+      for (unsigned int nbr : nhood4(idx, size_x_, size_y_)) {
+        expand(nbr);
+      }
+      continue;
+    }
+
+    // whole block is reachable, only cells around its border can be reached
+    // from it
+    const unsigned int side = block_size << level;
+    unsigned int x0 = bx * side;
+    unsigned int y0 = by * side;
+    unsigned int xn = std::min(x0 + side, size_x_);
+    unsigned int yn = std::min(y0 + side, size_y_);
+    if (y0 > 0) {
+      expandRow(y0 - 1, x0, xn);
+    }
+    if (yn < size_y_) {
+      expandRow(yn, x0, xn);
+    }
+    if (x0 > 0) {
+      expandColumn(x0 - 1, y0, yn);
+    }
+    if (xn < size_x_) {
+      expandColumn(xn, y0, yn);
+    }
+  }
+  cellsVisited().add(visited);
+
+  return frontier_list;
+}
+
+void FrontierSearch::buildBlockLevels()
+{
+  const unsigned int block_size = block_size_;
+  const unsigned int blocks_x = (size_x_ + block_size - 1) / block_size;
+  const unsigned int blocks_y = (size_y_ + block_size - 1) / block_size;
+
+  // levels are stored one after another, each block of a level groups 2x2
+  // blocks of the finer level. The coarsest level has a single block.
+  std::vector<size_t>& level_offsets = workspace_.level_offsets;
+  std::vector<unsigned int>& level_widths = workspace_.level_widths;
+  const size_t levels_capacity =
+      level_offsets.capacity() + level_widths.capacity();
+  level_offsets.clear();
+  level_widths.clear();
+  size_t blocks = 0;
+  for (unsigned int width = blocks_x, height = blocks_y;;
+       width = (width + 1) / 2, height = (height + 1) / 2) {
+    level_offsets.push_back(blocks);
+    level_widths.push_back(width);
+    blocks += size_t(width) * height;
+    if (width == 1 && height == 1) {
+      break;
+    }
+  }
+  level_offsets.push_back(blocks);
+  if (level_offsets.capacity() + level_widths.capacity() != levels_capacity) {
+    ++workspace_.vector_allocations;
+  }
+
+  std::vector<std::uint8_t>& block_class = workspace_.block_class;
+  if (block_class.size() != blocks) {
+    if (block_class.capacity() < blocks) {
+      ++workspace_.vector_allocations;
+    }
+    block_class.resize(blocks);
+  }
+
+  // levels are rebuilt on every search, a linear scan is much cheaper than the
+  // search itself. Rows of blocks of the finest level are independent.
+  workers().parallelFor(blocks_y, [&, this](size_t by) {
+    std::uint8_t* row_class = block_class.data() + by * blocks_x;
+    std::fill(row_class, row_class + blocks_x, 0);
+    unsigned int y0 = static_cast<unsigned int>(by) * block_size;
+    unsigned int yn = std::min(y0 + block_size, size_y_);
+    for (unsigned int y = y0; y < yn; ++y) {
+      const unsigned char* row = map_ + size_t(y) * size_x_;
+      for (unsigned int bx = 0; bx < blocks_x; ++bx) {
+        unsigned int x0 = bx * block_size;
+        unsigned int xn = std::min(x0 + block_size, size_x_);
+        // rows of uniform blocks are recognized by vectorized reductions
+        unsigned char any_bits = 0;
+        unsigned char all_bits = 0xff;
+        for (unsigned int x = x0; x < xn; ++x) {
+          any_bits |= row[x];
+          all_bits &= row[x];
+        }
+        if (any_bits == FREE_SPACE) {
+          row_class[bx] |= FREE_BLOCK;
+          continue;
+        }
+        if (all_bits == NO_INFORMATION) {
+          row_class[bx] |= UNKNOWN_BLOCK;
+          continue;
+        }
+        for (unsigned int x = x0; x < xn; ++x) {
+          unsigned char cost = row[x];
+          if (cost == FREE_SPACE) {
+            row_class[bx] |= FREE_BLOCK;
+          } else if (cost == NO_INFORMATION) {
+            row_class[bx] |= UNKNOWN_BLOCK;
+          } else {
+            row_class[bx] |= OTHER_BLOCK;
+          }
+        }
+      }
+    }
+  });
+
+  // each coarser level has a quarter of blocks of the finer level
+  for (size_t level = 1; level + 1 < level_offsets.size(); ++level) {
+    const std::uint8_t* fine = block_class.data() + level_offsets[level - 1];
+    std::uint8_t* coarse = block_class.data() + level_offsets[level];
+    const unsigned int fine_width = level_widths[level - 1];
+    const size_t fine_blocks = level_offsets[level] - level_offsets[level - 1];
+    const unsigned int width = level_widths[level];
+    std::fill(coarse, block_class.data() + level_offsets[level + 1], 0);
+    for (size_t i = 0; i < fine_blocks; ++i) {
+      size_t x = i % fine_width;
+      size_t y = i / fine_width;
+      coarse[(y / 2) * width + x / 2] |= fine[i];
+    }
+  }
+}
+
 Frontier FrontierSearch::buildNewFrontier(unsigned int initial_cell,
                                           unsigned int reference,
-                                          std::vector<bool>& frontier_flag)
+                                          CellFlags& frontier_flag)
 {
+  static stats::Histogram& latency = stats::histogram("buildNewFrontier");
+  stats::ScopedTimer timer(latency);
+
   // initialize frontier structure
   Frontier output;
   output.centroid.x = 0;
@@ -111,38 +794,42 @@ Frontier FrontierSearch::buildNewFrontier(unsigned int initial_cell,
 
   // record initial contact point for frontier
   unsigned int ix, iy;
-  costmap_->indexToCells(initial_cell, ix, iy);
-  costmap_->mapToWorld(ix, iy, output.initial.x, output.initial.y);   // shows that frontier is in world coordinates 
+  grid_.indexToCells(initial_cell, ix, iy);
+  grid_.mapToWorld(ix, iy, output.initial.x, output.initial.y);   // shows that frontier is in world coordinates 
 
   // push initial gridcell onto queue
-  std::queue<unsigned int> bfs;
+  CellQueue& bfs = workspace_.frontier_bfs;
+  bfs.reset(size_x_ * size_y_);
   bfs.push(initial_cell);
 
+  // cells are stored in arena, statistics do not include the initial cell
+  std::vector<std::uint32_t>& cells = arena_->cells;
+  output.arena = arena_;
+  output.first_cell = static_cast<std::uint32_t>(cells.size());
+  cells.push_back(initial_cell);
+
   // cache reference position in world coords
   unsigned int rx, ry;
   double reference_x, reference_y;
-  costmap_->indexToCells(reference, rx, ry);
-  costmap_->mapToWorld(rx, ry, reference_x, reference_y);
+  grid_.indexToCells(reference, rx, ry);
+  grid_.mapToWorld(rx, ry, reference_x, reference_y);
 
   while (!bfs.empty()) {
     unsigned int idx = bfs.front();
     bfs.pop();
 
     // try adding cells in 8-connected neighborhood to frontier
-    for (unsigned int nbr : nhood8(idx, *costmap_)) {
+    for (unsigned int nbr : nhood8(idx, size_x_, size_y_)) {
       // check if neighbour is a potential frontier cell
       if (isNewFrontierCell(nbr, frontier_flag)) {
         // mark cell as frontier
-        frontier_flag[nbr] = true;
+        frontier_flag.set(nbr);
         unsigned int mx, my;
         double wx, wy;
-        costmap_->indexToCells(nbr, mx, my);
-        costmap_->mapToWorld(mx, my, wx, wy);
+        grid_.indexToCells(nbr, mx, my);
+        grid_.mapToWorld(mx, my, wx, wy);
 
-        geometry_msgs::Point point;
-        point.x = wx;
-        point.y = wy;
-        output.points.push_back(point);
+        cells.push_back(nbr);
 
         // update frontier size
         output.size++;
@@ -152,13 +839,15 @@ Frontier FrontierSearch::buildNewFrontier(unsigned int initial_cell,
         output.centroid.y += wy;
 
         // determine frontier's distance from robot, going by closest gridcell
-        // to robot
-        double distance = sqrt(pow((double(reference_x) - double(wx)), 2.0) +
-                               pow((double(reference_y) - double(wy)), 2.0));
-        if (distance < output.min_distance) {
-          output.min_distance = distance;
-          output.middle.x = wx;
-          output.middle.y = wy;
+        // to robot. Geodesic distance is filled by the search.
+        if (!geodesic_distance_) {
+          double distance = sqrt(pow((double(reference_x) - double(wx)), 2.0) +
+                                 pow((double(reference_y) - double(wy)), 2.0));
+          if (distance < output.min_distance) {
+            output.min_distance = distance;
+            output.middle.x = wx;
+            output.middle.y = wy;
+          }
         }
 
         // add to queue for breadth first search
@@ -174,16 +863,214 @@ Frontier FrontierSearch::buildNewFrontier(unsigned int initial_cell,
 }
 
 bool FrontierSearch::isNewFrontierCell(unsigned int idx,
-                                       const std::vector<bool>& frontier_flag)
+                                       const CellFlags& frontier_flag)
 {
-  // check that cell is unknown and not already marked as frontier
-  if (map_[idx] != NO_INFORMATION || frontier_flag[idx]) {
+  // check that cell is not already marked as frontier
+  if (frontier_flag.test(idx)) {
+    return false;
+  }
+
+  return isFrontierCell(idx);
+}
+
+std::vector<Frontier> FrontierSearch::searchIncremental(unsigned int reference)
+{
+  // map has been resized or moved, cells of tracked frontiers no longer match
+  // cells of the map, we need to start from scratch
+  if (size_x_ != tracked_size_x_ || size_y_ != tracked_size_y_ ||
+      grid_.getOriginX() != tracked_origin_x_ ||
+      grid_.getOriginY() != tracked_origin_y_ ||
+      grid_.getResolution() != tracked_resolution_) {
+    ROS_DEBUG("costmap resized or moved, rebuilding all frontiers");
+    tracked_size_x_ = size_x_;
+    tracked_size_y_ = size_y_;
+    tracked_origin_x_ = grid_.getOriginX();
+    tracked_origin_y_ = grid_.getOriginY();
+    tracked_resolution_ = grid_.getResolution();
+    frontier_cell_.assign(size_x_ * size_y_, false);
+    if (workspace_.candidates.capacity() < size_x_ * size_y_) {
+      ++workspace_.vector_allocations;
+    }
+    workspace_.candidates.resize(size_x_ * size_y_);
+    frontier_id_.assign(size_x_ * size_y_, 0);
+    frontier_cells_.clear();
+    pending_regions_.clear();
+    pending_regions_.push_back({0, 0, size_x_, size_y_});
+  }
+
+  for (auto& region : pending_regions_) {
+    updateFrontierCells(region);
+  }
+  ROS_DEBUG("updated %lu regions, tracking %lu frontiers",
+            pending_regions_.size(), frontier_cells_.size());
+  pending_regions_.clear();
+
+  std::vector<Frontier> frontier_list;
+  for (auto& frontier : frontier_cells_) {
+    if (frontier.second.size() * grid_.getResolution() >=
+        min_frontier_size_) {
+      frontier_list.push_back(frontierFromCells(frontier.second, reference));
+    }
+  }
+
+  return frontier_list;
+}
+
+void FrontierSearch::updateFrontierCells(const explore::MapRegion& region)
+{
+  // rectangle of region enlarged by margin, clamped to map
+  auto expand = [this, &region](unsigned int margin) {
+    explore::MapRegion r;
+    r.x0 = region.x0 > margin ? region.x0 - margin : 0;
+    r.y0 = region.y0 > margin ? region.y0 - margin : 0;
+    r.xn = std::min(region.xn + margin, size_x_);
+    r.yn = std::min(region.yn + margin, size_y_);
+    return r;
+  };
+
+  // frontier status depends on 4-connected neighbourhood, cells next to the
+  // region must be relabeled as well
+  explore::MapRegion relabeled = expand(1);
+  // frontiers are 8-connected, any frontier touching relabeled cells may be
+  // split or merged with others
+  explore::MapRegion touched = expand(2);
+  cellsVisited().add(size_t(touched.xn - touched.x0) *
+                     (touched.yn - touched.y0));
+
+  std::vector<unsigned int>& seeds = workspace_.seeds;
+  std::vector<unsigned int>& stack = workspace_.stack;
+  size_t seeds_capacity = seeds.capacity();
+  size_t stack_capacity = stack.capacity();
+  seeds.clear();
+  markFrontierCandidates(map_, size_x_, size_y_, relabeled.x0, relabeled.y0,
+                         relabeled.xn, relabeled.yn,
+                         workspace_.candidates.data());
+  for (unsigned int y = relabeled.y0; y < relabeled.yn; ++y) {
+    for (unsigned int x = relabeled.x0; x < relabeled.xn; ++x) {
+      unsigned int idx = grid_.getIndex(x, y);
+      frontier_cell_[idx] = workspace_.candidates[idx];
+      if (frontier_cell_[idx]) {
+        seeds.push_back(idx);
+      }
+    }
+  }
+
+  // dissolve touched frontiers, their cells will be regrouped
+  for (unsigned int y = touched.y0; y < touched.yn; ++y) {
+    for (unsigned int x = touched.x0; x < touched.xn; ++x) {
+      unsigned int id = frontier_id_[grid_.getIndex(x, y)];
+      if (id == 0) {
+        continue;
+      }
+      auto frontier = frontier_cells_.find(id);
+      for (unsigned int idx : frontier->second) {
+        frontier_id_[idx] = 0;
+        seeds.push_back(idx);
+      }
+      frontier_cells_.erase(frontier);
+    }
+  }
+
+  // grow new frontiers from seeds over 8-connected frontier cells
+  for (unsigned int seed : seeds) {
+    if (!frontier_cell_[seed] || frontier_id_[seed] != 0) {
+      continue;
+    }
+    unsigned int id = next_frontier_id_++;
+    if (id == 0) {
+      // skip reserved value on wraparound
+      id = next_frontier_id_++;
+    }
+    std::vector<unsigned int>& cells = frontier_cells_[id];
+    frontier_id_[seed] = id;
+    stack.push_back(seed);
+    while (!stack.empty()) {
+      unsigned int idx = stack.back();
+      stack.pop_back();
+      cells.push_back(idx);
+      for (unsigned int nbr : nhood8(idx, size_x_, size_y_)) {
+        if (frontier_cell_[nbr] && frontier_id_[nbr] == 0) {
+          frontier_id_[nbr] = id;
+          stack.push_back(nbr);
+        }
+      }
+    }
+  }
+
+  if (seeds.capacity() != seeds_capacity) {
+    ++workspace_.vector_allocations;
+  }
+  if (stack.capacity() != stack_capacity) {
+    ++workspace_.vector_allocations;
+  }
+}
+
+Frontier FrontierSearch::frontierFromCells(
+    const std::vector<unsigned int>& cells, unsigned int reference)
+{
+  Frontier output;
+  output.centroid.x = 0;
+  output.centroid.y = 0;
+  output.size = static_cast<std::uint32_t>(cells.size());
+  output.min_distance = std::numeric_limits<double>::infinity();
+  output.arena = arena_;
+  output.first_cell = static_cast<std::uint32_t>(arena_->cells.size());
+  arena_->cells.insert(arena_->cells.end(), cells.begin(), cells.end());
+
+  // record initial contact point for frontier
+  unsigned int ix, iy;
+  grid_.indexToCells(cells.front(), ix, iy);
+  grid_.mapToWorld(ix, iy, output.initial.x, output.initial.y);
+
+  // cache reference position in world coords
+  unsigned int rx, ry;
+  double reference_x, reference_y;
+  grid_.indexToCells(reference, rx, ry);
+  grid_.mapToWorld(rx, ry, reference_x, reference_y);
+
+  for (unsigned int idx : cells) {
+    unsigned int mx, my;
+    geometry_msgs::Point point;
+    grid_.indexToCells(idx, mx, my);
+    grid_.mapToWorld(mx, my, point.x, point.y);
+
+    output.centroid.x += point.x;
+    output.centroid.y += point.y;
+
+    // determine frontier's distance from robot, going by closest gridcell
+    // to robot
+    double distance = std::hypot(reference_x - point.x, reference_y - point.y);
+    if (distance < output.min_distance) {
+      output.min_distance = distance;
+      output.middle = point;
+    }
+  }
+
+  // average out frontier centroid
+  output.centroid.x /= output.size;
+  output.centroid.y /= output.size;
+  return output;
+}
+
+explore_common::WorkerPool& FrontierSearch::workers()
+{
+  // threads are started by the first parallel search and kept for others
+  if (!workers_) {
+    workers_.reset(new explore_common::WorkerPool(threads_));
+  }
+  return *workers_;
+}
+
+bool FrontierSearch::isFrontierCell(unsigned int idx)
+{
+  // check that cell is unknown
+  if (map_[idx] != NO_INFORMATION) {
     return false;
   }
 
   // frontier cells should have at least one cell in 4-connected neighbourhood
   // that is free
-  for (unsigned int nbr : nhood4(idx, *costmap_)) {
+  for (unsigned int nbr : nhood4(idx, size_x_, size_y_)) {
     if (map_[nbr] == FREE_SPACE) {
       return true;
     }
@@ -262,22 +1149,18 @@ double FrontierSearch::frontierCost(const Frontier& frontier, geometry_msgs::Poi
 
   // noise should be affecting the frontier_human readings 
 
-  // Seed the random number generator (use a different seed for each simulation run)
-  std::random_device rd;
-  std::mt19937 gen(rd());
-
-    // Generate Gaussian noise
+    // Generate Gaussian noise, generator is seeded once per search object
   std::normal_distribution<double> distribution(mean, std_dev);
-  double noise = distribution(gen);
+  double noise = distribution(rng_);
 
     // Add noise to the distance
   frontier_human = frontier_human + noise;
 
 
   return (potential_scale_ * frontier.min_distance *
-          costmap_->getResolution()) -
-         (gain_scale_ * frontier.size * costmap_->getResolution()) +
-         (weight * frontier_human * costmap_ -> getResolution());
+          grid_.getResolution()) -
+         (gain_scale_ * frontier.size * grid_.getResolution()) +
+         (weight * frontier_human * grid_.getResolution());
 }
 
 // if human found, remove from cost
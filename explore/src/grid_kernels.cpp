@@ -0,0 +1,453 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/grid_kernels.h>
+
+#include <algorithm>
+#include <array>
+
+#include <costmap_2d/cost_values.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GRID_KERNELS_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GRID_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace frontier_exploration
+{
+using costmap_2d::FREE_SPACE;
+using costmap_2d::NO_INFORMATION;
+
+namespace
+{
+/* computes candidates in columns [x0, xn) of one map row. Rows above and
+ * below are replaced by the row itself at the map border, this never adds
+ * a free neighbour to unknown cell. */
+typedef void (*CandidateRowFn)(const unsigned char* up,
+                               const unsigned char* row,
+                               const unsigned char* down, unsigned int x0,
+                               unsigned int xn, unsigned int size_x,
+                               std::uint8_t* out);
+
+inline std::uint8_t candidateCell(const unsigned char* up,
+                                  const unsigned char* row,
+                                  const unsigned char* down, unsigned int x,
+                                  unsigned int size_x)
+{
+  if (row[x] != NO_INFORMATION) {
+    return 0;
+  }
+  return up[x] == FREE_SPACE || down[x] == FREE_SPACE ||
+         (x > 0 && row[x - 1] == FREE_SPACE) ||
+         (x + 1 < size_x && row[x + 1] == FREE_SPACE);
+}
+
+void candidateRowScalar(const unsigned char* up, const unsigned char* row,
+                        const unsigned char* down, unsigned int x0,
+                        unsigned int xn, unsigned int size_x,
+                        std::uint8_t* out)
+{
+  for (unsigned int x = x0; x < xn; ++x) {
+    out[x] = candidateCell(up, row, down, x, size_x);
+  }
+}
+
+/* vectorized kernels process columns which have both left and right
+ * neighbour, border columns and the rest are handled by the scalar code */
+#ifdef GRID_KERNELS_X86
+__attribute__((target("sse2"))) void
+candidateRowSse2(const unsigned char* up, const unsigned char* row,
+                 const unsigned char* down, unsigned int x0, unsigned int xn,
+                 unsigned int size_x, std::uint8_t* out)
+{
+  unsigned int x = x0;
+  const unsigned int vec_begin = std::max(x0, 1u);
+  const unsigned int vec_end = std::min(xn, size_x - 1);
+  for (; x < vec_begin && x < xn; ++x) {
+    out[x] = candidateCell(up, row, down, x, size_x);
+  }
+
+  const __m128i unknown = _mm_set1_epi8(static_cast<char>(NO_INFORMATION));
+  const __m128i free = _mm_set1_epi8(static_cast<char>(FREE_SPACE));
+  const __m128i one = _mm_set1_epi8(1);
+  for (; x + 16 <= vec_end; x += 16) {
+    __m128i cell = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+    __m128i left =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 1));
+    __m128i right =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 1));
+    __m128i above = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+    __m128i below =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x));
+    __m128i any_free =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(left, free),
+                                  _mm_cmpeq_epi8(right, free)),
+                     _mm_or_si128(_mm_cmpeq_epi8(above, free),
+                                  _mm_cmpeq_epi8(below, free)));
+    __m128i candidate = _mm_and_si128(_mm_cmpeq_epi8(cell, unknown), any_free);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                     _mm_and_si128(candidate, one));
+  }
+
+  for (; x < xn; ++x) {
+    out[x] = candidateCell(up, row, down, x, size_x);
+  }
+}
+
+__attribute__((target("avx2"))) void
+candidateRowAvx2(const unsigned char* up, const unsigned char* row,
+                 const unsigned char* down, unsigned int x0, unsigned int xn,
+                 unsigned int size_x, std::uint8_t* out)
+{
+  unsigned int x = x0;
+  const unsigned int vec_begin = std::max(x0, 1u);
+  const unsigned int vec_end = std::min(xn, size_x - 1);
+  for (; x < vec_begin && x < xn; ++x) {
+    out[x] = candidateCell(up, row, down, x, size_x);
+  }
+
+  const __m256i unknown = _mm256_set1_epi8(static_cast<char>(NO_INFORMATION));
+  const __m256i free = _mm256_set1_epi8(static_cast<char>(FREE_SPACE));
+  const __m256i one = _mm256_set1_epi8(1);
+  for (; x + 32 <= vec_end; x += 32) {
+    __m256i cell =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+    __m256i left =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 1));
+    __m256i right =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 1));
+    __m256i above =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + x));
+    __m256i below =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + x));
+    __m256i any_free =
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(left, free),
+                                        _mm256_cmpeq_epi8(right, free)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(above, free),
+                                        _mm256_cmpeq_epi8(below, free)));
+    __m256i candidate =
+        _mm256_and_si256(_mm256_cmpeq_epi8(cell, unknown), any_free);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x),
+                        _mm256_and_si256(candidate, one));
+  }
+
+  candidateRowSse2(up, row, down, x, xn, size_x, out);
+}
+#endif
+
+#ifdef GRID_KERNELS_NEON
+void candidateRowNeon(const unsigned char* up, const unsigned char* row,
+                      const unsigned char* down, unsigned int x0,
+                      unsigned int xn, unsigned int size_x, std::uint8_t* out)
+{
+  unsigned int x = x0;
+  const unsigned int vec_begin = std::max(x0, 1u);
+  const unsigned int vec_end = std::min(xn, size_x - 1);
+  for (; x < vec_begin && x < xn; ++x) {
+    out[x] = candidateCell(up, row, down, x, size_x);
+  }
+
+  const uint8x16_t unknown = vdupq_n_u8(NO_INFORMATION);
+  const uint8x16_t free = vdupq_n_u8(FREE_SPACE);
+  const uint8x16_t one = vdupq_n_u8(1);
+  for (; x + 16 <= vec_end; x += 16) {
+    uint8x16_t any_free =
+        vorrq_u8(vorrq_u8(vceqq_u8(vld1q_u8(row + x - 1), free),
+                          vceqq_u8(vld1q_u8(row + x + 1), free)),
+                 vorrq_u8(vceqq_u8(vld1q_u8(up + x), free),
+                          vceqq_u8(vld1q_u8(down + x), free)));
+    uint8x16_t candidate =
+        vandq_u8(vceqq_u8(vld1q_u8(row + x), unknown), any_free);
+    vst1q_u8(out + x, vandq_u8(candidate, one));
+  }
+
+  for (; x < xn; ++x) {
+    out[x] = candidateCell(up, row, down, x, size_x);
+  }
+}
+#endif
+
+/* translates count occupancy values to costs */
+typedef void (*TranslateFn)(const std::int8_t* occupancy, size_t count,
+                            unsigned char* costs);
+
+std::array<unsigned char, 256> initTranslationTable()
+{
+  std::array<unsigned char, 256> cost_translation_table;
+
+  // lineary mapped from [0..100] to [0..255]
+  for (size_t i = 0; i < 256; ++i) {
+    cost_translation_table[i] =
+        static_cast<unsigned char>(1 + (251 * (i - 1)) / 97);
+  }
+
+  // special values:
+  cost_translation_table[0] = 0;      // NO obstacle
+  cost_translation_table[99] = 253;   // INSCRIBED obstacle
+  cost_translation_table[100] = 254;  // LETHAL obstacle
+  cost_translation_table[static_cast<unsigned char>(-1)] = 255;  // UNKNOWN
+
+  return cost_translation_table;
+}
+
+// static translation table to speed things up
+const std::array<unsigned char, 256> cost_translation_table =
+    initTranslationTable();
+
+void translateScalar(const std::int8_t* occupancy, size_t count,
+                     unsigned char* costs)
+{
+  for (size_t i = 0; i < count; ++i) {
+    costs[i] = cost_translation_table[static_cast<unsigned char>(occupancy[i])];
+  }
+}
+
+/* vectorized kernels compute the linear mapping of [1..98] as
+ * 1 + ((v - 1) * 251 * 21621) >> 21, which is exact for these values, and
+ * select special values afterwards. Blocks containing values outside of
+ * [0..100] and -1 go through the table. */
+#ifdef GRID_KERNELS_X86
+__attribute__((target("sse2"))) void
+translateSse2(const std::int8_t* occupancy, size_t count, unsigned char* costs)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max_valid = _mm_set1_epi8(100);
+  const __m128i unknown = _mm_set1_epi8(-1);
+  const __m128i one16 = _mm_set1_epi16(1);
+  const __m128i scale16 = _mm_set1_epi16(251);
+  const __m128i magic16 = _mm_set1_epi16(21621);
+  const __m128i inscribed = _mm_set1_epi8(99);
+  const __m128i inscribed_cost = _mm_set1_epi8(static_cast<char>(253));
+  const __m128i lethal = _mm_set1_epi8(100);
+  const __m128i lethal_cost = _mm_set1_epi8(static_cast<char>(254));
+
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(occupancy + i));
+    __m128i valid = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, max_valid), v),
+                                 _mm_cmpeq_epi8(v, unknown));
+    if (_mm_movemask_epi8(valid) != 0xFFFF) {
+      translateScalar(occupancy + i, 16, costs + i);
+      continue;
+    }
+
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    lo = _mm_mullo_epi16(_mm_sub_epi16(lo, one16), scale16);
+    hi = _mm_mullo_epi16(_mm_sub_epi16(hi, one16), scale16);
+    lo = _mm_add_epi16(_mm_srli_epi16(_mm_mulhi_epu16(lo, magic16), 5), one16);
+    hi = _mm_add_epi16(_mm_srli_epi16(_mm_mulhi_epu16(hi, magic16), 5), one16);
+    __m128i result = _mm_packus_epi16(lo, hi);
+
+    // special values, unknown is -1 in occupancy and 255 in costs
+    __m128i mask = _mm_cmpeq_epi8(v, zero);
+    result = _mm_andnot_si128(mask, result);
+    mask = _mm_cmpeq_epi8(v, inscribed);
+    result = _mm_or_si128(_mm_andnot_si128(mask, result),
+                          _mm_and_si128(mask, inscribed_cost));
+    mask = _mm_cmpeq_epi8(v, lethal);
+    result = _mm_or_si128(_mm_andnot_si128(mask, result),
+                          _mm_and_si128(mask, lethal_cost));
+    result = _mm_or_si128(result, _mm_cmpeq_epi8(v, unknown));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(costs + i), result);
+  }
+
+  translateScalar(occupancy + i, count - i, costs + i);
+}
+
+__attribute__((target("avx2"))) void
+translateAvx2(const std::int8_t* occupancy, size_t count, unsigned char* costs)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i max_valid = _mm256_set1_epi8(100);
+  const __m256i unknown = _mm256_set1_epi8(-1);
+  const __m256i one16 = _mm256_set1_epi16(1);
+  const __m256i scale16 = _mm256_set1_epi16(251);
+  const __m256i magic16 = _mm256_set1_epi16(21621);
+  const __m256i inscribed = _mm256_set1_epi8(99);
+  const __m256i inscribed_cost = _mm256_set1_epi8(static_cast<char>(253));
+  const __m256i lethal = _mm256_set1_epi8(100);
+  const __m256i lethal_cost = _mm256_set1_epi8(static_cast<char>(254));
+
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(occupancy + i));
+    __m256i valid =
+        _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, max_valid), v),
+                        _mm256_cmpeq_epi8(v, unknown));
+    if (_mm256_movemask_epi8(valid) != -1) {
+      translateScalar(occupancy + i, 32, costs + i);
+      continue;
+    }
+
+    // unpacking and packing both work within 128-bit lanes, order is kept
+    __m256i lo = _mm256_unpacklo_epi8(v, zero);
+    __m256i hi = _mm256_unpackhi_epi8(v, zero);
+    lo = _mm256_mullo_epi16(_mm256_sub_epi16(lo, one16), scale16);
+    hi = _mm256_mullo_epi16(_mm256_sub_epi16(hi, one16), scale16);
+    lo = _mm256_add_epi16(
+        _mm256_srli_epi16(_mm256_mulhi_epu16(lo, magic16), 5), one16);
+    hi = _mm256_add_epi16(
+        _mm256_srli_epi16(_mm256_mulhi_epu16(hi, magic16), 5), one16);
+    __m256i result = _mm256_packus_epi16(lo, hi);
+
+    // special values, unknown is -1 in occupancy and 255 in costs
+    result = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, zero), result);
+    result = _mm256_blendv_epi8(result, inscribed_cost,
+                                _mm256_cmpeq_epi8(v, inscribed));
+    result = _mm256_blendv_epi8(result, lethal_cost,
+                                _mm256_cmpeq_epi8(v, lethal));
+    result = _mm256_or_si256(result, _mm256_cmpeq_epi8(v, unknown));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(costs + i), result);
+  }
+
+  translateSse2(occupancy + i, count - i, costs + i);
+}
+#endif
+
+#ifdef GRID_KERNELS_NEON
+void translateNeon(const std::int8_t* occupancy, size_t count,
+                   unsigned char* costs)
+{
+  const uint8x16_t max_valid = vdupq_n_u8(100);
+  const uint8x16_t unknown = vdupq_n_u8(255);
+  const uint16x8_t one16 = vdupq_n_u16(1);
+  const uint16x8_t scale16 = vdupq_n_u16(251);
+  const uint16x4_t magic16 = vdup_n_u16(21621);
+
+  // (t * magic) >> 21, for 8 lanes of 16-bit t
+  auto divide = [magic16](uint16x8_t t) {
+    uint32x4_t lo = vmull_u16(vget_low_u16(t), magic16);
+    uint32x4_t hi = vmull_u16(vget_high_u16(t), magic16);
+    return vcombine_u16(vshrn_n_u32(vshrq_n_u32(lo, 5), 16),
+                        vshrn_n_u32(vshrq_n_u32(hi, 5), 16));
+  };
+
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(occupancy + i));
+    uint8x16_t valid = vorrq_u8(vcleq_u8(v, max_valid), vceqq_u8(v, unknown));
+    if (vminvq_u8(valid) != 0xFF) {
+      translateScalar(occupancy + i, 16, costs + i);
+      continue;
+    }
+
+    uint16x8_t lo = vmulq_u16(vsubq_u16(vmovl_u8(vget_low_u8(v)), one16),
+                              scale16);
+    uint16x8_t hi = vmulq_u16(vsubq_u16(vmovl_u8(vget_high_u8(v)), one16),
+                              scale16);
+    uint8x16_t result = vcombine_u8(vqmovn_u16(vaddq_u16(divide(lo), one16)),
+                                    vqmovn_u16(vaddq_u16(divide(hi), one16)));
+
+    // special values, unknown is -1 in occupancy and 255 in costs
+    result = vbicq_u8(result, vceqq_u8(v, vdupq_n_u8(0)));
+    result = vbslq_u8(vceqq_u8(v, vdupq_n_u8(99)), vdupq_n_u8(253), result);
+    result = vbslq_u8(vceqq_u8(v, vdupq_n_u8(100)), vdupq_n_u8(254), result);
+    result = vorrq_u8(result, vceqq_u8(v, unknown));
+    vst1q_u8(costs + i, result);
+  }
+
+  translateScalar(occupancy + i, count - i, costs + i);
+}
+#endif
+
+struct GridKernels {
+  CandidateRowFn candidate_row;
+  TranslateFn translate;
+  const char* isa;
+};
+
+GridKernels selectKernels()
+{
+#ifdef GRID_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {candidateRowAvx2, translateAvx2, "avx2"};
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return {candidateRowSse2, translateSse2, "sse2"};
+  }
+#endif
+#ifdef GRID_KERNELS_NEON
+  return {candidateRowNeon, translateNeon, "neon"};
+#endif
+  return {candidateRowScalar, translateScalar, "scalar"};
+}
+
+const GridKernels& kernels()
+{
+  static const GridKernels selected = selectKernels();
+  return selected;
+}
+}  // namespace
+
+void markFrontierCandidates(const unsigned char* map, unsigned int size_x,
+                            unsigned int size_y, unsigned int x0,
+                            unsigned int y0, unsigned int xn, unsigned int yn,
+                            std::uint8_t* mask)
+{
+  xn = std::min(xn, size_x);
+  yn = std::min(yn, size_y);
+  if (x0 >= xn) {
+    return;
+  }
+
+  CandidateRowFn candidate_row = kernels().candidate_row;
+  for (unsigned int y = y0; y < yn; ++y) {
+    const unsigned char* row = map + static_cast<size_t>(y) * size_x;
+    const unsigned char* up = y > 0 ? row - size_x : row;
+    const unsigned char* down = y + 1 < size_y ? row + size_x : row;
+    candidate_row(up, row, down, x0, xn, size_x,
+                  mask + static_cast<size_t>(y) * size_x);
+  }
+}
+
+void translateCosts(const std::int8_t* occupancy, size_t count,
+                    unsigned char* costs)
+{
+  kernels().translate(occupancy, count, costs);
+}
+
+const char* gridKernelsIsa()
+{
+  return kernels().isa;
+}
+}
@@ -0,0 +1,240 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <benchmark/benchmark.h>
+#include <explore/costmap_tools.h>
+#include <explore/grid_kernels.h>
+
+#include <array>
+#include <random>
+#include <vector>
+
+#include <costmap_2d/cost_values.h>
+
+/* compares allocating neighbourhood functions with the fixed-capacity ones.
+ * Every benchmark visits neighbourhood of every cell in the map. */
+
+static void BM_nhood4Vector(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  costmap_2d::Costmap2D costmap(size, size, 0.05, 0., 0.);
+  for (auto _ : state) {
+    unsigned int sum = 0;
+    for (unsigned int idx = 0; idx < size * size; ++idx) {
+      for (unsigned int nbr : frontier_exploration::nhood4(idx, costmap)) {
+        sum += nbr;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_nhood4Vector)->Arg(256)->Arg(1024);
+
+static void BM_nhood4Fixed(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  for (auto _ : state) {
+    unsigned int sum = 0;
+    for (unsigned int idx = 0; idx < size * size; ++idx) {
+      for (unsigned int nbr : frontier_exploration::nhood4(idx, size, size)) {
+        sum += nbr;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_nhood4Fixed)->Arg(256)->Arg(1024);
+
+static void BM_nhood8Vector(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  costmap_2d::Costmap2D costmap(size, size, 0.05, 0., 0.);
+  for (auto _ : state) {
+    unsigned int sum = 0;
+    for (unsigned int idx = 0; idx < size * size; ++idx) {
+      for (unsigned int nbr : frontier_exploration::nhood8(idx, costmap)) {
+        sum += nbr;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_nhood8Vector)->Arg(256)->Arg(1024);
+
+static void BM_nhood8Fixed(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  for (auto _ : state) {
+    unsigned int sum = 0;
+    for (unsigned int idx = 0; idx < size * size; ++idx) {
+      for (unsigned int nbr : frontier_exploration::nhood8(idx, size, size)) {
+        sum += nbr;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_nhood8Fixed)->Arg(256)->Arg(1024);
+
+/* nearest cell search on a map, where requested value is in the corner */
+static void BM_nearestCell(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  costmap_2d::Costmap2D costmap(size, size, 0.05, 0., 0.,
+                                costmap_2d::NO_INFORMATION);
+  costmap.setCost(0, 0, costmap_2d::FREE_SPACE);
+  for (auto _ : state) {
+    unsigned int result = 0;
+    frontier_exploration::nearestCell(result, size * size - 1,
+                                      costmap_2d::FREE_SPACE, costmap);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_nearestCell)->Arg(256)->Arg(1024);
+
+/* map with random free, unknown and occupied cells */
+static std::vector<unsigned char> randomMap(unsigned int size)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  const unsigned char costs[] = {costmap_2d::FREE_SPACE,
+                                 costmap_2d::LETHAL_OBSTACLE,
+                                 costmap_2d::NO_INFORMATION};
+  std::uniform_int_distribution<int> cost_dis(0, 2);
+  std::vector<unsigned char> map(size * size);
+  for (auto& cell : map) {
+    cell = costs[cost_dis(g)];
+  }
+  return map;
+}
+
+/* frontier candidate test done cell by cell, as in FrontierSearch */
+static void BM_frontierCandidatesScalar(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  std::vector<unsigned char> map = randomMap(size);
+  std::vector<std::uint8_t> mask(size * size);
+  for (auto _ : state) {
+    for (unsigned int idx = 0; idx < size * size; ++idx) {
+      bool candidate = false;
+      if (map[idx] == costmap_2d::NO_INFORMATION) {
+        for (unsigned int nbr : frontier_exploration::nhood4(idx, size, size)) {
+          if (map[nbr] == costmap_2d::FREE_SPACE) {
+            candidate = true;
+            break;
+          }
+        }
+      }
+      mask[idx] = candidate;
+    }
+    benchmark::DoNotOptimize(mask.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_frontierCandidatesScalar)->Arg(256)->Arg(1024)->Arg(4096);
+
+static void BM_frontierCandidatesKernel(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  std::vector<unsigned char> map = randomMap(size);
+  std::vector<std::uint8_t> mask(size * size);
+  state.SetLabel(frontier_exploration::gridKernelsIsa());
+  for (auto _ : state) {
+    frontier_exploration::markFrontierCandidates(map.data(), size, size,
+                                                 mask.data());
+    benchmark::DoNotOptimize(mask.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_frontierCandidatesKernel)->Arg(256)->Arg(1024)->Arg(4096);
+
+/* translation of SLAM-like occupancy grid through lookup table, as done by
+ * Costmap2DClient before */
+static std::vector<std::int8_t> randomOccupancy(unsigned int size)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  const std::int8_t values[] = {-1, 0, 100};
+  std::uniform_int_distribution<int> value_dis(0, 2);
+  std::vector<std::int8_t> occupancy(size * size);
+  for (auto& value : occupancy) {
+    value = values[value_dis(g)];
+  }
+  return occupancy;
+}
+
+static void BM_translateCostsTable(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  std::vector<std::int8_t> occupancy = randomOccupancy(size);
+  std::vector<unsigned char> costs(size * size);
+  std::array<unsigned char, 256> table;
+  for (size_t i = 0; i < 256; ++i) {
+    table[i] = static_cast<unsigned char>(1 + (251 * (i - 1)) / 97);
+  }
+  table[0] = 0;
+  table[99] = 253;
+  table[100] = 254;
+  table[255] = 255;
+  for (auto _ : state) {
+    for (size_t i = 0; i < occupancy.size(); ++i) {
+      costs[i] = table[static_cast<unsigned char>(occupancy[i])];
+    }
+    benchmark::DoNotOptimize(costs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_translateCostsTable)->Arg(1024)->Arg(4096);
+
+static void BM_translateCostsKernel(benchmark::State& state)
+{
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  std::vector<std::int8_t> occupancy = randomOccupancy(size);
+  std::vector<unsigned char> costs(size * size);
+  state.SetLabel(frontier_exploration::gridKernelsIsa());
+  for (auto _ : state) {
+    frontier_exploration::translateCosts(occupancy.data(), occupancy.size(),
+                                         costs.data());
+    benchmark::DoNotOptimize(costs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_translateCostsKernel)->Arg(1024)->Arg(4096);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,290 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <benchmark/benchmark.h>
+#include <explore/costmap_tools.h>
+#include <explore/frontier_search.h>
+#include <explore/grid_kernels.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <costmap_2d/cost_values.h>
+#include <explore_common/allocation_counter.h>
+
+/* end-to-end benchmarks of frontier search hot paths. Maps are synthetic maps
+ * of scaled size and recorded maps used by map_merge tests (PGMs in the current
+ * directory). All benchmarks report cells per second and allocations per
+ * call. */
+
+using frontier_exploration::FrontierSearch;
+using frontier_exploration::SearchMode;
+
+const std::array<const char*, 4> recorded_maps = {
+    "map00.pgm",
+    "map05.pgm",
+    "2011-08-09-12-22-52.pgm",
+    "2012-01-28-11-12-01.pgm",
+};
+
+const std::array<const char*, 4> mode_names = {"bfs", "incremental",
+                                               "parallel", "hierarchical"};
+
+/* explored square in the middle of unknown space, with random obstacles */
+static void syntheticMap(unsigned int size, costmap_2d::Costmap2D& costmap)
+{
+  costmap.resizeMap(size, size, 0.05, 0., 0.);
+  std::mt19937 g(156468754 /*magic*/);
+  std::uniform_int_distribution<int> obstacle_dis(0, 9);
+  for (unsigned int y = 0; y < size; ++y) {
+    for (unsigned int x = 0; x < size; ++x) {
+      bool inside =
+          x > size / 4 && x < 3 * size / 4 && y > size / 4 && y < 3 * size / 4;
+      unsigned char cost =
+          inside ? costmap_2d::FREE_SPACE : costmap_2d::NO_INFORMATION;
+      if (inside && obstacle_dis(g) == 0) {
+        cost = costmap_2d::LETHAL_OBSTACLE;
+      }
+      costmap.setCost(x, y, cost);
+    }
+  }
+}
+
+/* loads binary PGM saved by map_server: white is free, black is occupied and
+ * the rest is unknown */
+static bool loadPgm(const std::string& filename, costmap_2d::Costmap2D& costmap)
+{
+  std::ifstream file(filename, std::ios::binary);
+  std::string magic;
+  file >> magic;
+  unsigned int header[3];
+  for (unsigned int& value : header) {
+    // skip comments
+    while (file >> std::ws && file.peek() == '#') {
+      file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    file >> value;
+  }
+  file.get();
+  if (!file || magic != "P5" || header[2] > 255) {
+    return false;
+  }
+
+  const unsigned int size_x = header[0], size_y = header[1];
+  std::vector<char> pixels(size_t(size_x) * size_y);
+  file.read(pixels.data(), static_cast<std::streamsize>(pixels.size()));
+  if (!file) {
+    return false;
+  }
+  costmap.resizeMap(size_x, size_y, 0.05, 0., 0.);
+  unsigned char* map = costmap.getCharMap();
+  // rows are stored from the top
+  for (unsigned int y = 0; y < size_y; ++y) {
+    for (unsigned int x = 0; x < size_x; ++x) {
+      auto pixel = static_cast<unsigned char>(pixels[y * size_x + x]);
+      unsigned char cost = costmap_2d::NO_INFORMATION;
+      if (pixel > 250) {
+        cost = costmap_2d::FREE_SPACE;
+      } else if (pixel < 50) {
+        cost = costmap_2d::LETHAL_OBSTACLE;
+      }
+      map[costmap.getIndex(x, size_y - y - 1)] = cost;
+    }
+  }
+  return true;
+}
+
+/* free cell nearest to the centre, where robot would be */
+static geometry_msgs::Point robotPosition(const costmap_2d::Costmap2D& costmap)
+{
+  unsigned int centre = costmap.getIndex(costmap.getSizeInCellsX() / 2,
+                                         costmap.getSizeInCellsY() / 2);
+  unsigned int start = centre;
+  frontier_exploration::nearestCell(start, centre, costmap_2d::FREE_SPACE,
+                                    costmap);
+  unsigned int mx, my;
+  costmap.indexToCells(start, mx, my);
+  geometry_msgs::Point position;
+  costmap.mapToWorld(mx, my, position.x, position.y);
+  return position;
+}
+
+static void searchFrom(benchmark::State& state, costmap_2d::Costmap2D& costmap)
+{
+  auto mode = static_cast<SearchMode>(state.range(1));
+  state.SetLabel(mode_names[state.range(1)]);
+  FrontierSearch search(&costmap, 1., 1., 0., mode);
+  geometry_msgs::Point position = robotPosition(costmap);
+  // incremental search gets a small update in each search
+  const unsigned int size_x = costmap.getSizeInCellsX();
+  const unsigned int size_y = costmap.getSizeInCellsY();
+  explore::MapRegion update = {size_x / 2 - std::min(size_x / 2, 32u),
+                               size_y / 2 - std::min(size_y / 2, 32u),
+                               std::min(size_x, size_x / 2 + 32),
+                               std::min(size_y, size_y / 2 + 32)};
+  std::vector<explore::MapRegion> updates = {update};
+  search.searchFrom(position);
+
+  explore_common::AllocationCounter allocations;
+  for (auto _ : state) {
+    if (mode == SearchMode::INCREMENTAL) {
+      search.markUpdated(updates);
+    }
+    auto frontiers = search.searchFrom(position);
+    benchmark::DoNotOptimize(frontiers.data());
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations() * size_x * size_y);
+}
+
+static void BM_searchFromSynthetic(benchmark::State& state)
+{
+  costmap_2d::Costmap2D costmap;
+  syntheticMap(static_cast<unsigned int>(state.range(0)), costmap);
+  searchFrom(state, costmap);
+}
+BENCHMARK(BM_searchFromSynthetic)
+    ->Apply([](benchmark::internal::Benchmark* b) {
+      for (int size : {256, 1024, 4096}) {
+        for (int mode = 0; mode < 4; ++mode) {
+          b->Args({size, mode});
+        }
+      }
+    })
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_searchFromRecorded(benchmark::State& state)
+{
+  costmap_2d::Costmap2D costmap;
+  if (!loadPgm(recorded_maps[state.range(0)], costmap)) {
+    state.SkipWithError("could not load map");
+    return;
+  }
+  searchFrom(state, costmap);
+}
+BENCHMARK(BM_searchFromRecorded)
+    ->Apply([](benchmark::internal::Benchmark* b) {
+      for (int map = 0; map < 4; ++map) {
+        for (int mode = 0; mode < 4; ++mode) {
+          b->Args({map, mode});
+        }
+      }
+    })
+    ->Unit(benchmark::kMillisecond);
+
+/* nearest free cell from the corner of the map, through unknown space. Search
+ * storage is reused as in FrontierSearch. */
+static void nearestCell(benchmark::State& state,
+                        const costmap_2d::Costmap2D& costmap)
+{
+  frontier_exploration::CellFlags visited_flag;
+  frontier_exploration::CellQueue bfs;
+  const unsigned int cells =
+      costmap.getSizeInCellsX() * costmap.getSizeInCellsY();
+  explore_common::AllocationCounter allocations;
+  for (auto _ : state) {
+    unsigned int result = 0;
+    frontier_exploration::nearestCell(result, 0, costmap_2d::FREE_SPACE,
+                                      costmap, visited_flag, bfs);
+    benchmark::DoNotOptimize(result);
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations() * cells);
+}
+
+static void BM_nearestCellSynthetic(benchmark::State& state)
+{
+  costmap_2d::Costmap2D costmap;
+  syntheticMap(static_cast<unsigned int>(state.range(0)), costmap);
+  nearestCell(state, costmap);
+}
+BENCHMARK(BM_nearestCellSynthetic)->Arg(256)->Arg(1024)->Arg(4096);
+
+static void BM_nearestCellRecorded(benchmark::State& state)
+{
+  costmap_2d::Costmap2D costmap;
+  if (!loadPgm(recorded_maps[state.range(0)], costmap)) {
+    state.SkipWithError("could not load map");
+    return;
+  }
+  nearestCell(state, costmap);
+}
+BENCHMARK(BM_nearestCellRecorded)->DenseRange(0, 3);
+
+/* translation of partial map updates to costs, row by row as done by
+ * Costmap2DClient::updatePartialMap(). Arguments are map size and size of the
+ * updated square. */
+static void BM_costmapUpdate(benchmark::State& state)
+{
+  const unsigned int size = static_cast<unsigned int>(state.range(0));
+  const unsigned int update_size = static_cast<unsigned int>(state.range(1));
+  costmap_2d::Costmap2D costmap(size, size, 0.05, 0., 0.);
+  std::mt19937 g(156468754 /*magic*/);
+  const std::int8_t values[] = {-1, 0, 100};
+  std::uniform_int_distribution<int> value_dis(0, 2);
+  std::vector<std::int8_t> update(size_t(update_size) * update_size);
+  for (auto& value : update) {
+    value = values[value_dis(g)];
+  }
+  state.SetLabel(frontier_exploration::gridKernelsIsa());
+
+  const unsigned int x0 = (size - update_size) / 2;
+  const unsigned int y0 = x0;
+  unsigned char* costmap_data = costmap.getCharMap();
+  explore_common::AllocationCounter allocations;
+  for (auto _ : state) {
+    for (unsigned int y = 0; y < update_size; ++y) {
+      frontier_exploration::translateCosts(
+          &update[size_t(y) * update_size], update_size,
+          costmap_data + costmap.getIndex(x0, y0 + y));
+    }
+    benchmark::DoNotOptimize(costmap_data);
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(state.iterations() * update.size());
+}
+BENCHMARK(BM_costmapUpdate)
+    ->Args({1024, 64})
+    ->Args({1024, 1024})
+    ->Args({4096, 256})
+    ->Args({4096, 4096});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,225 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/frontier_assignment.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using explore::assignFrontiers;
+using explore::GoalAction;
+using frontier_exploration::Frontier;
+using frontier_exploration::FrontierArena;
+using frontier_exploration::GridView;
+
+// cost of the best assignment found by trying all permutations of frontiers
+static double bruteForceCost(const std::vector<double>& costs, size_t robots,
+                             size_t frontiers)
+{
+  std::vector<size_t> order(std::max(robots, frontiers));
+  std::iota(order.begin(), order.end(), 0);
+  double best = std::numeric_limits<double>::infinity();
+  do {
+    // robot r explores frontier order[r], indexes out of range are unassigned
+    double total = 0.;
+    for (size_t r = 0; r < robots; ++r) {
+      if (order[r] < frontiers) {
+        total += costs[r * frontiers + order[r]];
+      }
+    }
+    best = std::min(best, total);
+  } while (std::next_permutation(order.begin(), order.end()));
+  return best;
+}
+
+static double assignmentCost(const std::vector<double>& costs,
+                             const std::vector<int>& assignment,
+                             size_t frontiers)
+{
+  double total = 0.;
+  for (size_t r = 0; r < assignment.size(); ++r) {
+    if (assignment[r] >= 0) {
+      total += costs[r * frontiers + size_t(assignment[r])];
+    }
+  }
+  return total;
+}
+
+TEST(FrontierAssignment, trivialCases)
+{
+  EXPECT_TRUE(assignFrontiers({}, 0, 3).empty());
+  EXPECT_EQ(assignFrontiers({}, 2, 0), std::vector<int>({-1, -1}));
+  // both robots prefer frontier 0, second robot loses less by taking 1
+  EXPECT_EQ(assignFrontiers({1., 2., 1., 5.}, 2, 2), std::vector<int>({1, 0}));
+}
+
+TEST(FrontierAssignment, matchesBruteForce)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  std::uniform_real_distribution<double> cost_dis(-10., 10.);
+  std::uniform_int_distribution<size_t> size_dis(1, 6);
+  for (size_t i = 0; i < 200; ++i) {
+    size_t robots = size_dis(g);
+    size_t frontiers = size_dis(g);
+    std::vector<double> costs(robots * frontiers);
+    for (auto& cost : costs) {
+      cost = cost_dis(g);
+    }
+
+    auto assignment = assignFrontiers(costs, robots, frontiers);
+    ASSERT_EQ(assignment.size(), robots);
+    // each frontier at most once, as many robots assigned as possible
+    std::vector<int> assigned;
+    for (int frontier : assignment) {
+      if (frontier >= 0) {
+        ASSERT_LT(size_t(frontier), frontiers);
+        assigned.push_back(frontier);
+      }
+    }
+    std::sort(assigned.begin(), assigned.end());
+    EXPECT_EQ(std::unique(assigned.begin(), assigned.end()), assigned.end());
+    EXPECT_EQ(assigned.size(), std::min(robots, frontiers));
+    EXPECT_NEAR(assignmentCost(costs, assignment, frontiers),
+                bruteForceCost(costs, robots, frontiers), 1e-9);
+  }
+}
+
+// frontier made of the given cells of the arena
+static Frontier makeFrontier(const std::shared_ptr<FrontierArena>& arena,
+                             const std::vector<std::uint32_t>& cells)
+{
+  Frontier frontier;
+  frontier.arena = arena;
+  frontier.first_cell = static_cast<std::uint32_t>(arena->cells.size());
+  frontier.size = static_cast<std::uint32_t>(cells.size());
+  arena->cells.insert(arena->cells.end(), cells.begin(), cells.end());
+  return frontier;
+}
+
+static geometry_msgs::Point point(double x, double y)
+{
+  geometry_msgs::Point result;
+  result.x = x;
+  result.y = y;
+  return result;
+}
+
+TEST(FrontierAssignment, computesCosts)
+{
+  // cell (x, y) has centre at (x + 0.5, y + 0.5) - 1
+  auto arena = std::make_shared<FrontierArena>();
+  arena->grid = GridView(nullptr, 10, 10, 1., -1., -1.);
+  std::vector<Frontier> frontiers = {
+      makeFrontier(arena, {arena->grid.getIndex(1, 1),
+                           arena->grid.getIndex(2, 1)}),
+      makeFrontier(arena, {arena->grid.getIndex(8, 8)}),
+  };
+  std::vector<geometry_msgs::Point> positions = {point(0.5, 0.5),
+                                                 point(7.5, 4.5)};
+
+  std::vector<double> distances;
+  auto costs = explore::frontierCosts(frontiers, positions, 2., 3., distances);
+  ASSERT_EQ(costs.size(), 4u);
+  ASSERT_EQ(distances.size(), 4u);
+  // distances to the closest cell of each frontier
+  EXPECT_DOUBLE_EQ(distances[0], 0.);
+  EXPECT_DOUBLE_EQ(distances[1], std::hypot(7., 7.));
+  EXPECT_DOUBLE_EQ(distances[2], std::hypot(6., 4.));
+  EXPECT_DOUBLE_EQ(distances[3], 3.);
+  for (size_t r = 0; r < positions.size(); ++r) {
+    for (size_t f = 0; f < frontiers.size(); ++f) {
+      EXPECT_DOUBLE_EQ(costs[r * 2 + f],
+                       2. * distances[r * 2 + f] - 3. * frontiers[f].size);
+    }
+  }
+  // each robot explores the frontier next to it
+  EXPECT_EQ(assignFrontiers(costs, 2, 2), std::vector<int>({0, 1}));
+}
+
+TEST(FrontierAssignment, dispatchesGoals)
+{
+  const ros::Duration timeout(30.);
+  const geometry_msgs::Point first = point(1., 2.);
+  const geometry_msgs::Point second = point(3., 4.);
+  explore::GoalProgress progress;
+
+  EXPECT_EQ(explore::dispatchGoal(progress, nullptr, 0., ros::Time(1.),
+                                  timeout),
+            GoalAction::KEEP);
+  EXPECT_EQ(explore::dispatchGoal(progress, &first, 10., ros::Time(1.),
+                                  timeout),
+            GoalAction::SEND);
+  EXPECT_TRUE(progress.has_goal);
+  EXPECT_TRUE(explore::sameGoal(progress.goal, first));
+
+  // the same goal is not sent again, getting closer is progress
+  EXPECT_EQ(explore::dispatchGoal(progress, &first, 5., ros::Time(20.),
+                                  timeout),
+            GoalAction::KEEP);
+  EXPECT_EQ(explore::dispatchGoal(progress, &first, 5., ros::Time(40.),
+                                  timeout),
+            GoalAction::KEEP);
+  EXPECT_EQ(explore::dispatchGoal(progress, &first, 5., ros::Time(51.),
+                                  timeout),
+            GoalAction::BLACKLIST);
+
+  // new goal restarts the timeout
+  EXPECT_EQ(explore::dispatchGoal(progress, &second, 8., ros::Time(52.),
+                                  timeout),
+            GoalAction::SEND);
+  EXPECT_TRUE(explore::sameGoal(progress.goal, second));
+  EXPECT_EQ(explore::dispatchGoal(progress, &second, 8., ros::Time(80.),
+                                  timeout),
+            GoalAction::KEEP);
+
+  // robot without frontier stops
+  EXPECT_EQ(explore::dispatchGoal(progress, nullptr, 0., ros::Time(81.),
+                                  timeout),
+            GoalAction::CANCEL);
+  EXPECT_FALSE(progress.has_goal);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,124 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/frontier_blacklist.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using explore::FrontierBlacklist;
+
+static geometry_msgs::Point point(double x, double y)
+{
+  geometry_msgs::Point p;
+  p.x = x;
+  p.y = y;
+  return p;
+}
+
+TEST(FrontierBlacklist, matchesLinearScan)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  std::uniform_real_distribution<double> dis(-10., 10.);
+  const double resolution = 0.05;
+  const double tolerance = 5 * resolution;
+
+  FrontierBlacklist blacklist;
+  blacklist.setResolution(resolution);
+  std::vector<geometry_msgs::Point> goals;
+  for (size_t i = 0; i < 200; ++i) {
+    goals.push_back(point(dis(g), dis(g)));
+    blacklist.add(goals.back(), ros::Time(1.));
+  }
+
+  for (size_t i = 0; i < 10000; ++i) {
+    auto goal = point(dis(g), dis(g));
+    bool expected = false;
+    for (auto& blacklisted : goals) {
+      expected |= std::fabs(goal.x - blacklisted.x) < tolerance &&
+                  std::fabs(goal.y - blacklisted.y) < tolerance;
+    }
+    ASSERT_EQ(blacklist.contains(goal), expected);
+  }
+
+  // points next to blacklisted goals in neighbouring buckets
+  for (auto& blacklisted : goals) {
+    EXPECT_TRUE(blacklist.contains(
+        point(blacklisted.x + 0.9 * tolerance, blacklisted.y - 0.9 * tolerance)));
+  }
+}
+
+TEST(FrontierBlacklist, rebuildsForResolution)
+{
+  FrontierBlacklist blacklist;
+  // nothing is blacklisted until resolution is known
+  blacklist.add(point(1., 1.), ros::Time(1.));
+  EXPECT_FALSE(blacklist.contains(point(1., 1.)));
+
+  blacklist.setResolution(0.05);
+  EXPECT_TRUE(blacklist.contains(point(1.2, 1.)));
+  EXPECT_FALSE(blacklist.contains(point(1.3, 1.)));
+  blacklist.setResolution(0.1);
+  EXPECT_TRUE(blacklist.contains(point(1.3, 1.)));
+}
+
+TEST(FrontierBlacklist, expiresOldGoals)
+{
+  FrontierBlacklist blacklist(5., ros::Duration(10.), 3);
+  blacklist.setResolution(0.05);
+  for (int i = 0; i < 5; ++i) {
+    blacklist.add(point(i, 0.), ros::Time(i + 1.));
+  }
+  // only 3 newest goals are kept
+  EXPECT_EQ(blacklist.size(), 3u);
+  EXPECT_FALSE(blacklist.contains(point(1., 0.)));
+  EXPECT_TRUE(blacklist.contains(point(2., 0.)));
+
+  blacklist.expire(ros::Time(14.5));
+  EXPECT_EQ(blacklist.size(), 1u);
+  EXPECT_FALSE(blacklist.contains(point(3., 0.)));
+  EXPECT_TRUE(blacklist.contains(point(4., 0.)));
+  blacklist.expire(ros::Time(100.));
+  EXPECT_EQ(blacklist.size(), 0u);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
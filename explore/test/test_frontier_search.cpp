@@ -0,0 +1,543 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/frontier_search.h>
+#include <gtest/gtest.h>
+#include <ros/console.h>
+
+#include <costmap_2d/cost_values.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <utility>
+
+using costmap_2d::FREE_SPACE;
+using costmap_2d::LETHAL_OBSTACLE;
+using costmap_2d::NO_INFORMATION;
+using frontier_exploration::CellFlags;
+using frontier_exploration::Frontier;
+using frontier_exploration::FrontierSearch;
+using frontier_exploration::SearchMode;
+
+constexpr double resolution = 0.05;
+
+// frontier identified by its cells, independent of order
+typedef std::set<std::pair<double, double>> FrontierCells;
+
+static std::set<FrontierCells> frontierSet(const std::vector<Frontier>& list)
+{
+  std::set<FrontierCells> result;
+  for (auto& frontier : list) {
+    FrontierCells cells;
+    for (auto& point : frontier.points()) {
+      cells.emplace(point.x, point.y);
+    }
+    result.insert(cells);
+  }
+  return result;
+}
+
+// unknown map with known free square in the middle and some obstacles
+static void fillTestMap(costmap_2d::Costmap2D& costmap, std::mt19937& g)
+{
+  unsigned int size_x = costmap.getSizeInCellsX();
+  unsigned int size_y = costmap.getSizeInCellsY();
+  std::uniform_int_distribution<int> obstacle_dis(0, 9);
+  for (unsigned int y = 0; y < size_y; ++y) {
+    for (unsigned int x = 0; x < size_x; ++x) {
+      bool inside = x > size_x / 4 && x < 3 * size_x / 4 && y > size_y / 4 &&
+                    y < 3 * size_y / 4;
+      unsigned char cost = inside ? FREE_SPACE : NO_INFORMATION;
+      if (inside && obstacle_dis(g) == 0) {
+        cost = LETHAL_OBSTACLE;
+      }
+      costmap.setCost(x, y, cost);
+    }
+  }
+}
+
+static geometry_msgs::Point mapCentre(const costmap_2d::Costmap2D& costmap)
+{
+  geometry_msgs::Point position;
+  costmap.mapToWorld(costmap.getSizeInCellsX() / 2,
+                     costmap.getSizeInCellsY() / 2, position.x, position.y);
+  return position;
+}
+
+// frontiers touching free space 4-connected to the free cell at position,
+// which are the frontiers found by breadth-first search from there
+static std::vector<Frontier>
+reachableFrontiers(const costmap_2d::Costmap2D& costmap,
+                   const geometry_msgs::Point& position,
+                   const std::vector<Frontier>& frontiers)
+{
+  unsigned int size_x = costmap.getSizeInCellsX();
+  unsigned int size_y = costmap.getSizeInCellsY();
+  const unsigned char* map = costmap.getCharMap();
+  unsigned int mx = 0, my = 0;
+  costmap.worldToMap(position.x, position.y, mx, my);
+  std::vector<bool> reachable(size_t(size_x) * size_y, false);
+  std::vector<unsigned int> stack = {costmap.getIndex(mx, my)};
+  reachable[stack.back()] = true;
+  while (!stack.empty()) {
+    unsigned int idx = stack.back();
+    stack.pop_back();
+    for (unsigned int nbr : frontier_exploration::nhood4(idx, size_x, size_y)) {
+      if (map[nbr] == FREE_SPACE && !reachable[nbr]) {
+        reachable[nbr] = true;
+        stack.push_back(nbr);
+      }
+    }
+  }
+
+  std::vector<Frontier> result;
+  for (auto& frontier : frontiers) {
+    bool touches = std::any_of(
+        frontier.cellsBegin(), frontier.cellsEnd(), [&](std::uint32_t cell) {
+          for (unsigned int nbr :
+               frontier_exploration::nhood4(cell, size_x, size_y)) {
+            if (reachable[nbr]) {
+              return true;
+            }
+          }
+          return false;
+        });
+    if (touches) {
+      result.push_back(frontier);
+    }
+  }
+  return result;
+}
+
+TEST(FrontierSearch, findsFrontiersInUnknownMap)
+{
+  costmap_2d::Costmap2D costmap(100, 100, resolution, 0., 0.,
+                                NO_INFORMATION);
+  for (unsigned int y = 40; y < 60; ++y) {
+    for (unsigned int x = 40; x < 60; ++x) {
+      costmap.setCost(x, y, FREE_SPACE);
+    }
+  }
+
+  for (auto mode : {SearchMode::BFS, SearchMode::INCREMENTAL,
+                    SearchMode::PARALLEL, SearchMode::HIERARCHICAL}) {
+    FrontierSearch search(&costmap, 1., 1., 0., mode);
+    auto frontiers = search.searchFrom(mapCentre(costmap));
+    // the free square is surrounded by a single frontier
+    ASSERT_EQ(frontiers.size(), 1u);
+    EXPECT_NEAR(frontiers[0].centroid.x, 2.5, resolution);
+    EXPECT_NEAR(frontiers[0].centroid.y, 2.5, resolution);
+  }
+}
+
+TEST(FrontierSearch, incrementalMatchesRebuildAndBfs)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  costmap_2d::Costmap2D costmap(200, 150, resolution, -1., -2.);
+  fillTestMap(costmap, g);
+  auto position = mapCentre(costmap);
+
+  unsigned int mx = 0, my = 0;
+  costmap.worldToMap(position.x, position.y, mx, my);
+  costmap.setCost(mx, my, FREE_SPACE);
+
+  FrontierSearch incremental(&costmap, 1., 1., 0., SearchMode::INCREMENTAL);
+  incremental.searchFrom(position);
+
+  std::uniform_int_distribution<unsigned int> x_dis(
+      0, costmap.getSizeInCellsX() - 1);
+  std::uniform_int_distribution<unsigned int> y_dis(
+      0, costmap.getSizeInCellsY() - 1);
+  std::uniform_int_distribution<unsigned int> size_dis(1, 30);
+  std::uniform_int_distribution<int> cost_dis(0, 2);
+  const unsigned char costs[] = {FREE_SPACE, LETHAL_OBSTACLE, NO_INFORMATION};
+  for (size_t i = 0; i < 50; ++i) {
+    // random rectangular update
+    explore::MapRegion region;
+    region.x0 = x_dis(g);
+    region.y0 = y_dis(g);
+    region.xn = std::min(region.x0 + size_dis(g), costmap.getSizeInCellsX());
+    region.yn = std::min(region.y0 + size_dis(g), costmap.getSizeInCellsY());
+    for (unsigned int y = region.y0; y < region.yn; ++y) {
+      for (unsigned int x = region.x0; x < region.xn; ++x) {
+        costmap.setCost(x, y, costs[cost_dis(g)]);
+      }
+    }
+    // keep the position free, breadth-first search starts there
+    costmap.setCost(mx, my, FREE_SPACE);
+    incremental.markUpdated({region, {mx, my, mx + 1, my + 1}});
+
+    auto frontiers = incremental.searchFrom(position);
+    FrontierSearch rebuild(&costmap, 1., 1., 0., SearchMode::INCREMENTAL);
+    EXPECT_EQ(frontierSet(frontiers),
+              frontierSet(rebuild.searchFrom(position)));
+    // incremental search does not check reachability, otherwise it finds
+    // the same frontiers as breadth-first search
+    FrontierSearch bfs(&costmap, 1., 1., 0., SearchMode::BFS);
+    EXPECT_EQ(frontierSet(reachableFrontiers(costmap, position, frontiers)),
+              frontierSet(bfs.searchFrom(position)));
+  }
+}
+
+TEST(FrontierSearch, incrementalHandlesResize)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  costmap_2d::Costmap2D costmap(100, 100, resolution, 0., 0.);
+  fillTestMap(costmap, g);
+  auto position = mapCentre(costmap);
+
+  FrontierSearch incremental(&costmap, 1., 1., 0., SearchMode::INCREMENTAL);
+  incremental.searchFrom(position);
+
+  // resized map, no regions reported
+  costmap.resizeMap(120, 80, resolution, 0., 0.);
+  fillTestMap(costmap, g);
+  FrontierSearch rebuild(&costmap, 1., 1., 0., SearchMode::INCREMENTAL);
+  EXPECT_EQ(frontierSet(incremental.searchFrom(position)),
+            frontierSet(rebuild.searchFrom(position)));
+}
+
+TEST(FrontierSearch, incrementalHandlesMovedMap)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  costmap_2d::Costmap2D costmap(100, 100, resolution, 0., 0.);
+  fillTestMap(costmap, g);
+
+  FrontierSearch incremental(&costmap, 1., 1., 0., SearchMode::INCREMENTAL);
+  incremental.searchFrom(mapCentre(costmap));
+
+  // the same size, but different origin and resolution, no regions reported
+  costmap.resizeMap(100, 100, resolution, 1., -1.);
+  std::fill(costmap.getCharMap(), costmap.getCharMap() + 100 * 100,
+            NO_INFORMATION);
+  for (unsigned int y = 10; y < 30; ++y) {
+    for (unsigned int x = 60; x < 90; ++x) {
+      costmap.setCost(x, y, FREE_SPACE);
+    }
+  }
+  auto position = mapCentre(costmap);
+  FrontierSearch rebuild(&costmap, 1., 1., 0., SearchMode::INCREMENTAL);
+  EXPECT_EQ(frontierSet(incremental.searchFrom(position)),
+            frontierSet(rebuild.searchFrom(position)));
+
+  costmap.resizeMap(100, 100, 2 * resolution, 1., -1.);
+  fillTestMap(costmap, g);
+  position = mapCentre(costmap);
+  FrontierSearch rebuild_resolution(&costmap, 1., 1., 0.,
+                                    SearchMode::INCREMENTAL);
+  EXPECT_EQ(frontierSet(incremental.searchFrom(position)),
+            frontierSet(rebuild_resolution.searchFrom(position)));
+}
+
+TEST(FrontierSearch, parallelMatchesBfs)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  // not aligned to tiles
+  costmap_2d::Costmap2D costmap(300, 270, resolution, 0., 0.);
+  fillTestMap(costmap, g);
+  // unreachable free space with frontier
+  for (unsigned int x = 10; x < 20; ++x) {
+    costmap.setCost(x, 10, FREE_SPACE);
+  }
+  auto position = mapCentre(costmap);
+
+  FrontierSearch bfs(&costmap, 1., 1., 0., SearchMode::BFS);
+  auto expected = bfs.searchFrom(position);
+  for (unsigned int threads : {1, 3}) {
+    FrontierSearch parallel(&costmap, 1., 1., 0., SearchMode::PARALLEL,
+                            threads);
+    EXPECT_EQ(frontierSet(parallel.searchFrom(position)),
+              frontierSet(expected));
+  }
+}
+
+TEST(FrontierSearch, hierarchicalMatchesBfs)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  // mostly free map, so that many blocks are uniformly free
+  costmap_2d::Costmap2D costmap(300, 270, resolution, 0., 0., NO_INFORMATION);
+  std::uniform_int_distribution<int> obstacle_dis(0, 499);
+  for (unsigned int y = 20; y < 250; ++y) {
+    for (unsigned int x = 20; x < 280; ++x) {
+      costmap.setCost(x, y, obstacle_dis(g) == 0 ? LETHAL_OBSTACLE : FREE_SPACE);
+    }
+  }
+  // wall with a gap and unknown holes
+  for (unsigned int y = 20; y < 250; ++y) {
+    if (y < 100 || y > 110) {
+      costmap.setCost(150, y, LETHAL_OBSTACLE);
+    }
+  }
+  for (unsigned int y = 60; y < 75; ++y) {
+    for (unsigned int x = 200; x < 233; ++x) {
+      costmap.setCost(x, y, NO_INFORMATION);
+    }
+  }
+  costmap.setCost(60, 200, NO_INFORMATION);
+  // unreachable free space with frontier
+  for (unsigned int x = 5; x < 15; ++x) {
+    costmap.setCost(x, 5, FREE_SPACE);
+  }
+  auto position = mapCentre(costmap);
+
+  FrontierSearch bfs(&costmap, 1., 1., 0., SearchMode::BFS);
+  auto expected = bfs.searchFrom(position);
+  ASSERT_GT(expected.size(), 2u);
+  for (unsigned int block_size : {1, 7, 16, 64}) {
+    FrontierSearch hierarchical(&costmap, 1., 1., 0., SearchMode::HIERARCHICAL,
+                                2, block_size);
+    EXPECT_EQ(frontierSet(hierarchical.searchFrom(position)),
+              frontierSet(expected));
+  }
+
+  // without random obstacles, large free blocks of coarser levels are crossed
+  for (unsigned int y = 20; y < 250; ++y) {
+    for (unsigned int x = 20; x < 280; ++x) {
+      if (x != 150 && costmap.getCost(x, y) == LETHAL_OBSTACLE) {
+        costmap.setCost(x, y, FREE_SPACE);
+      }
+    }
+  }
+  expected = bfs.searchFrom(position);
+  for (unsigned int block_size : {1, 4, 7}) {
+    FrontierSearch hierarchical(&costmap, 1., 1., 0., SearchMode::HIERARCHICAL,
+                                2, block_size);
+    EXPECT_EQ(frontierSet(hierarchical.searchFrom(position)),
+              frontierSet(expected));
+  }
+}
+
+TEST(FrontierSearch, measuresGeodesicDistance)
+{
+  // walled room split by a wall with a gap at its end, unknown patch is
+  // right behind the wall
+  costmap_2d::Costmap2D costmap(100, 100, resolution, 0., 0.,
+                                LETHAL_OBSTACLE);
+  for (unsigned int y = 10; y < 90; ++y) {
+    for (unsigned int x = 10; x < 90; ++x) {
+      costmap.setCost(x, y, FREE_SPACE);
+    }
+  }
+  for (unsigned int x = 10; x < 80; ++x) {
+    costmap.setCost(x, 50, LETHAL_OBSTACLE);
+  }
+  for (unsigned int y = 51; y < 61; ++y) {
+    for (unsigned int x = 40; x < 61; ++x) {
+      costmap.setCost(x, y, NO_INFORMATION);
+    }
+  }
+  geometry_msgs::Point position;
+  costmap.mapToWorld(50, 49, position.x, position.y);
+
+  FrontierSearch euclidean(&costmap, 1., 1., 0.);
+  FrontierSearch geodesic(&costmap, 1., 1., 0., SearchMode::BFS, 0, 16, true);
+  auto expected = euclidean.searchFrom(position);
+  auto frontiers = geodesic.searchFrom(position);
+  ASSERT_EQ(frontiers.size(), 1u);
+  ASSERT_EQ(frontierSet(frontiers), frontierSet(expected));
+  // closest frontier cells are (40, 51) and (60, 51). The path through the gap
+  // reaches (61, 51) after 30 + 2 + 19 cells.
+  EXPECT_NEAR(expected[0].min_distance, std::hypot(10., 2.) * resolution,
+              1e-6);
+  EXPECT_NEAR(frontiers[0].min_distance, 52 * resolution, 1e-6);
+  EXPECT_NEAR(frontiers[0].middle.x, 60.5 * resolution, 1e-6);
+  EXPECT_NEAR(frontiers[0].middle.y, 51.5 * resolution, 1e-6);
+}
+
+TEST(FrontierSearch, searchesSnapshot)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  costmap_2d::Costmap2D costmap(200, 150, resolution, 0., 0.);
+  fillTestMap(costmap, g);
+  auto position = mapCentre(costmap);
+  costmap_2d::Costmap2D snapshot(costmap);
+
+  FrontierSearch search(&costmap, 1., 1., 0.);
+  auto expected = frontierSet(search.searchFrom(position));
+  // master map changes, snapshot is searched
+  fillTestMap(costmap, g);
+  EXPECT_EQ(frontierSet(search.searchFrom(snapshot, position)), expected);
+  EXPECT_NE(frontierSet(search.searchFrom(position)), expected);
+}
+
+TEST(FrontierSearch, searchesOccupancyGrid)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  // occupancy grid stores resolution as float
+  const float grid_resolution = resolution;
+  costmap_2d::Costmap2D costmap(200, 150, grid_resolution, -1., 2.);
+  fillTestMap(costmap, g);
+  auto position = mapCentre(costmap);
+
+  // the same map as raw occupancy grid
+  nav_msgs::OccupancyGrid grid;
+  grid.info.width = costmap.getSizeInCellsX();
+  grid.info.height = costmap.getSizeInCellsY();
+  grid.info.resolution = grid_resolution;
+  grid.info.origin.position.x = -1.;
+  grid.info.origin.position.y = 2.;
+  const unsigned char* data = costmap.getCharMap();
+  for (unsigned int i = 0; i < grid.info.width * grid.info.height; ++i) {
+    grid.data.push_back(data[i] == NO_INFORMATION ?
+                            -1 :
+                            (data[i] == LETHAL_OBSTACLE ? 100 : 0));
+  }
+
+  for (auto mode : {SearchMode::BFS, SearchMode::INCREMENTAL,
+                    SearchMode::PARALLEL, SearchMode::HIERARCHICAL}) {
+    FrontierSearch search(&costmap, 1., 1., 0., mode);
+    auto expected = frontierSet(search.searchFrom(position));
+    FrontierSearch grid_search(&costmap, 1., 1., 0., mode);
+    EXPECT_EQ(frontierSet(grid_search.searchFrom(
+                  frontier_exploration::GridView::fromOccupancyGrid(grid),
+                  position)),
+              expected);
+  }
+}
+
+TEST(FrontierSearch, selectsBestFrontiers)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  costmap_2d::Costmap2D costmap(200, 150, resolution, 0., 0.);
+  fillTestMap(costmap, g);
+  auto position = mapCentre(costmap);
+  auto small = [](const Frontier& f) { return f.size < 5; };
+
+  FrontierSearch search(&costmap, 1., 1., 0.);
+  auto all = search.searchFrom(position);
+  all.erase(std::remove_if(all.begin(), all.end(), small), all.end());
+  ASSERT_GT(all.size(), 3u);
+
+  auto best = search.searchBest(position, 3, small);
+  ASSERT_EQ(best.size(), 3u);
+  for (size_t i = 0; i < best.size(); ++i) {
+    EXPECT_EQ(best[i].cost, all[i].cost);
+  }
+  EXPECT_EQ(search.searchBest(position, all.size() + 1, small).size(),
+            all.size());
+}
+
+TEST(FrontierSearch, keepsCellsOfReturnedFrontiers)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  costmap_2d::Costmap2D costmap(200, 150, resolution, 0., 0.);
+  fillTestMap(costmap, g);
+  auto position = mapCentre(costmap);
+
+  FrontierSearch search(&costmap, 1., 1., 0.);
+  auto frontiers = search.searchFrom(position);
+  auto expected = frontierSet(frontiers);
+  for (auto& frontier : frontiers) {
+    EXPECT_EQ(frontier.points().size(), frontier.size);
+  }
+  // returned frontiers are not overwritten by following searches
+  fillTestMap(costmap, g);
+  EXPECT_NE(frontierSet(search.searchFrom(position)), expected);
+  EXPECT_EQ(frontierSet(frontiers), expected);
+}
+
+TEST(FrontierSearch, decimatesPoints)
+{
+  costmap_2d::Costmap2D costmap(100, 100, resolution, 0., 0.,
+                                NO_INFORMATION);
+  for (unsigned int y = 40; y < 60; ++y) {
+    for (unsigned int x = 40; x < 60; ++x) {
+      costmap.setCost(x, y, FREE_SPACE);
+    }
+  }
+
+  FrontierSearch search(&costmap, 1., 1., 0.);
+  auto frontiers = search.searchFrom(mapCentre(costmap));
+  ASSERT_EQ(frontiers.size(), 1u);
+  auto all = frontiers[0].points();
+  EXPECT_EQ(frontiers[0].points(all.size()).size(), all.size());
+  auto decimated = frontiers[0].points(10);
+  EXPECT_LE(decimated.size(), 10u);
+  EXPECT_GT(decimated.size(), 5u);
+  for (auto& point : decimated) {
+    EXPECT_TRUE(std::any_of(all.begin(), all.end(),
+                            [&point](const geometry_msgs::Point& p) {
+                              return p.x == point.x && p.y == point.y;
+                            }));
+  }
+}
+
+TEST(CellFlags, clearsWhenGenerationWraps)
+{
+  CellFlags flags;
+  flags.reset(4);
+  for (unsigned int i = 0; i < 70000; ++i) {
+    flags.set(i % 4);
+    flags.reset(4);
+    for (unsigned int idx = 0; idx < 4; ++idx) {
+      ASSERT_FALSE(flags.test(idx));
+    }
+  }
+  EXPECT_EQ(flags.allocations(), 1u);
+}
+
+TEST(FrontierSearch, reusesWorkspace)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  costmap_2d::Costmap2D costmap(200, 150, resolution, 0., 0.);
+  fillTestMap(costmap, g);
+  auto position = mapCentre(costmap);
+
+  for (auto mode : {SearchMode::BFS, SearchMode::INCREMENTAL,
+                    SearchMode::PARALLEL, SearchMode::HIERARCHICAL}) {
+    FrontierSearch search(&costmap, 1., 1., 0., mode, 2);
+    auto expected = frontierSet(search.searchFrom(position));
+    // incremental search needs more space, when it replaces frontiers
+    search.markUpdated({{0, 0, 200, 150}});
+    search.searchFrom(position);
+    size_t allocations = search.workspaceAllocations();
+    EXPECT_GT(allocations, 0);
+    for (size_t i = 0; i < 300; ++i) {
+      // storage is the same for repeated searches
+      search.markUpdated({{0, 0, 200, 150}});
+      EXPECT_EQ(frontierSet(search.searchFrom(position)), expected);
+    }
+    EXPECT_EQ(search.workspaceAllocations(), allocations);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
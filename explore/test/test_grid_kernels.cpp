@@ -0,0 +1,190 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/grid_kernels.h>
+#include <gtest/gtest.h>
+
+#include <costmap_2d/cost_values.h>
+
+#include <random>
+#include <vector>
+
+using costmap_2d::FREE_SPACE;
+using costmap_2d::LETHAL_OBSTACLE;
+using costmap_2d::NO_INFORMATION;
+
+// value never written by kernels
+constexpr std::uint8_t untouched = 7;
+
+// straightforward implementation of frontier candidate test
+static std::uint8_t isCandidate(const std::vector<unsigned char>& map,
+                                unsigned int size_x, unsigned int size_y,
+                                unsigned int x, unsigned int y)
+{
+  if (map[y * size_x + x] != NO_INFORMATION) {
+    return 0;
+  }
+  return (x > 0 && map[y * size_x + x - 1] == FREE_SPACE) ||
+         (x + 1 < size_x && map[y * size_x + x + 1] == FREE_SPACE) ||
+         (y > 0 && map[(y - 1) * size_x + x] == FREE_SPACE) ||
+         (y + 1 < size_y && map[(y + 1) * size_x + x] == FREE_SPACE);
+}
+
+static std::vector<unsigned char> randomMap(unsigned int size_x,
+                                            unsigned int size_y,
+                                            std::mt19937& g)
+{
+  const unsigned char costs[] = {FREE_SPACE, LETHAL_OBSTACLE, NO_INFORMATION,
+                                 NO_INFORMATION, 100};
+  std::uniform_int_distribution<int> cost_dis(0, 4);
+  std::vector<unsigned char> map(size_x * size_y);
+  for (auto& cell : map) {
+    cell = costs[cost_dis(g)];
+  }
+  return map;
+}
+
+TEST(GridKernels, marksWholeMap)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  // sizes around vector widths
+  for (unsigned int size_x : {1, 2, 15, 16, 17, 31, 32, 33, 34, 100, 257}) {
+    for (unsigned int size_y : {1, 2, 3, 40}) {
+      auto map = randomMap(size_x, size_y, g);
+      std::vector<std::uint8_t> mask(size_x * size_y, untouched);
+      frontier_exploration::markFrontierCandidates(map.data(), size_x, size_y,
+                                                   mask.data());
+      for (unsigned int y = 0; y < size_y; ++y) {
+        for (unsigned int x = 0; x < size_x; ++x) {
+          ASSERT_EQ(mask[y * size_x + x], isCandidate(map, size_x, size_y, x, y))
+              << "map " << size_x << "x" << size_y << ", cell " << x << ", "
+              << y << ", " << frontier_exploration::gridKernelsIsa();
+        }
+      }
+    }
+  }
+}
+
+TEST(GridKernels, marksOnlyRegion)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  const unsigned int size_x = 150;
+  const unsigned int size_y = 70;
+  auto map = randomMap(size_x, size_y, g);
+  std::uniform_int_distribution<unsigned int> x_dis(0, size_x);
+  std::uniform_int_distribution<unsigned int> y_dis(0, size_y);
+  for (size_t i = 0; i < 100; ++i) {
+    unsigned int x0 = x_dis(g), xn = x_dis(g);
+    unsigned int y0 = y_dis(g), yn = y_dis(g);
+    std::vector<std::uint8_t> mask(size_x * size_y, untouched);
+    frontier_exploration::markFrontierCandidates(map.data(), size_x, size_y,
+                                                 x0, y0, xn, yn, mask.data());
+    for (unsigned int y = 0; y < size_y; ++y) {
+      for (unsigned int x = 0; x < size_x; ++x) {
+        bool inside = x >= x0 && x < xn && y >= y0 && y < yn;
+        ASSERT_EQ(mask[y * size_x + x],
+                  inside ? isCandidate(map, size_x, size_y, x, y) : untouched);
+      }
+    }
+  }
+}
+
+// cost for occupancy value, as in costmap_2d static layer
+static unsigned char expectedCost(int value)
+{
+  switch (value) {
+    case -1:
+      return NO_INFORMATION;
+    case 0:
+      return FREE_SPACE;
+    case 99:
+      return costmap_2d::INSCRIBED_INFLATED_OBSTACLE;
+    case 100:
+      return LETHAL_OBSTACLE;
+    default:
+      unsigned char v = static_cast<unsigned char>(value);
+      return static_cast<unsigned char>(1 + (251 * (v - 1)) / 97);
+  }
+}
+
+TEST(GridKernels, translatesAllValues)
+{
+  std::vector<std::int8_t> occupancy;
+  for (int value = -128; value < 128; ++value) {
+    occupancy.push_back(static_cast<std::int8_t>(value));
+  }
+  std::vector<unsigned char> costs(occupancy.size());
+  frontier_exploration::translateCosts(occupancy.data(), occupancy.size(),
+                                       costs.data());
+  for (size_t i = 0; i < occupancy.size(); ++i) {
+    EXPECT_EQ(costs[i], expectedCost(occupancy[i])) << int(occupancy[i]);
+  }
+}
+
+TEST(GridKernels, translatesValidBlocks)
+{
+  std::mt19937 g(156468754 /*magic*/);
+  std::uniform_int_distribution<int> value_dis(-1, 100);
+  std::uniform_int_distribution<int> invalid_dis(101, 127);
+  // lengths around vector widths, some with invalid values
+  for (size_t count : {1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000}) {
+    for (bool with_invalid : {false, true}) {
+      std::vector<std::int8_t> occupancy(count);
+      for (auto& value : occupancy) {
+        value = static_cast<std::int8_t>(value_dis(g));
+      }
+      if (with_invalid) {
+        occupancy[count / 2] = static_cast<std::int8_t>(invalid_dis(g));
+      }
+      // not aligned output
+      std::vector<unsigned char> costs(count + 1, untouched);
+      frontier_exploration::translateCosts(occupancy.data(), count,
+                                           costs.data() + 1);
+      ASSERT_EQ(costs[0], untouched);
+      for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(costs[i + 1], expectedCost(occupancy[i]))
+            << "value " << int(occupancy[i]) << ", count " << count << ", "
+            << frontier_exploration::gridKernelsIsa();
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
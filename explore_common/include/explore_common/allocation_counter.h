@@ -0,0 +1,116 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef EXPLORE_COMMON_ALLOCATION_COUNTER_H_
+#define EXPLORE_COMMON_ALLOCATION_COUNTER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include <benchmark/benchmark.h>
+
+/* Counts allocations made through global operator new in benchmarks. This
+ * header defines replacements of global allocation functions, it must be
+ * included by exactly one translation unit of the benchmark. Array and nothrow
+ * versions forward to these by default. */
+
+namespace explore_common
+{
+namespace internal
+{
+inline std::atomic<std::size_t>& allocationCounter()
+{
+  static std::atomic<std::size_t> count(0);
+  return count;
+}
+}  // namespace internal
+
+/**
+ * @brief Number of allocations made through global operator new
+ */
+inline std::size_t allocationCount()
+{
+  return internal::allocationCounter().load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Measures allocations made during benchmark iterations
+ * @details Construct it right before the benchmark loop, report() stores
+ * allocations per iteration to the "allocs" counter.
+ */
+class AllocationCounter
+{
+public:
+  AllocationCounter() : start_(allocationCount())
+  {
+  }
+
+  void report(benchmark::State& state) const
+  {
+    state.counters["allocs"] =
+        benchmark::Counter(static_cast<double>(allocationCount() - start_),
+                           benchmark::Counter::kAvgIterations);
+  }
+
+private:
+  std::size_t start_;
+};
+}  // namespace explore_common
+
+void* operator new(std::size_t size)
+{
+  explore_common::internal::allocationCounter().fetch_add(
+      1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+#endif  // EXPLORE_COMMON_ALLOCATION_COUNTER_H_
@@ -0,0 +1,294 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef EXPLORE_COMMON_GRID_CODEC_H_
+#define EXPLORE_COMMON_GRID_CODEC_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace explore_common
+{
+/**
+ * @brief Compact transport of occupancy grids
+ * @details Cells are reduced to three states: free, occupied and unknown.
+ * Grid is split to tiles of whole rows, every tile is stored either packed to
+ * 2 bits per cell or run-length encoded, whichever is smaller. Tiles are
+ * encoded independently.
+ *
+ * Encoded payload is carried in data of nav_msgs::OccupancyGrid and
+ * map_msgs::OccupancyGridUpdate, other fields of the messages keep their
+ * meaning. Payload layout, integers are little endian:
+ *
+ *   magic "OGC", version 1, uint32 width, uint32 height, uint32 tile rows
+ *   for each tile: uint8 mode, uint32 size, size bytes of tile data
+ *
+ * Packed tile stores cell i in bits 2 * (i % 4) of byte i / 4. Run-length
+ * encoded tile is a sequence of LEB128 varints ((run length - 1) << 2 | state).
+ */
+namespace grid_codec
+{
+/// states of cells, their values are stored in the payload
+enum State : std::uint8_t { FREE = 0, OCCUPIED = 1, UNKNOWN = 2 };
+
+enum TileMode : std::uint8_t { PACKED = 0, RUN_LENGTH = 1 };
+
+constexpr std::size_t header_size = 16;
+constexpr unsigned int default_tile_rows = 64;
+
+namespace internal
+{
+inline void putUint32(std::vector<std::int8_t>& out, std::uint32_t value)
+{
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<std::int8_t>((value >> (8 * i)) & 0xff));
+  }
+}
+
+inline std::uint32_t getUint32(const std::uint8_t* in)
+{
+  return std::uint32_t(in[0]) | std::uint32_t(in[1]) << 8 |
+         std::uint32_t(in[2]) << 16 | std::uint32_t(in[3]) << 24;
+}
+
+inline void putVarint(std::vector<std::int8_t>& out, std::uint64_t value)
+{
+  while (value >= 0x80) {
+    out.push_back(static_cast<std::int8_t>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<std::int8_t>(value));
+}
+}  // namespace internal
+
+/**
+ * @brief State of occupancy grid value
+ * @details Negative values are unknown, values from occupied_threshold up are
+ * occupied.
+ */
+inline State toState(std::int8_t value, int occupied_threshold)
+{
+  if (value < 0) {
+    return UNKNOWN;
+  }
+  return value >= occupied_threshold ? OCCUPIED : FREE;
+}
+
+/**
+ * @brief Encodes rectangular part of occupancy grid
+ *
+ * @param data First cell of the encoded part
+ * @param stride Distance between rows of data
+ * @param width Width of the encoded part
+ * @param height Height of the encoded part
+ * @param payload Encoded payload, previous content is replaced
+ * @param occupied_threshold Values from this threshold up are occupied
+ * @param tile_rows Rows of a tile
+ */
+inline void encode(const std::int8_t* data, std::size_t stride,
+                   unsigned int width, unsigned int height,
+                   std::vector<std::int8_t>& payload,
+                   int occupied_threshold = 65,
+                   unsigned int tile_rows = default_tile_rows)
+{
+  tile_rows = std::max(tile_rows, 1u);
+  payload.clear();
+  payload.push_back('O');
+  payload.push_back('G');
+  payload.push_back('C');
+  payload.push_back(1);
+  internal::putUint32(payload, width);
+  internal::putUint32(payload, height);
+  internal::putUint32(payload, tile_rows);
+
+  std::vector<std::int8_t> packed;
+  std::vector<std::int8_t> runs;
+  for (unsigned int y0 = 0; y0 < height; y0 += tile_rows) {
+    const unsigned int yn = std::min(y0 + tile_rows, height);
+    const std::size_t cells = std::size_t(yn - y0) * width;
+    packed.assign((cells + 3) / 4, 0);
+    runs.clear();
+
+    std::size_t i = 0;
+    std::uint64_t run = 0;
+    State run_state = FREE;
+    for (unsigned int y = y0; y < yn; ++y) {
+      const std::int8_t* row = data + y * stride;
+      for (unsigned int x = 0; x < width; ++x, ++i) {
+        State state = toState(row[x], occupied_threshold);
+        packed[i / 4] = static_cast<std::int8_t>(
+            static_cast<std::uint8_t>(packed[i / 4]) | state << (2 * (i % 4)));
+        if (run > 0 && state == run_state) {
+          ++run;
+          continue;
+        }
+        if (run > 0) {
+          internal::putVarint(runs, (run - 1) << 2 | run_state);
+        }
+        run_state = state;
+        run = 1;
+      }
+    }
+    if (run > 0) {
+      internal::putVarint(runs, (run - 1) << 2 | run_state);
+    }
+
+    const std::vector<std::int8_t>& tile =
+        runs.size() < packed.size() ? runs : packed;
+    payload.push_back(runs.size() < packed.size() ? RUN_LENGTH : PACKED);
+    internal::putUint32(payload, static_cast<std::uint32_t>(tile.size()));
+    payload.insert(payload.end(), tile.begin(), tile.end());
+  }
+}
+
+/**
+ * @brief Decodes payload to rows provided by the caller
+ * @details Decoded cells are written as values[state]. Rows are requested in
+ * increasing order, each row once.
+ *
+ * @param payload Encoded payload
+ * @param width Expected width of the encoded part
+ * @param height Expected height of the encoded part
+ * @param values Values written for free, occupied and unknown cells
+ * @param row Callable returning pointer to row y of the target
+ * @return False if payload is malformed or its size doesn't match, target
+ * may be written partially then
+ */
+template <typename T, typename RowFn>
+bool decode(const std::vector<std::int8_t>& payload, unsigned int width,
+            unsigned int height, const T (&values)[3], RowFn&& row)
+{
+  const std::uint8_t* in =
+      reinterpret_cast<const std::uint8_t*>(payload.data());
+  const std::uint8_t* end = in + payload.size();
+  if (payload.size() < header_size || in[0] != 'O' || in[1] != 'G' ||
+      in[2] != 'C' || in[3] != 1 || internal::getUint32(in + 4) != width ||
+      internal::getUint32(in + 8) != height) {
+    return false;
+  }
+  const std::uint32_t tile_rows = internal::getUint32(in + 12);
+  if (tile_rows == 0) {
+    return false;
+  }
+  in += header_size;
+
+  for (unsigned int y0 = 0; y0 < height; y0 += tile_rows) {
+    if (end - in < 5) {
+      return false;
+    }
+    const std::uint8_t mode = in[0];
+    const std::uint32_t size = internal::getUint32(in + 1);
+    in += 5;
+    if (std::size_t(end - in) < size) {
+      return false;
+    }
+    const std::uint8_t* tile = in;
+    const std::uint8_t* tile_end = in + size;
+    in = tile_end;
+
+    const unsigned int yn = std::min<unsigned int>(y0 + tile_rows, height);
+    const std::size_t cells = std::size_t(yn - y0) * width;
+    if (mode == PACKED) {
+      if (size != (cells + 3) / 4) {
+        return false;
+      }
+      std::size_t i = 0;
+      for (unsigned int y = y0; y < yn; ++y) {
+        T* target = row(y);
+        for (unsigned int x = 0; x < width; ++x, ++i) {
+          unsigned int state = (tile[i / 4] >> (2 * (i % 4))) & 3;
+          if (state > UNKNOWN) {
+            return false;
+          }
+          target[x] = values[state];
+        }
+      }
+      continue;
+    }
+    if (mode != RUN_LENGTH) {
+      return false;
+    }
+
+    // runs may continue across rows
+    std::uint64_t run = 0;
+    T value = values[0];
+    for (unsigned int y = y0; y < yn; ++y) {
+      T* target = row(y);
+      unsigned int x = 0;
+      while (x < width) {
+        if (run == 0) {
+          std::uint64_t token = 0;
+          for (int shift = 0;; shift += 7) {
+            if (tile == tile_end || shift > 56) {
+              return false;
+            }
+            std::uint8_t byte = *tile++;
+            token |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+              break;
+            }
+          }
+          if ((token & 3) > UNKNOWN) {
+            return false;
+          }
+          value = values[token & 3];
+          run = (token >> 2) + 1;
+        }
+        unsigned int count =
+            static_cast<unsigned int>(std::min<std::uint64_t>(run, width - x));
+        std::fill(target + x, target + x + count, value);
+        x += count;
+        run -= count;
+      }
+    }
+    if (run != 0 || tile != tile_end) {
+      return false;
+    }
+  }
+  return in == end;
+}
+
+/**
+ * @brief Values of decoded states in occupancy grid
+ */
+constexpr std::int8_t occupancy_values[3] = {0, 100, -1};
+
+}  // namespace grid_codec
+}  // namespace explore_common
+
+#endif  // EXPLORE_COMMON_GRID_CODEC_H_
@@ -0,0 +1,328 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef EXPLORE_COMMON_STATS_H_
+#define EXPLORE_COMMON_STATS_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+namespace explore_common
+{
+/**
+ * @brief Runtime statistics of hot paths
+ * @details Latency histograms and counters are recorded lock-free and only
+ * when collection is enabled. Disabled instrumentation costs a relaxed atomic
+ * load per site.
+ */
+namespace stats
+{
+namespace internal
+{
+inline std::atomic<bool>& enabledFlag()
+{
+  static std::atomic<bool> flag(false);
+  return flag;
+}
+}  // namespace internal
+
+/**
+ * @brief Whether statistics are collected, disabled by default
+ */
+inline bool enabled()
+{
+  return internal::enabledFlag().load(std::memory_order_relaxed);
+}
+
+inline void setEnabled(bool enabled)
+{
+  internal::enabledFlag().store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Monotonic counter, e.g. of processed cells
+ */
+class Counter
+{
+public:
+  Counter() : value_(0)
+  {
+  }
+
+  void add(std::uint64_t n = 1)
+  {
+    if (enabled()) {
+      value_.fetch_add(n, std::memory_order_relaxed);
+    }
+  }
+
+  std::uint64_t value() const
+  {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::uint64_t> value_;
+};
+
+/**
+ * @brief Latency histogram with exponential buckets
+ * @details Bucket 0 counts latencies under 1 us, bucket i latencies in
+ * [2^(i-1), 2^i) us. The last bucket is unbounded.
+ */
+class Histogram
+{
+public:
+  static constexpr size_t bucket_count = 32;
+
+  struct Snapshot {
+    std::uint64_t count = 0;
+    std::uint64_t sum_ns = 0;
+    std::uint64_t max_ns = 0;
+    std::array<std::uint64_t, bucket_count> buckets{};
+
+    /**
+     * @brief Mean latency in seconds
+     */
+    double mean() const
+    {
+      return count ? 1e-9 * sum_ns / count : 0.;
+    }
+
+    /**
+     * @brief Upper bound of latencies of quantile q in seconds
+     * @details Upper bound of the bucket is used, reported latency is at most
+     * 2 times larger than the real one. It never exceeds the maximum.
+     */
+    double quantile(double q) const
+    {
+      const double rank = q * count;
+      std::uint64_t cumulative = 0;
+      for (size_t i = 0; i + 1 < bucket_count; ++i) {
+        cumulative += buckets[i];
+        if (cumulative > 0 && cumulative >= rank) {
+          return std::min(1e-6 * double(std::uint64_t(1) << i), 1e-9 * max_ns);
+        }
+      }
+      return 1e-9 * max_ns;
+    }
+  };
+
+  Histogram() : count_(0), sum_ns_(0), max_ns_(0)
+  {
+    for (auto& bucket : buckets_) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void record(std::chrono::nanoseconds duration)
+  {
+    const std::uint64_t ns =
+        static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0));
+    size_t bucket = 0;
+    for (std::uint64_t us = ns / 1000; us > 0 && bucket + 1 < bucket_count;
+         us >>= 1) {
+      ++bucket;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+    std::uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   * @brief Copy of the histogram, consistent only approximately when
+   * latencies are recorded at the same time
+   */
+  Snapshot snapshot() const
+  {
+    Snapshot result;
+    result.count = count_.load(std::memory_order_relaxed);
+    result.sum_ns = sum_ns_.load(std::memory_order_relaxed);
+    result.max_ns = max_ns_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < bucket_count; ++i) {
+      result.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+private:
+  std::array<std::atomic<std::uint64_t>, bucket_count> buckets_;
+  std::atomic<std::uint64_t> count_;
+  std::atomic<std::uint64_t> sum_ns_;
+  std::atomic<std::uint64_t> max_ns_;
+};
+
+/**
+ * @brief Records lifetime of the scope to the histogram
+ * @details Clock is not read when statistics are disabled.
+ */
+class ScopedTimer
+{
+public:
+  explicit ScopedTimer(Histogram& histogram)
+    : histogram_(enabled() ? &histogram : nullptr)
+  {
+    if (histogram_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedTimer()
+  {
+    if (histogram_) {
+      histogram_->record(std::chrono::steady_clock::now() - start_);
+    }
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+  Histogram* histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief Named histograms and counters of the process
+ * @details Statistics are never removed, sites look them up once and keep the
+ * reference. Lookup is serialized, recording is lock-free.
+ */
+class Registry
+{
+public:
+  static Registry& instance()
+  {
+    static Registry registry;
+    return registry;
+  }
+
+  Histogram& histogram(const std::string& name)
+  {
+    return find(histograms_, name);
+  }
+
+  Counter& counter(const std::string& name)
+  {
+    return find(counters_, name);
+  }
+
+  /**
+   * @brief Statistics as key-value pairs of diagnostic status
+   * @details For each histogram its count, mean, median, 99th percentile and
+   * maximum in milliseconds are reported, counters are reported as they are.
+   */
+  diagnostic_msgs::DiagnosticStatus toDiagnosticStatus() const
+  {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    auto add = [&status](const std::string& key, const std::string& value) {
+      diagnostic_msgs::KeyValue key_value;
+      key_value.key = key;
+      key_value.value = value;
+      status.values.push_back(key_value);
+    };
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& histogram : histograms_) {
+      const std::string& name = histogram.first;
+      Histogram::Snapshot snapshot = histogram.second->snapshot();
+      add(name + " count", std::to_string(snapshot.count));
+      add(name + " mean [ms]", std::to_string(1e3 * snapshot.mean()));
+      add(name + " p50 [ms]", std::to_string(1e3 * snapshot.quantile(0.5)));
+      add(name + " p99 [ms]", std::to_string(1e3 * snapshot.quantile(0.99)));
+      add(name + " max [ms]", std::to_string(1e-6 * snapshot.max_ns));
+    }
+    for (auto& counter : counters_) {
+      add(counter.first, std::to_string(counter.second->value()));
+    }
+    return status;
+  }
+
+private:
+  template <typename T>
+  using Entries = std::vector<std::pair<std::string, std::unique_ptr<T>>>;
+
+  template <typename T>
+  T& find(Entries<T>& entries, const std::string& name)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : entries) {
+      if (entry.first == name) {
+        return *entry.second;
+      }
+    }
+    entries.emplace_back(name, std::unique_ptr<T>(new T()));
+    return *entries.back().second;
+  }
+
+  mutable std::mutex mutex_;
+  Entries<Histogram> histograms_;
+  Entries<Counter> counters_;
+};
+
+/**
+ * @brief Latency histogram of the stage, to be kept in a static reference
+ */
+inline Histogram& histogram(const std::string& name)
+{
+  return Registry::instance().histogram(name);
+}
+
+/**
+ * @brief Counter of the given name, to be kept in a static reference
+ */
+inline Counter& counter(const std::string& name)
+{
+  return Registry::instance().counter(name);
+}
+
+}  // namespace stats
+}  // namespace explore_common
+
+#endif  // EXPLORE_COMMON_STATS_H_
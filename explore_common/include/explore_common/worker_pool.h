@@ -0,0 +1,227 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef EXPLORE_COMMON_WORKER_POOL_H_
+#define EXPLORE_COMMON_WORKER_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace explore_common
+{
+/**
+ * @brief Threads kept alive between parallel loops
+ * @details Calling thread takes part in every loop, so pool of n threads
+ * starts n - 1 workers. Workers sleep while there is no loop to run. Loops
+ * must be started from one thread at a time.
+ */
+class WorkerPool
+{
+public:
+  /**
+   * @brief Starts workers
+   *
+   * @param threads Number of threads running loops including the calling
+   * thread, 0 for one thread per core
+   */
+  explicit WorkerPool(unsigned int threads)
+    : count_(0)
+    , next_(0)
+    , call_(nullptr)
+    , function_(nullptr)
+    , loop_(0)
+    , running_(0)
+    , stop_(false)
+  {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned int i = 1; i < threads; ++i) {
+      workers_.emplace_back([this, i]() { workerLoop(i); });
+    }
+  }
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    loop_started_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /**
+   * @brief Number of threads running loops including the calling thread
+   */
+  unsigned int threads() const
+  {
+    return static_cast<unsigned int>(workers_.size()) + 1;
+  }
+
+  /**
+   * @brief Runs f(i) for each i in [0, count), returns when all calls are
+   * done
+   * @details When some call throws, remaining iterations are skipped and the
+   * first exception is rethrown to the caller.
+   */
+  template <typename F>
+  void parallelFor(std::size_t count, F&& f)
+  {
+    parallelForWorkers(count, [&f](std::size_t i, std::size_t) { f(i); });
+  }
+
+  /**
+   * @brief Runs f(i, worker) for each i in [0, count)
+   * @details Same as parallelFor(), worker in [0, threads()) identifies the
+   * thread running f, calling thread is worker 0. Calls with the same worker
+   * never run concurrently, so worker can index per-thread storage.
+   */
+  template <typename F>
+  void parallelForWorkers(std::size_t count, F&& f)
+  {
+    typedef typename std::remove_reference<F>::type Function;
+    run(count,
+        [](void* function, std::size_t i, std::size_t worker) {
+          (*static_cast<Function*>(function))(i, worker);
+        },
+        const_cast<void*>(static_cast<const void*>(&f)));
+  }
+
+private:
+  typedef void (*Call)(void* function, std::size_t i, std::size_t worker);
+
+  void run(std::size_t count, Call call, void* function)
+  {
+    if (workers_.empty() || count < 2) {
+      for (std::size_t i = 0; i < count; ++i) {
+        call(function, i, 0);
+      }
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      count_ = count;
+      next_ = 0;
+      call_ = call;
+      function_ = function;
+      error_ = nullptr;
+      running_ = workers_.size();
+      ++loop_;
+    }
+    loop_started_.notify_all();
+    work(0);
+
+    // all workers must leave the loop before function goes out of scope
+    std::unique_lock<std::mutex> lock(mutex_);
+    loop_finished_.wait(lock, [this]() { return running_ == 0; });
+    if (error_) {
+      std::exception_ptr error = nullptr;
+      std::swap(error, error_);
+      std::rethrow_exception(error);
+    }
+  }
+
+  void workerLoop(std::size_t worker)
+  {
+    unsigned long done = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      loop_started_.wait(lock,
+                         [this, done]() { return stop_ || loop_ != done; });
+      if (stop_) {
+        return;
+      }
+      done = loop_;
+      lock.unlock();
+      work(worker);
+      lock.lock();
+      if (--running_ == 0) {
+        loop_finished_.notify_one();
+      }
+    }
+  }
+
+  // runs iterations of the current loop until there are none left
+  void work(std::size_t worker)
+  {
+    try {
+      for (std::size_t i = next_++; i < count_; i = next_++) {
+        call_(function_, i, worker);
+      }
+    } catch (...) {
+      // other threads stop after their current iteration
+      next_ = count_;
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable loop_started_;
+  std::condition_variable loop_finished_;
+  // current loop, changed only when no worker is running
+  std::size_t count_;
+  std::atomic<std::size_t> next_;
+  Call call_;
+  void* function_;
+  // first exception thrown in the current loop
+  std::exception_ptr error_;
+  // incremented for each loop run by workers
+  unsigned long loop_;
+  // workers which did not finish the current loop yet
+  std::size_t running_;
+  bool stop_;
+};
+}  // namespace explore_common
+
+#endif  // EXPLORE_COMMON_WORKER_POOL_H_
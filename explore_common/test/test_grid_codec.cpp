@@ -0,0 +1,159 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore_common/grid_codec.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+namespace codec = explore_common::grid_codec;
+
+static std::vector<std::int8_t>
+decodeGrid(const std::vector<std::int8_t>& payload, unsigned int width,
+           unsigned int height, bool* ok)
+{
+  std::vector<std::int8_t> data(size_t(width) * height, 42);
+  *ok = codec::decode(payload, width, height, codec::occupancy_values,
+                      [&](unsigned int y) { return data.data() + y * width; });
+  return data;
+}
+
+TEST(GridCodec, roundTripsTriState)
+{
+  std::mt19937 rng(7);
+  const unsigned int width = 123;
+  const unsigned int height = 77;
+  std::vector<std::int8_t> data(size_t(width) * height);
+  for (size_t i = 0; i < data.size(); ++i) {
+    // mix of long runs and noise, so that both tile modes are used
+    if (i < data.size() / 2) {
+      size_t run = i / 300;
+      data[i] = run % 3 == 0 ? -1 : static_cast<std::int8_t>(run % 2 * 100);
+    } else {
+      data[i] = static_cast<std::int8_t>(int(rng() % 102) - 1);
+    }
+  }
+
+  for (unsigned int tile_rows : {1u, 10u, 64u, 200u}) {
+    std::vector<std::int8_t> payload;
+    codec::encode(data.data(), width, width, height, payload, 65, tile_rows);
+    bool ok = false;
+    auto decoded = decodeGrid(payload, width, height, &ok);
+    ASSERT_TRUE(ok) << "tile rows " << tile_rows;
+    for (size_t i = 0; i < data.size(); ++i) {
+      std::int8_t expected = data[i] < 0 ? -1 : (data[i] >= 65 ? 100 : 0);
+      ASSERT_EQ(decoded[i], expected) << "cell " << i;
+    }
+  }
+}
+
+TEST(GridCodec, compressesUniformMaps)
+{
+  std::vector<std::int8_t> data(1000 * 1000, -1);
+  std::vector<std::int8_t> payload;
+  codec::encode(data.data(), 1000, 1000, 1000, payload);
+  // a few bytes per tile
+  EXPECT_LT(payload.size(), 200);
+
+  bool ok = false;
+  auto decoded = decodeGrid(payload, 1000, 1000, &ok);
+  ASSERT_TRUE(ok);
+  EXPECT_EQ(decoded, data);
+}
+
+TEST(GridCodec, packsNoisyMaps)
+{
+  std::vector<std::int8_t> data(64 * 64);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i % 2 ? 100 : 0;
+  }
+  std::vector<std::int8_t> payload;
+  codec::encode(data.data(), 64, 64, 64, payload);
+  // 2 bits per cell in a single packed tile
+  EXPECT_EQ(payload.size(), codec::header_size + 5 + data.size() / 4);
+}
+
+TEST(GridCodec, encodesSubregions)
+{
+  std::vector<std::int8_t> data(10 * 10, 0);
+  data[3 * 10 + 4] = 100;
+  std::vector<std::int8_t> payload;
+  codec::encode(data.data() + 2 * 10 + 3, 10, 4, 3, payload);
+  bool ok = false;
+  auto decoded = decodeGrid(payload, 4, 3, &ok);
+  ASSERT_TRUE(ok);
+  EXPECT_EQ(decoded[1 * 4 + 1], 100);
+  EXPECT_EQ(std::count(decoded.begin(), decoded.end(), 100), 1);
+}
+
+TEST(GridCodec, rejectsMalformedPayloads)
+{
+  std::vector<std::int8_t> data(50 * 40, 0);
+  std::vector<std::int8_t> payload;
+  codec::encode(data.data(), 50, 50, 40, payload, 65, 8);
+  bool ok = false;
+
+  decodeGrid(payload, 50, 41, &ok);
+  EXPECT_FALSE(ok);
+  decodeGrid(payload, 49, 40, &ok);
+  EXPECT_FALSE(ok);
+
+  auto truncated = payload;
+  truncated.pop_back();
+  decodeGrid(truncated, 50, 40, &ok);
+  EXPECT_FALSE(ok);
+
+  auto trailing = payload;
+  trailing.push_back(0);
+  decodeGrid(trailing, 50, 40, &ok);
+  EXPECT_FALSE(ok);
+
+  auto bad_magic = payload;
+  bad_magic[0] = 'X';
+  decodeGrid(bad_magic, 50, 40, &ok);
+  EXPECT_FALSE(ok);
+
+  // raw grid is not a valid payload
+  decodeGrid(data, 50, 40, &ok);
+  EXPECT_FALSE(ok);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
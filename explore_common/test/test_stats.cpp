@@ -0,0 +1,135 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore_common/stats.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace explore_common;
+
+TEST(Stats, collectsNothingWhenDisabled)
+{
+  stats::setEnabled(false);
+  stats::Histogram histogram;
+  stats::Counter counter;
+  {
+    stats::ScopedTimer timer(histogram);
+    counter.add(10);
+  }
+  EXPECT_EQ(histogram.snapshot().count, 0u);
+  EXPECT_EQ(counter.value(), 0u);
+}
+
+TEST(Stats, recordsLatencies)
+{
+  stats::setEnabled(true);
+  stats::Histogram histogram;
+  for (int i = 0; i < 99; ++i) {
+    histogram.record(std::chrono::microseconds(3));
+  }
+  histogram.record(std::chrono::milliseconds(10));
+  stats::Histogram::Snapshot snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, 100u);
+  EXPECT_EQ(snapshot.max_ns, 10000000u);
+  EXPECT_DOUBLE_EQ(snapshot.mean(), (99 * 3e-6 + 10e-3) / 100);
+  // 3 us falls to [2, 4) us bucket
+  EXPECT_EQ(snapshot.buckets[2], 99u);
+  EXPECT_DOUBLE_EQ(snapshot.quantile(0.5), 4e-6);
+  EXPECT_DOUBLE_EQ(snapshot.quantile(0.99), 4e-6);
+  EXPECT_DOUBLE_EQ(snapshot.quantile(1.), 10e-3);
+
+  {
+    stats::ScopedTimer timer(histogram);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(histogram.snapshot().count, 101u);
+  stats::setEnabled(false);
+}
+
+TEST(Stats, countsFromMultipleThreads)
+{
+  stats::setEnabled(true);
+  stats::Counter counter;
+  stats::Histogram histogram;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < 1000; ++j) {
+        counter.add(2);
+        histogram.record(std::chrono::nanoseconds(j));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counter.value(), 8000u);
+  EXPECT_EQ(histogram.snapshot().count, 4000u);
+  EXPECT_EQ(histogram.snapshot().max_ns, 999u);
+  stats::setEnabled(false);
+}
+
+TEST(Stats, registryKeepsStatisticsByName)
+{
+  stats::Histogram& histogram = stats::histogram("test stage");
+  EXPECT_EQ(&histogram, &stats::histogram("test stage"));
+  EXPECT_NE(&histogram, &stats::histogram("other stage"));
+  stats::Counter& counter = stats::counter("test counter");
+  EXPECT_EQ(&counter, &stats::counter("test counter"));
+
+  stats::setEnabled(true);
+  counter.add(42);
+  histogram.record(std::chrono::milliseconds(1));
+  stats::setEnabled(false);
+  auto status = stats::Registry::instance().toDiagnosticStatus();
+  bool found_counter = false;
+  bool found_count = false;
+  for (auto& value : status.values) {
+    found_counter |= value.key == "test counter" && value.value == "42";
+    found_count |= value.key == "test stage count" && value.value == "1";
+  }
+  EXPECT_TRUE(found_counter);
+  EXPECT_TRUE(found_count);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
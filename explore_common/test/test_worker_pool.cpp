@@ -0,0 +1,119 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore_common/worker_pool.h>
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using explore_common::WorkerPool;
+
+TEST(WorkerPool, runsEachIterationOnce)
+{
+  for (unsigned int threads : {1u, 2u, 4u}) {
+    WorkerPool pool(threads);
+    EXPECT_EQ(pool.threads(), threads);
+    for (size_t count : {0u, 1u, 3u, 1000u}) {
+      std::vector<int> calls(count, 0);
+      pool.parallelFor(count, [&calls](size_t i) { ++calls[i]; });
+      EXPECT_EQ(calls, std::vector<int>(count, 1));
+    }
+  }
+}
+
+TEST(WorkerPool, reusesThreads)
+{
+  WorkerPool pool(3);
+  std::mutex mutex;
+  std::set<std::thread::id> ids;
+  for (size_t i = 0; i < 100; ++i) {
+    pool.parallelFor(16, [&](size_t) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ids.insert(std::this_thread::get_id());
+    });
+  }
+  // the same threads run all loops, calling thread is one of them
+  EXPECT_LE(ids.size(), 3u);
+  EXPECT_EQ(ids.count(std::this_thread::get_id()), 1u);
+}
+
+TEST(WorkerPool, identifiesWorkers)
+{
+  WorkerPool pool(4);
+  std::vector<std::thread::id> ids(pool.threads());
+  std::vector<int> calls(1000, 0);
+  pool.parallelForWorkers(calls.size(), [&](size_t i, size_t worker) {
+    ASSERT_LT(worker, ids.size());
+    // calls with the same worker id run in the same thread
+    if (ids[worker] == std::thread::id()) {
+      ids[worker] = std::this_thread::get_id();
+    }
+    EXPECT_EQ(ids[worker], std::this_thread::get_id());
+    ++calls[i];
+  });
+  EXPECT_EQ(calls, std::vector<int>(calls.size(), 1));
+  // calling thread may finish before it gets any iteration
+  EXPECT_TRUE(ids[0] == std::thread::id() ||
+              ids[0] == std::this_thread::get_id());
+}
+
+TEST(WorkerPool, propagatesExceptions)
+{
+  for (unsigned int threads : {1u, 4u}) {
+    WorkerPool pool(threads);
+    EXPECT_THROW(pool.parallelFor(100,
+                                  [](size_t i) {
+                                    if (i == 42) {
+                                      throw std::runtime_error("failed");
+                                    }
+                                  }),
+                 std::runtime_error);
+    // pool is still usable
+    std::vector<int> calls(100, 0);
+    pool.parallelFor(calls.size(), [&calls](size_t i) { ++calls[i]; });
+    EXPECT_EQ(calls, std::vector<int>(calls.size(), 1));
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
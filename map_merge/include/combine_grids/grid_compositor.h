@@ -37,6 +37,10 @@
 #ifndef GRID_COMPOSITOR_H_
 #define GRID_COMPOSITOR_H_
 
+#include <vector>
+
+#include <combine_grids/grid_warper.h>
+#include <explore_common/worker_pool.h>
 #include <nav_msgs/OccupancyGrid.h>
 
 #include <opencv2/core/utility.hpp>
@@ -48,8 +52,60 @@ namespace internal
 class GridCompositor
 {
 public:
-  nav_msgs::OccupancyGrid::Ptr compose(const std::vector<cv::Mat>& grids,
-                                       const std::vector<cv::Rect>& rois);
+  /**
+   * @brief Compositor reducing destination tiles in parallel
+   * @details Each thread of workers gets its own warper, so scratch buffers
+   * of warpers are reused between tiles and calls.
+   *
+   * @param workers Threads composing tiles, must outlive the compositor
+   */
+  explicit GridCompositor(explore_common::WorkerPool& workers)
+    : workers_(workers), warpers_(workers.threads())
+  {
+  }
+
+  /**
+   * @brief Warps grids and composes them into a result covering all bounds
+   * @details Fused warping and compositing, see GridWarper::warpMax(). Warped
+   * grids are never materialized, each tile of the result is composed from
+   * all overlapping grids at once.
+   *
+   * @param grids Grids to warp, CV_8UC1
+   * @param transforms Transforms as for GridWarper::warp()
+   * @param rois Areas where grids may land, grids with empty areas are skipped
+   * @param bounds Areas covered by the result, the rest of the result is
+   * unknown
+   */
+  nav_msgs::OccupancyGrid::Ptr warpCompose(
+      const std::vector<cv::Mat>& grids, const std::vector<cv::Mat>& transforms,
+      const std::vector<cv::Rect>& rois, const std::vector<cv::Rect>& bounds);
+  /**
+   * @brief Composes region of a result created by warpCompose() again
+   *
+   * @param region Region of the result to recompose
+   * @param origin Top left corner of result
+   * @param result CV_8S view of the result data
+   */
+  void warpRecompose(const std::vector<cv::Mat>& grids,
+                     const std::vector<cv::Mat>& transforms,
+                     const std::vector<cv::Rect>& rois, const cv::Rect& region,
+                     const cv::Point& origin, cv::Mat& result);
+
+  /**
+   * @brief Splits area into disjoint tiles of at most tile_size x tile_size
+   */
+  static std::vector<cv::Rect> tiles(const cv::Rect& area);
+
+  static const int tile_size = 256;
+
+private:
+  void warpTiles(const std::vector<cv::Mat>& grids,
+                 const std::vector<cv::Mat>& transforms,
+                 const std::vector<cv::Rect>& rois, const cv::Rect& region,
+                 const cv::Point& origin, cv::Mat& result, bool clear);
+
+  explore_common::WorkerPool& workers_;
+  std::vector<GridWarper> warpers_;
 };
 
 }  // namespace internal
@@ -37,6 +37,8 @@
 #ifndef GRID_WARPER_H_
 #define GRID_WARPER_H_
 
+#include <vector>
+
 #include <opencv2/core/utility.hpp>
 
 namespace combine_grids
@@ -46,11 +48,43 @@ namespace internal
 class GridWarper
 {
 public:
+  /**
+   * @brief Warps whole grid by cv::warpAffine
+   * @details Reference implementation, composition uses only warpMax(). Kept
+   * for tests and benchmarks of the fused kernel.
+   *
+   * @return Area of the warped grid in merged coordinates
+   */
   cv::Rect warp(const cv::Mat& grid, const cv::Mat& transform,
                 cv::Mat& warped_grid);
+  /**
+   * @brief Warps the part of grid which lands in roi and composes it into
+   * composed by max
+   * @details Fused warping and compositing, no warped image is materialized.
+   * Each cell of roi is mapped to the grid by transform, with nearest
+   * neighbour as in warp(). Transforms by multiples of 90 degrees copy whole
+   * rows or walk the grid with a constant stride. Scratch rows are kept in
+   * the warper and reused by later calls.
+   *
+   * @param grid Grid to warp, CV_8UC1
+   * @param transform Transform as for warp()
+   * @param roi Area in the same coordinates as areas returned by warp()
+   * @param composed CV_8S matrix with the size of roi
+   */
+  void warpMax(const cv::Mat& grid, const cv::Mat& transform,
+               const cv::Rect& roi, cv::Mat& composed);
+  /**
+   * @brief Area that warp() would return, grid is not warped
+   */
+  cv::Rect warpedRoi(const cv::Mat& grid, const cv::Mat& transform);
 
 private:
   cv::Rect warpRoi(const cv::Mat& grid, const cv::Mat& transform);
+
+  // scratch of warpMax(), only grows
+  std::vector<int> adelta_;
+  std::vector<int> bdelta_;
+  std::vector<schar> row_;
 };
 
 }  // namespace internal
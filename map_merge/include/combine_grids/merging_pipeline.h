@@ -37,12 +37,20 @@
 #ifndef MERGING_PIPELINE_H_
 #define MERGING_PIPELINE_H_
 
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
 #include <vector>
 
+#include <combine_grids/grid_compositor.h>
+#include <explore_common/worker_pool.h>
 #include <geometry_msgs/Transform.h>
 #include <nav_msgs/OccupancyGrid.h>
 
 #include <opencv2/core/utility.hpp>
+#include <opencv2/stitching/detail/matchers.hpp>
 
 namespace combine_grids
 {
@@ -50,29 +58,235 @@ enum class FeatureType { AKAZE, ORB, SURF };
 
 /**
  * @brief Pipeline for merging overlapping occupancy grids
- * @details Pipeline works on internally stored grids.
+ * @details Pipeline works on internally stored grids. Only bounding boxes of
+ * known cells of grids are used for feature detection and warping. Features of
+ * grids and pairwise matches are cached between estimations, only grids which
+ * content changed since the last estimation are processed again.
  */
 class MergingPipeline
 {
 public:
+  /**
+   * @brief Feeds grids to the pipeline
+   * @details Grids are not copied. The pipeline keeps the messages until the
+   * next feed and reads them in estimation, refinement and composition. The
+   * last composed messages are kept until the next composition to find
+   * grids changed since then.
+   *
+   * Grids may be changed in place between calls, as grids returned by
+   * map_merge::GridAssembler::update() are. Such changes must not overlap with
+   * any call of the pipeline, and the grid must be fed again with a new stamp
+   * (or with its changed region, see the other overload) before the pipeline
+   * uses it again. A grid changed in place and fed with the same stamp is
+   * taken as unchanged.
+   *
+   * @param grids_begin Grids as nav_msgs::OccupancyGrid::ConstPtr, null or
+   * empty grids are left out of merging
+   */
   template <typename InputIt>
   void feed(InputIt grids_begin, InputIt grids_end);
+  /**
+   * @brief Feeds grids together with their regions changed since the last
+   * feed
+   * @details Bounding boxes of known cells are kept for grids fed again as the
+   * same message. They are only grown by known cells in changed regions,
+   * grids fed as a different message are scanned whole.
+   *
+   * @param changed_regions Regions of grids (in grid cells) changed in place
+   * since the last feed, indexed as grids. Missing regions mean no change.
+   * Stamps of grids fed with regions are not compared.
+   */
+  template <typename InputIt>
+  void feed(InputIt grids_begin, InputIt grids_end,
+            const std::vector<cv::Rect>& changed_regions);
   bool estimateTransforms(FeatureType feature = FeatureType::AKAZE,
                           double confidence = 1.0);
+  /**
+   * @brief Refines transforms from the last estimation locally
+   * @details Tracking alternative to estimateTransforms() for slowly changing
+   * grids. Each grid is aligned by ECC to the other grids, composed with their
+   * current transforms, in their downsampled overlap. Fails when some grid
+   * has no transform yet.
+   *
+   * @param confidence Minimal confidence of refinement of each grid.
+   * Confidence is r / (1 - r) for ECC correlation coefficient r, 1.0
+   * corresponds to correlation 0.5.
+   * @return True if all transforms were refined, otherwise transforms are not
+   * changed and global estimation is needed
+   */
+  bool refineTransforms(double confidence = 1.0);
   nav_msgs::OccupancyGrid::Ptr composeGrids();
+  /**
+   * @brief Composes grids, recomposing only changed regions when possible
+   * @details Merged grid is kept between compositions. When grids have the
+   * same sizes and transforms as in the last composition, only areas of the
+   * merged grid affected by changed regions are recomposed. Otherwise grids
+   * are composed from scratch.
+   *
+   * @param changed_regions Regions of grids (in grid cells) changed since the
+   * last composition, indexed as grids fed to the pipeline. Missing regions
+   * mean no change. Grids fed as a different message than at the last
+   * composition are considered changed completely.
+   *
+   * @return Merged grid. The pipeline keeps two merged grids and composes
+   * into one nobody else holds, so a returned grid is never changed while it
+   * is held (e.g. by a latched publisher). When the last result is still
+   * held, the other grid is brought up to date by copying only the regions
+   * changed since it was composed.
+   */
+  nav_msgs::OccupancyGrid::Ptr
+  composeGrids(const std::vector<cv::Rect>& changed_regions);
+
+  /**
+   * @brief Part of the grid returned by the last composeGrids() which could
+   * have changed since the previous composition
+   * @details In cells of the returned grid. Covers the whole grid when it was
+   * composed from scratch.
+   */
+  cv::Rect changedRegion() const
+  {
+    return changed_region_;
+  }
 
   std::vector<geometry_msgs::Transform> getTransforms() const;
   template <typename InputIt>
   bool setTransforms(InputIt transforms_begin, InputIt transforms_end);
 
+  /**
+   * @brief Sets number of threads used for feature extraction, matching,
+   * warping and compositing
+   * @details Threads are kept alive between calls of the pipeline.
+   *
+   * @param workers Number of threads, 0 for one thread per hardware thread
+   */
+  void setWorkerCount(size_t workers)
+  {
+    if (workers != workers_) {
+      compositor_.reset();
+      pool_.reset();
+    }
+    workers_ = workers;
+  }
+
+  /**
+   * @brief Limits pairs of grids matched by estimateTransforms()
+   * @details Each grid is matched only with k grids with the most similar
+   * signatures (histograms of visual words of their features), and with grids
+   * it overlaps under the last estimated transforms. Matches still cached
+   * from previous estimations are used for all pairs.
+   *
+   * @param k Number of neighbours of each grid, 0 to match all pairs
+   */
+  void setMatchingNeighbours(size_t k)
+  {
+    matching_neighbours_ = k;
+  }
+
+  /**
+   * @brief Sets check called by estimateTransforms() between units of work
+   * @details Check may block to give way to more important work. When it
+   * returns false, estimation stops and returns false. Work finished until
+   * then is cached for the next estimation. Check is called concurrently from
+   * all workers.
+   */
+  void setPreemptionCheck(std::function<bool()> check)
+  {
+    preemption_check_ = std::move(check);
+  }
+
 private:
+  // features computed for a grid at the same position in grids_
+  struct CachedFeatures {
+    nav_msgs::OccupancyGrid::ConstPtr grid;
+    ros::Time stamp;
+    cv::Rect roi;
+    std::uint64_t hash = 0;
+    // unique id of computed features, 0 when features were not computed
+    std::uint64_t generation = 0;
+    cv::detail::ImageFeatures features;
+    // histogram of visual words of features, cheap global descriptor
+    std::vector<float> signature;
+  };
+
+  // bounding box of known cells of a grid at the same position in grids_
+  struct CachedRoi {
+    nav_msgs::OccupancyGrid::ConstPtr grid;
+    ros::Time stamp;
+    cv::Size size;
+    cv::Rect roi;
+  };
+
+  static cv::Rect knownRoi(const cv::Mat& image);
+  // known cells in region of image, margin is clipped only by image
+  static cv::Rect knownRoi(const cv::Mat& image, const cv::Rect& region);
+  template <typename InputIt>
+  void setGrids(InputIt grids_begin, InputIt grids_end);
+  void updateKnownRois(const std::vector<cv::Rect>* changed_regions);
+  double refineTransform(size_t i, std::vector<cv::Mat>& transforms) const;
+  std::vector<char> matchMask() const;
+  bool updateCacheKey(size_t i);
+  nav_msgs::OccupancyGrid::Ptr
+  composeGrids(const std::vector<cv::Rect>& changed_regions, bool full);
+  // areas where known cells of grids land, empty for grids left out
+  std::vector<cv::Rect> knownBounds();
+  void composeAll(const std::vector<cv::Rect>& bounds);
+  void composeChanged(const std::vector<cv::Rect>& changed_regions);
+  // pool of workers_ threads, created on first use
+  explore_common::WorkerPool& workers();
+  // compositor running on workers(), created on first use
+  internal::GridCompositor& compositor();
+
   std::vector<nav_msgs::OccupancyGrid::ConstPtr> grids_;
   std::vector<cv::Mat> images_;
+  // bounding boxes of known cells in images_
+  std::vector<cv::Rect> known_rois_;
+  std::vector<CachedRoi> roi_cache_;
   std::vector<cv::Mat> transforms_;
+
+  std::vector<CachedFeatures> features_cache_;
+  // matches between features with (lower index, higher index) generations
+  std::map<std::pair<std::uint64_t, std::uint64_t>, cv::detail::MatchesInfo>
+      matches_cache_;
+  FeatureType cached_feature_type_ = FeatureType::AKAZE;
+  std::uint64_t next_generation_ = 0;
+  size_t workers_ = 0;
+  std::unique_ptr<explore_common::WorkerPool> pool_;
+  // keeps warpers and their scratch between compositions, uses pool_
+  std::unique_ptr<internal::GridCompositor> compositor_;
+  size_t matching_neighbours_ = 0;
+  std::function<bool()> preemption_check_;
+
+  // merged grid from the last composition and its layout. Canvas of
+  // composed_ covers composed_roi_ in coordinates of warped grids.
+  nav_msgs::OccupancyGrid::Ptr composed_;
+  // grid of the composition before, composed into while composed_ is held.
+  // It may differ from composed_ in spare_stale_ (in cells of the canvas).
+  nav_msgs::OccupancyGrid::Ptr spare_;
+  cv::Rect spare_stale_;
+  cv::Rect composed_roi_;
+  std::vector<nav_msgs::OccupancyGrid::ConstPtr> composed_grids_;
+  std::vector<cv::Rect> composed_bounds_;
+  std::vector<cv::Mat> composed_transforms_;
+  cv::Rect changed_region_;
 };
 
 template <typename InputIt>
 void MergingPipeline::feed(InputIt grids_begin, InputIt grids_end)
+{
+  setGrids(grids_begin, grids_end);
+  updateKnownRois(nullptr);
+}
+
+template <typename InputIt>
+void MergingPipeline::feed(InputIt grids_begin, InputIt grids_end,
+                           const std::vector<cv::Rect>& changed_regions)
+{
+  setGrids(grids_begin, grids_end);
+  updateKnownRois(&changed_regions);
+}
+
+template <typename InputIt>
+void MergingPipeline::setGrids(InputIt grids_begin, InputIt grids_end)
 {
   static_assert(std::is_assignable<nav_msgs::OccupancyGrid::ConstPtr&,
                                    decltype(*grids_begin)>::value,
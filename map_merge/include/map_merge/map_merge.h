@@ -39,12 +39,15 @@
 #define MAP_MERGE_H_
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <forward_list>
 #include <mutex>
 #include <unordered_map>
 
 #include <combine_grids/merging_pipeline.h>
 #include <geometry_msgs/Pose.h>
+#include <map_merge/tiled_grid.h>
 #include <map_msgs/OccupancyGridUpdate.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <ros/ros.h>
@@ -53,13 +56,16 @@
 namespace map_merge
 {
 struct MapSubscription {
-  // protects consistency of writable_map and readonly_map
-  // also protects reads and writes of shared_ptrs
+  // protects map and dirty_region, readers take snapshots of map
   std::mutex mutex;
 
   geometry_msgs::Transform initial_pose;
-  nav_msgs::OccupancyGrid::Ptr writable_map;
-  nav_msgs::OccupancyGrid::ConstPtr readonly_map;
+  TiledGrid map;
+  // bounding box of cells changed since the map was last fed to the pipeline
+  cv::Rect dirty_region;
+  // contiguous grid for the pipeline, used only by the thread feeding the
+  // pipeline
+  GridAssembler assembler;
 
   ros::Subscriber map_sub;
   ros::Subscriber map_updates_sub;
@@ -72,17 +78,35 @@ private:
 
   /* parameters */
   double merging_rate_;
+  double merging_min_latency_;
+  double merging_max_latency_;
   double discovery_rate_;
   double estimation_rate_;
   double confidence_threshold_;
+  bool estimation_tracking_;
   std::string robot_map_topic_;
   std::string robot_map_updates_topic_;
   std::string robot_namespace_;
   std::string world_frame_;
   bool have_initial_poses_;
+  bool publish_map_updates_;
+  // robot maps and published merged maps are encoded by grid_codec
+  bool compressed_maps_;
+  bool publish_compressed_;
+  int spinner_threads_;
 
   // publishing
   ros::Publisher merged_map_publisher_;
+  ros::Publisher merged_map_updates_publisher_;
+  ros::Publisher compressed_map_publisher_;
+  ros::Publisher compressed_map_updates_publisher_;
+  ros::Publisher stats_publisher_;
+  ros::Timer stats_timer_;
+  // layout of the last published full map, updates are relative to it
+  nav_msgs::MapMetaData published_info_;
+  bool full_map_published_;
+  // set when a new subscriber needs a full map
+  std::atomic<bool> full_map_requested_;
   // maps robots namespaces to maps. does not own
   std::unordered_map<std::string, MapSubscription*> robots_;
   // owns maps -- iterator safe
@@ -90,16 +114,47 @@ private:
   size_t subscriptions_size_;
   boost::shared_mutex subscriptions_mutex_;
   combine_grids::MergingPipeline pipeline_;
+  // regions changed in grids fed by poseEstimation, not yet composed
+  std::vector<cv::Rect> changed_regions_;
+  // protects pipeline_ and changed_regions_
   std::mutex pipeline_mutex_;
+  // used only by poseEstimation, estimation never blocks composition
+  combine_grids::MergingPipeline estimation_pipeline_;
+
+  /* scheduling of merging and estimation */
+  // protects all scheduling state
+  std::mutex schedule_mutex_;
+  std::condition_variable schedule_cv_;
+  // maps changed since the merge or estimation started last time
+  bool merge_pending_;
+  bool estimation_pending_;
+  // first and last change waiting for merge
+  std::chrono::steady_clock::time_point first_change_;
+  std::chrono::steady_clock::time_point last_change_;
+  // estimation gives way to composition
+  bool composing_;
+  bool shutting_down_;
 
   std::string robotNameFromTopic(const std::string& topic);
   bool isRobotMapTopic(const ros::master::TopicInfo& topic);
   bool getInitPose(const std::string& name, geometry_msgs::Transform& pose);
 
+  void mapChanged();
+  void requestMerge();
+  bool estimationMayContinue();
   void fullMapUpdate(const nav_msgs::OccupancyGrid::ConstPtr& msg,
                      MapSubscription& map);
   void partialMapUpdate(const map_msgs::OccupancyGridUpdate::ConstPtr& msg,
                         MapSubscription& map);
+  void publishMergedMap(const nav_msgs::OccupancyGrid::Ptr& merged_map,
+                        const cv::Rect& changed_region);
+  void publishFullMap(const nav_msgs::OccupancyGrid::Ptr& merged_map);
+  void publishMapUpdate(const nav_msgs::OccupancyGrid& merged_map,
+                        const cv::Rect& changed_region);
+  void publishStats();
+  std::vector<nav_msgs::OccupancyGridConstPtr>
+  takeGrids(std::vector<cv::Rect>& changed_regions,
+            std::vector<geometry_msgs::Transform>* transforms = nullptr);
 
 public:
   MapMerge();
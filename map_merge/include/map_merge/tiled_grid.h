@@ -0,0 +1,150 @@
+#ifndef TILED_GRID_H_
+#define TILED_GRID_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <boost/shared_ptr.hpp>
+
+#include <opencv2/core/utility.hpp>
+
+namespace map_merge
+{
+/**
+ * @brief Occupancy grid stored as bands of rows shared copy-on-write
+ * @details Copies of the grid share bands, so a copy is a cheap immutable
+ * snapshot. Band is cloned when it is written while shared with a snapshot.
+ * Bands of a grid reset to a full map alias data of the map message.
+ */
+class TiledGrid
+{
+public:
+  explicit TiledGrid(unsigned int band_rows = 64);
+
+  /**
+   * @brief Replaces grid with full map, no data are copied
+   */
+  void reset(const nav_msgs::OccupancyGrid::ConstPtr& grid);
+
+  /**
+   * @brief Writes partial update into the grid
+   * @details Only bands touched by the update are cloned, and only if they are
+   * shared. Parts of the update outside of the grid are ignored.
+   *
+   * @return Updated region of the grid, empty if nothing was written
+   */
+  cv::Rect update(const map_msgs::OccupancyGridUpdate& update);
+
+  /**
+   * @brief Replaces grid with full map encoded by grid_codec
+   * @details Payload is decoded directly into bands owned by the grid.
+   *
+   * @return False if payload is malformed, grid is left empty then
+   */
+  bool resetEncoded(const nav_msgs::OccupancyGrid& grid);
+
+  /**
+   * @brief Writes partial update encoded by grid_codec into the grid
+   * @details Payload is decoded directly into bands touched by the update,
+   * bands are cloned as in update(). Update must lie within the grid.
+   *
+   * @return Updated region of the grid, empty if nothing was written or
+   * payload is malformed. Malformed payload may be decoded partially.
+   */
+  cv::Rect updateEncoded(const map_msgs::OccupancyGridUpdate& update);
+
+  bool empty() const
+  {
+    return !source_ && bands_.empty();
+  }
+
+  const std_msgs::Header& header() const
+  {
+    return header_;
+  }
+
+  const nav_msgs::MapMetaData& info() const
+  {
+    return info_;
+  }
+
+  /**
+   * @brief Full map the grid was reset to, null when grid has been updated
+   * since
+   */
+  const nav_msgs::OccupancyGrid::ConstPtr& source() const
+  {
+    return source_;
+  }
+
+  unsigned int bandRows() const
+  {
+    return band_rows_;
+  }
+
+  size_t bands() const
+  {
+    return bands_.size();
+  }
+
+  const std::int8_t* bandData(size_t band) const
+  {
+    return bands_[band].data.get();
+  }
+
+  /**
+   * @brief Version of band data, it changes whenever the band is written
+   */
+  std::uint64_t bandVersion(size_t band) const
+  {
+    return bands_[band].version;
+  }
+
+private:
+  struct Band {
+    boost::shared_ptr<const std::int8_t> data;
+    // data are owned by band, not by a map message
+    bool owned;
+    std::uint64_t version;
+  };
+
+  std::int8_t* writableBand(size_t band);
+
+  unsigned int band_rows_;
+  std_msgs::Header header_;
+  nav_msgs::MapMetaData info_;
+  nav_msgs::OccupancyGrid::ConstPtr source_;
+  std::vector<Band> bands_;
+  std::uint64_t next_version_;
+};
+
+/**
+ * @brief Contiguous occupancy grid kept in sync with snapshots of TiledGrid
+ * @details Only bands which changed since the last update are copied.
+ * Returned grid is updated in place by later updates, caller has to make
+ * sure it is not read concurrently. Holders of the grid, e.g.
+ * combine_grids::MergingPipeline::feed(), see the new content too: the grid
+ * keeps its address, only its stamp and changed cells differ.
+ */
+class GridAssembler
+{
+public:
+  /**
+   * @brief Brings grid up to date with snapshot
+   * @details Unmodified full map is returned as is.
+   *
+   * @return Grid with the content of snapshot, null for empty snapshot
+   */
+  nav_msgs::OccupancyGrid::ConstPtr update(const TiledGrid& snapshot);
+
+private:
+  nav_msgs::OccupancyGrid::Ptr grid_;
+  // versions of bands copied to grid_
+  std::vector<std::uint64_t> versions_;
+};
+
+}  // namespace map_merge
+
+#endif  // TILED_GRID_H_
@@ -36,6 +36,8 @@
 
 #include <combine_grids/grid_compositor.h>
 
+#include <algorithm>
+
 #include <opencv2/stitching/detail/util.hpp>
 
 #include <ros/assert.h>
@@ -44,43 +46,88 @@ namespace combine_grids
 {
 namespace internal
 {
-nav_msgs::OccupancyGrid::Ptr GridCompositor::compose(
-    const std::vector<cv::Mat>& grids, const std::vector<cv::Rect>& rois)
+const int GridCompositor::tile_size;
+
+nav_msgs::OccupancyGrid::Ptr GridCompositor::warpCompose(
+    const std::vector<cv::Mat>& grids, const std::vector<cv::Mat>& transforms,
+    const std::vector<cv::Rect>& rois, const std::vector<cv::Rect>& bounds)
 {
+  ROS_ASSERT(grids.size() == transforms.size());
   ROS_ASSERT(grids.size() == rois.size());
 
   nav_msgs::OccupancyGrid::Ptr result_grid(new nav_msgs::OccupancyGrid());
 
   std::vector<cv::Point> corners;
-  corners.reserve(grids.size());
   std::vector<cv::Size> sizes;
-  sizes.reserve(grids.size());
-  for (auto& roi : rois) {
+  for (auto& roi : bounds) {
+    if (roi.empty()) {
+      continue;
+    }
     corners.push_back(roi.tl());
     sizes.push_back(roi.size());
   }
+  if (corners.empty()) {
+    return result_grid;
+  }
   cv::Rect dst_roi = cv::detail::resultRoi(corners, sizes);
 
   result_grid->info.width = static_cast<uint>(dst_roi.width);
   result_grid->info.height = static_cast<uint>(dst_roi.height);
   result_grid->data.resize(static_cast<size_t>(dst_roi.area()), -1);
-  // create view for opencv pointing to newly allocated grid
   cv::Mat result(dst_roi.size(), CV_8S, result_grid->data.data());
-
-  for (size_t i = 0; i < grids.size(); ++i) {
-    // we need to compensate global offset
-    cv::Rect roi = cv::Rect(corners[i] - dst_roi.tl(), sizes[i]);
-    cv::Mat result_roi(result, roi);
-    // reinterpret warped matrix as signed
-    // we will not change this matrix, but opencv does not support const matrices
-    cv::Mat warped_signed (grids[i].size(), CV_8S, const_cast<uchar*>(grids[i].ptr()));
-    // compose img into result matrix
-    cv::max(result_roi, warped_signed, result_roi);
-  }
+  warpTiles(grids, transforms, rois, dst_roi, dst_roi.tl(), result, false);
 
   return result_grid;
 }
 
+void GridCompositor::warpRecompose(const std::vector<cv::Mat>& grids,
+                                   const std::vector<cv::Mat>& transforms,
+                                   const std::vector<cv::Rect>& rois,
+                                   const cv::Rect& region,
+                                   const cv::Point& origin, cv::Mat& result)
+{
+  ROS_ASSERT(grids.size() == transforms.size());
+  ROS_ASSERT(grids.size() == rois.size());
+  warpTiles(grids, transforms, rois, region, origin, result, true);
+}
+
+void GridCompositor::warpTiles(const std::vector<cv::Mat>& grids,
+                               const std::vector<cv::Mat>& transforms,
+                               const std::vector<cv::Rect>& rois,
+                               const cv::Rect& region, const cv::Point& origin,
+                               cv::Mat& result, bool clear)
+{
+  std::vector<cv::Rect> result_tiles = tiles(region);
+  workers_.parallelForWorkers(result_tiles.size(), [&](size_t t,
+                                                      size_t worker) {
+    GridWarper& warper = warpers_[worker];
+    const cv::Rect& tile = result_tiles[t];
+    if (clear) {
+      result(tile - origin).setTo(cv::Scalar::all(-1));
+    }
+    for (size_t i = 0; i < grids.size(); ++i) {
+      cv::Rect roi = rois[i] & tile;
+      if (roi.empty()) {
+        continue;
+      }
+      cv::Mat result_roi(result, roi - origin);
+      warper.warpMax(grids[i], transforms[i], roi, result_roi);
+    }
+  });
+}
+
+std::vector<cv::Rect> GridCompositor::tiles(const cv::Rect& area)
+{
+  std::vector<cv::Rect> result;
+  for (int y = area.y; y < area.y + area.height; y += tile_size) {
+    for (int x = area.x; x < area.x + area.width; x += tile_size) {
+      result.emplace_back(x, y, std::min(tile_size, area.x + area.width - x),
+                          std::min(tile_size, area.y + area.height - y));
+    }
+  }
+  return result;
+}
+
 }  // namespace internal
 
 }  // namespace combine_grids
@@ -36,6 +36,10 @@
 
 #include <combine_grids/grid_warper.h>
 
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/stitching/detail/warpers.hpp>
 
 #include <ros/assert.h>
@@ -44,13 +48,61 @@ namespace combine_grids
 {
 namespace internal
 {
+// fixed point precision of source coordinates, the same as in cv::warpAffine
+static constexpr int ab_bits = 10;
+static constexpr int ab_scale = 1 << ab_bits;
+
+// coefficients very close to -1, 0 or 1 are snapped, so rotations by multiples
+// of 90 degrees take the axis-aligned path
+static double snapUnit(double v)
+{
+  double r = std::round(v);
+  return (std::abs(r) <= 1. && std::abs(v - r) < 1e-9) ? r : v;
+}
+
+static bool isUnit(double v)
+{
+  return v == 0. || v == 1. || v == -1.;
+}
+
+// restricts [begin, end) to x for which 0 <= base + step * x < size, step is
+// -1, 0 or 1
+static void clipLinear(int base, int step, int size, int& begin, int& end)
+{
+  if (step > 0) {
+    begin = std::max(begin, -base);
+    end = std::min(end, size - base);
+  } else if (step < 0) {
+    begin = std::max(begin, base - size + 1);
+    end = std::min(end, base + 1);
+  } else if (base < 0 || base >= size) {
+    end = begin;
+  }
+}
+
+// dst = max(dst, src) for n cells
+static void maxRow(schar* dst, const schar* src, int n)
+{
+  int x = 0;
+#if CV_SIMD128
+  for (; x <= n - 16; x += 16) {
+    cv::v_int8x16 a = cv::v_load(dst + x);
+    cv::v_int8x16 b = cv::v_load(src + x);
+    cv::v_store(dst + x, cv::v_max(a, b));
+  }
+#endif
+  for (; x < n; ++x) {
+    dst[x] = std::max(dst[x], src[x]);
+  }
+}
+
 cv::Rect GridWarper::warp(const cv::Mat& grid, const cv::Mat& transform,
                           cv::Mat& warped_grid)
 {
   ROS_ASSERT(transform.type() == CV_64F);
+  cv::Rect roi = warpedRoi(grid, transform);
   cv::Mat H;
   invertAffineTransform(transform.rowRange(0, 2), H);
-  cv::Rect roi = warpRoi(grid, H);
   // shift top left corner for warp affine (otherwise the image is cropped)
   H.at<double>(0, 2) -= roi.tl().x;
   H.at<double>(1, 2) -= roi.tl().y;
@@ -58,10 +110,108 @@ cv::Rect GridWarper::warp(const cv::Mat& grid, const cv::Mat& transform,
              cv::BORDER_CONSTANT,
              cv::Scalar::all(255) /* this is -1 for signed char */);
   ROS_ASSERT(roi.size() == warped_grid.size());
-
   return roi;
 }
 
+void GridWarper::warpMax(const cv::Mat& grid, const cv::Mat& transform,
+                         const cv::Rect& roi, cv::Mat& composed)
+{
+  ROS_ASSERT(transform.type() == CV_64F);
+  ROS_ASSERT(grid.type() == CV_8UC1);
+  ROS_ASSERT(composed.type() == CV_8S && composed.size() == roi.size());
+  if (grid.empty() || roi.empty()) {
+    return;
+  }
+
+  // maps coordinates of warped grids to the source grid
+  const double* t0 = transform.ptr<double>(0);
+  const double* t1 = transform.ptr<double>(1);
+  const double M[6] = {snapUnit(t0[0]), snapUnit(t0[1]), t0[2],
+                       snapUnit(t1[0]), snapUnit(t1[1]), t1[2]};
+  const bool axis_aligned =
+      isUnit(M[0]) && isUnit(M[1]) && isUnit(M[3]) && isUnit(M[4]);
+
+  // column contributions are computed once for all rows. Coordinates are
+  // absolute, so any split of the result into rois samples the same cells.
+  const size_t width = static_cast<size_t>(roi.width);
+  if (!axis_aligned) {
+    if (adelta_.size() < width) {
+      adelta_.resize(width);
+      bdelta_.resize(width);
+    }
+    for (int x = 0; x < roi.width; ++x) {
+      adelta_[x] = static_cast<int>(std::lrint(M[0] * (roi.x + x) * ab_scale));
+      bdelta_[x] = static_cast<int>(std::lrint(M[3] * (roi.x + x) * ab_scale));
+    }
+  }
+  if (row_.size() < width) {
+    row_.resize(width);
+  }
+  const int* adelta = adelta_.data();
+  const int* bdelta = bdelta_.data();
+  schar* row = row_.data();
+
+  for (int y = 0; y < roi.height; ++y) {
+    const int yg = roi.y + y;
+    // round to nearest
+    const int X0 =
+        static_cast<int>(std::lrint((M[1] * yg + M[2]) * ab_scale)) +
+        ab_scale / 2;
+    const int Y0 =
+        static_cast<int>(std::lrint((M[4] * yg + M[5]) * ab_scale)) +
+        ab_scale / 2;
+    schar* dst = composed.ptr<schar>(y);
+
+    if (!axis_aligned) {
+      // general rotation, cells outside of the grid are unknown
+      for (int x = 0; x < roi.width; ++x) {
+        int sx = (X0 + adelta[x]) >> ab_bits;
+        int sy = (Y0 + bdelta[x]) >> ab_bits;
+        row[x] = (unsigned(sx) < unsigned(grid.cols) &&
+                  unsigned(sy) < unsigned(grid.rows))
+                     ? grid.ptr<schar>(sy)[sx]
+                     : schar(-1);
+      }
+      maxRow(dst, row, roi.width);
+      continue;
+    }
+
+    // source cell is (bx + a * x, by + c * x) for x in roi
+    const int a = static_cast<int>(M[0]);
+    const int c = static_cast<int>(M[3]);
+    const int bx = (X0 >> ab_bits) + a * roi.x;
+    const int by = (Y0 >> ab_bits) + c * roi.x;
+    int begin = 0;
+    int end = roi.width;
+    clipLinear(bx, a, grid.cols, begin, end);
+    clipLinear(by, c, grid.rows, begin, end);
+    if (begin >= end) {
+      continue;
+    }
+    const schar* src = grid.ptr<schar>(by + c * begin) + bx + a * begin;
+    if (a == 1 && c == 0) {
+      // translation, source row is contiguous
+      maxRow(dst + begin, src, end - begin);
+      continue;
+    }
+    // rotation by a multiple of 90 degrees, source is walked with a constant
+    // stride
+    const ptrdiff_t stride = a + c * static_cast<ptrdiff_t>(grid.step);
+    for (int x = begin; x < end; ++x) {
+      row[x] = src[(x - begin) * stride];
+    }
+    maxRow(dst + begin, row + begin, end - begin);
+  }
+}
+
+cv::Rect GridWarper::warpedRoi(const cv::Mat& grid, const cv::Mat& transform)
+{
+  ROS_ASSERT(transform.type() == CV_64F);
+  cv::Mat H;
+  invertAffineTransform(transform.rowRange(0, 2), H);
+  return warpRoi(grid, H);
+}
+
 cv::Rect GridWarper::warpRoi(const cv::Mat& grid, const cv::Mat& transform)
 {
   cv::Ptr<cv::detail::PlaneWarper> warper =
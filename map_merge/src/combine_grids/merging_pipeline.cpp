@@ -37,25 +37,325 @@
 #include <combine_grids/grid_compositor.h>
 #include <combine_grids/grid_warper.h>
 #include <combine_grids/merging_pipeline.h>
+#include <explore_common/stats.h>
 #include <ros/assert.h>
 #include <ros/console.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+#include <opencv2/imgproc.hpp>
 #include <opencv2/stitching/detail/matchers.hpp>
 #include <opencv2/stitching/detail/motion_estimators.hpp>
+#include <opencv2/video/tracking.hpp>
 
 #include "estimation_internal.h"
 
 namespace combine_grids
 {
+namespace stats = explore_common::stats;
+
+// AffineBestOf2NearestMatcher needs at least 6 matches to estimate a transform
+static constexpr size_t min_pair_keypoints = 6;
+// known area is extended by this many cells, so that features on its border
+// are not lost at the border of the cropped image
+static constexpr int known_roi_margin = 32;
+// value of unknown cells in images
+static constexpr uchar unknown_cell = 255;
+
+// index of the first known cell in row or size when there is none
+static size_t firstKnown(const uchar* row, size_t size)
+{
+  size_t x = 0;
+  for (; x + sizeof(std::uint64_t) <= size; x += sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, row + x, sizeof(word));
+    if (word != ~std::uint64_t(0)) {
+      break;
+    }
+  }
+  while (x < size && row[x] == unknown_cell) {
+    ++x;
+  }
+  return x;
+}
+
+// index after the last known cell in row or 0 when there is none
+static size_t lastKnown(const uchar* row, size_t size)
+{
+  size_t x = size;
+  for (; x >= sizeof(std::uint64_t); x -= sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, row + x - sizeof(word), sizeof(word));
+    if (word != ~std::uint64_t(0)) {
+      break;
+    }
+  }
+  while (x > 0 && row[x - 1] == unknown_cell) {
+    --x;
+  }
+  return x;
+}
+
+// exact bounding box of known cells
+static cv::Rect knownBox(const cv::Mat& image)
+{
+  const size_t cols = static_cast<size_t>(image.cols);
+  size_t x0 = cols, x1 = 0;
+  int y0 = image.rows, y1 = 0;
+  for (int y = 0; y < image.rows; ++y) {
+    const uchar* row = image.ptr(y);
+    size_t first = firstKnown(row, cols);
+    if (first == cols) {
+      continue;
+    }
+    x0 = std::min(x0, first);
+    // the part between x0 and x1 does not need to be scanned again
+    x1 = std::max(x1, x1 > first ? x1 + lastKnown(row + x1, cols - x1)
+                                 : lastKnown(row, cols));
+    y0 = std::min(y0, y);
+    y1 = y + 1;
+  }
+  if (y1 <= y0) {
+    return cv::Rect();
+  }
+  return cv::Rect(cv::Point(static_cast<int>(x0), y0),
+                  cv::Point(static_cast<int>(x1), y1));
+}
+
+cv::Rect MergingPipeline::knownRoi(const cv::Mat& image)
+{
+  return knownRoi(image, cv::Rect(cv::Point(), image.size()));
+}
+
+cv::Rect MergingPipeline::knownRoi(const cv::Mat& image,
+                                   const cv::Rect& region)
+{
+  const cv::Rect whole(cv::Point(), image.size());
+  const cv::Rect area = region & whole;
+  if (area.empty()) {
+    return cv::Rect();
+  }
+  cv::Rect roi = knownBox(image(area));
+  if (roi.empty()) {
+    return cv::Rect();
+  }
+  roi.x += area.x - known_roi_margin;
+  roi.y += area.y - known_roi_margin;
+  roi.width += 2 * known_roi_margin;
+  roi.height += 2 * known_roi_margin;
+  return roi & whole;
+}
+
+void MergingPipeline::updateKnownRois(
+    const std::vector<cv::Rect>* changed_regions)
+{
+  static stats::Counter& rows_scanned = stats::counter("rows scanned for known cells");
+  roi_cache_.resize(grids_.size());
+  known_rois_.resize(grids_.size());
+  for (size_t i = 0; i < grids_.size(); ++i) {
+    CachedRoi& cached = roi_cache_[i];
+    const nav_msgs::OccupancyGrid::ConstPtr& grid = grids_[i];
+    const cv::Mat& image = images_[i];
+    if (!grid) {
+      cached = CachedRoi();
+      known_rois_[i] = cv::Rect();
+      continue;
+    }
+
+    // grids are changed in place only together with their stamp, changes of
+    // grids fed with changed regions are described by the regions
+    const bool same_grid = grid == cached.grid && image.size() == cached.size;
+    if (!same_grid ||
+        (!changed_regions && grid->header.stamp != cached.stamp)) {
+      cached.roi = knownRoi(image);
+      rows_scanned.add(static_cast<std::uint64_t>(image.rows));
+    } else if (changed_regions && i < changed_regions->size() &&
+               !(*changed_regions)[i].empty()) {
+      // known cells are rarely forgotten, the box only grows
+      const cv::Rect& region = (*changed_regions)[i];
+      cv::Rect grown = knownRoi(image, region);
+      rows_scanned.add(static_cast<std::uint64_t>(region.height));
+      if (!grown.empty()) {
+        cached.roi = cached.roi.empty() ? grown : (cached.roi | grown);
+      }
+    }
+    cached.grid = grid;
+    cached.stamp = grid->header.stamp;
+    cached.size = image.size();
+    known_rois_[i] = cached.roi;
+  }
+}
+
+// hash of image content, any change of a single 8-byte word changes the hash
+static std::uint64_t hashImage(const cv::Mat& image)
+{
+  constexpr std::uint64_t prime = 1099511628211ULL;
+  std::uint64_t hash = 14695981039346656037ULL;
+  const size_t row_size = static_cast<size_t>(image.cols) * image.elemSize();
+  for (int y = 0; y < image.rows; ++y) {
+    const uchar* row = image.ptr(y);
+    size_t x = 0;
+    for (; x + sizeof(std::uint64_t) <= row_size; x += sizeof(std::uint64_t)) {
+      std::uint64_t word;
+      std::memcpy(&word, row + x, sizeof(word));
+      hash = (hash ^ word) * prime;
+    }
+    for (; x < row_size; ++x) {
+      hash = (hash ^ row[x]) * prime;
+    }
+  }
+  return hash;
+}
+
+// descriptor bits forming visual words of grid signatures
+static constexpr int word_bits = 8;
+
+// signature of a grid is a histogram of visual words of its features. Words
+// are a few bits spread over the descriptor, a locality sensitive hash. Bins
+// are normalized, so that dot product of signatures is the Bhattacharyya
+// coefficient of the histograms.
+static std::vector<float>
+wordHistogram(const cv::detail::ImageFeatures& features)
+{
+  std::vector<float> histogram(1 << word_bits, 0.f);
+  cv::Mat descriptors = features.descriptors.getMat(cv::ACCESS_READ);
+  if (descriptors.empty()) {
+    return histogram;
+  }
+  const bool binary = descriptors.depth() == CV_8U;
+  for (int r = 0; r < descriptors.rows; ++r) {
+    unsigned word = 0;
+    for (int b = 0; b < word_bits; ++b) {
+      int col = b * descriptors.cols / word_bits;
+      bool bit = binary ? (descriptors.at<uchar>(r, col) >> (b % 8)) & 1
+                        : descriptors.at<float>(r, col) > 0.f;
+      word |= unsigned(bit) << b;
+    }
+    histogram[word] += 1.f;
+  }
+  for (auto& bin : histogram) {
+    bin = std::sqrt(bin / descriptors.rows);
+  }
+  return histogram;
+}
+
+static float similarity(const std::vector<float>& a,
+                        const std::vector<float>& b)
+{
+  if (a.size() != b.size()) {
+    return 0.f;
+  }
+  float result = 0.f;
+  for (size_t i = 0; i < a.size(); ++i) {
+    result += a[i] * b[i];
+  }
+  return result;
+}
+
+bool MergingPipeline::updateCacheKey(size_t i)
+{
+  CachedFeatures& cached = features_cache_[i];
+  const nav_msgs::OccupancyGrid::ConstPtr& grid = grids_[i];
+  const cv::Rect& roi = known_rois_[i];
+
+  // grids are changed in place only together with their stamp, the same
+  // message with the same stamp has always the same content
+  if (cached.generation && grid && grid == cached.grid &&
+      grid->header.stamp == cached.stamp) {
+    return false;
+  }
+
+  // new message does not mean new content, maps are often republished
+  // unchanged with a new stamp
+  std::uint64_t hash = roi.empty() ? 0 : hashImage(images_[i](roi));
+  bool changed =
+      !cached.generation || !(cached.roi == roi) || cached.hash != hash;
+  cached.grid = grid;
+  cached.stamp = grid ? grid->header.stamp : ros::Time();
+  cached.roi = roi;
+  cached.hash = hash;
+  return changed;
+}
+
+std::vector<char> MergingPipeline::matchMask() const
+{
+  const size_t num_images = images_.size();
+  std::vector<char> mask(num_images * num_images, 0);
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < num_images; ++i) {
+    if (features_cache_[i].features.keypoints.size() >= min_pair_keypoints) {
+      candidates.push_back(i);
+    }
+  }
+
+  if (matching_neighbours_ == 0 ||
+      candidates.size() <= matching_neighbours_ + 1) {
+    for (size_t i : candidates) {
+      for (size_t j : candidates) {
+        mask[i * num_images + j] = i < j;
+      }
+    }
+    return mask;
+  }
+
+  // the most similar grids of each grid
+  std::vector<std::pair<float, size_t>> neighbours;
+  for (size_t i : candidates) {
+    neighbours.clear();
+    for (size_t j : candidates) {
+      if (j != i) {
+        neighbours.emplace_back(similarity(features_cache_[i].signature,
+                                           features_cache_[j].signature),
+                                j);
+      }
+    }
+    std::partial_sort(neighbours.begin(),
+                      neighbours.begin() +
+                          static_cast<std::ptrdiff_t>(matching_neighbours_),
+                      neighbours.end(),
+                      std::greater<std::pair<float, size_t>>());
+    for (size_t k = 0; k < matching_neighbours_; ++k) {
+      size_t j = neighbours[k].second;
+      mask[std::min(i, j) * num_images + std::max(i, j)] = 1;
+    }
+  }
+
+  // grids overlapping under previous transforms are likely to overlap again
+  if (transforms_.size() == num_images) {
+    internal::GridWarper warper;
+    std::vector<cv::Rect> bounds(num_images);
+    for (size_t i : candidates) {
+      if (!transforms_[i].empty()) {
+        bounds[i] = warper.warpedRoi(images_[i], transforms_[i]);
+      }
+    }
+    for (size_t i : candidates) {
+      for (size_t j : candidates) {
+        if (i < j && !bounds[i].empty() && !bounds[j].empty() &&
+            !(bounds[i] & bounds[j]).empty()) {
+          mask[i * num_images + j] = 1;
+        }
+      }
+    }
+  }
+
+  return mask;
+}
+
 bool MergingPipeline::estimateTransforms(FeatureType feature_type,
                                          double confidence)
 {
+  static stats::Histogram& latency = stats::histogram("estimateTransforms");
+  stats::ScopedTimer timer(latency);
   std::vector<cv::detail::ImageFeatures> image_features;
   std::vector<cv::detail::MatchesInfo> pairwise_matches;
   std::vector<cv::detail::CameraParams> transforms;
   std::vector<int> good_indices;
-  // TODO investigate value translation effect on features
-  auto finder = internal::chooseFeatureFinder(feature_type);
   cv::Ptr<cv::detail::FeaturesMatcher> matcher =
       cv::makePtr<cv::detail::AffineBestOf2NearestMatcher>();
   cv::Ptr<cv::detail::Estimator> estimator =
@@ -66,26 +366,170 @@ bool MergingPipeline::estimateTransforms(FeatureType feature_type,
   if (images_.empty()) {
     return true;
   }
+  ROS_ASSERT(images_.size() == known_rois_.size());
+
+  if (feature_type != cached_feature_type_) {
+    features_cache_.clear();
+    matches_cache_.clear();
+    cached_feature_type_ = feature_type;
+  }
+  features_cache_.resize(images_.size());
+
+  const size_t num_images = images_.size();
+  std::atomic<bool> preempted(false);
+  auto keepGoing = [this, &preempted]() {
+    if (!preempted && preemption_check_ && !preemption_check_()) {
+      preempted = true;
+    }
+    return !preempted;
+  };
 
-  /* find features in images */
+  /* find features in images, reuse features of unchanged images. Each worker
+   * touches only cache entries of its own images. */
   ROS_DEBUG("computing features");
-  image_features.reserve(images_.size());
-  for (const cv::Mat& image : images_) {
-    image_features.emplace_back();
-    if (!image.empty()) {
+  std::vector<char> changed(num_images, 0);
+  workers().parallelFor(num_images, [&](size_t i) {
+    CachedFeatures& cached = features_cache_[i];
+    // preempted images keep their old key and are processed next time
+    if (!keepGoing() || !updateCacheKey(i)) {
+      return;
+    }
+    changed[i] = 1;
+    cached.features = cv::detail::ImageFeatures();
+    const cv::Rect& roi = known_rois_[i];
+    if (roi.empty()) {
+      return;
+    }
+    // finders are not guaranteed to be thread-safe, each image gets its own
+    // TODO investigate value translation effect on features
+    auto finder = internal::chooseFeatureFinder(feature_type);
 #if CV_VERSION_MAJOR >= 4
-      cv::detail::computeImageFeatures(finder, image, image_features.back());
+    cv::detail::computeImageFeatures(finder, images_[i](roi), cached.features);
 #else
-      (*finder)(image, image_features.back());
+    (*finder)(images_[i](roi), cached.features);
 #endif
+    // features are detected in the known area, but transforms are estimated
+    // for whole images
+    cached.features.img_size = images_[i].size();
+    for (auto& keypoint : cached.features.keypoints) {
+      keypoint.pt.x += roi.x;
+      keypoint.pt.y += roi.y;
+    }
+    cached.signature = wordHistogram(cached.features);
+  });
+  size_t computed_features = 0;
+  image_features.reserve(num_images);
+  for (size_t i = 0; i < num_images; ++i) {
+    if (changed[i]) {
+      features_cache_[i].generation = ++next_generation_;
+      computed_features += !known_rois_[i].empty();
     }
+    image_features.push_back(features_cache_[i].features);
+  }
+  ROS_DEBUG("computed features for %zu of %zu grids", computed_features,
+            num_images);
+  if (preempted) {
+    ROS_DEBUG("estimation preempted");
+    return false;
   }
-  finder = {};
 
-  /* find corespondent features */
+  /* find corespondent features. The layout of pairwise_matches and seeding of
+   * RNG is the same as in cv::detail::FeaturesMatcher, but only pairs with
+   * changed features are matched. Pairs where any grid has too few keypoints
+   * to estimate a transform can't overlap and are not matched at all, pairs
+   * outside of the match mask are pruned unless their matches are cached. */
   ROS_DEBUG("pairwise matching features");
-  (*matcher)(image_features, pairwise_matches);
+  struct PairToMatch {
+    size_t i, j;
+    int pair_idx;
+  };
+  std::vector<PairToMatch> pairs_to_match;
+  decltype(matches_cache_) matches_cache;
+  std::vector<char> mask = matchMask();
+  // pairs with matches, either cached or to match
+  std::vector<char> matched_pairs(num_images * num_images, 0);
+  int pair_idx = 0;
+  pairwise_matches.resize(num_images * num_images);
+  for (size_t i = 0; i + 1 < num_images; ++i) {
+    for (size_t j = i + 1; j < num_images; ++j) {
+      if (image_features[i].keypoints.size() < min_pair_keypoints ||
+          image_features[j].keypoints.size() < min_pair_keypoints) {
+        continue;
+      }
+
+      auto key = std::make_pair(features_cache_[i].generation,
+                                features_cache_[j].generation);
+      auto it = matches_cache_.find(key);
+      if (it != matches_cache_.end()) {
+        pairwise_matches[i * num_images + j] = it->second;
+        matched_pairs[i * num_images + j] = 1;
+      } else if (mask[i * num_images + j]) {
+        pairs_to_match.push_back({i, j, pair_idx});
+        matched_pairs[i * num_images + j] = 1;
+      }
+      ++pair_idx;
+    }
+  }
+
+  // matcher is thread-safe, RNG is thread-local
+  const cv::RNG rng = cv::theRNG();
+  std::vector<char> matched(pairs_to_match.size(), 0);
+  workers().parallelFor(pairs_to_match.size(), [&](size_t k) {
+    if (!keepGoing()) {
+      return;
+    }
+    const PairToMatch& pair = pairs_to_match[k];
+    cv::theRNG() = cv::RNG(rng.state + static_cast<uint64>(pair.pair_idx));
+    (*matcher)(image_features[pair.i], image_features[pair.j],
+               pairwise_matches[pair.i * num_images + pair.j]);
+    matched[k] = 1;
+  });
+  cv::theRNG() = rng;
   matcher = {};
+  if (preempted) {
+    // finished matches are reused by the next estimation
+    for (size_t k = 0; k < pairs_to_match.size(); ++k) {
+      const PairToMatch& pair = pairs_to_match[k];
+      if (matched[k]) {
+        matches_cache_.emplace(
+            std::make_pair(features_cache_[pair.i].generation,
+                           features_cache_[pair.j].generation),
+            pairwise_matches[pair.i * num_images + pair.j]);
+      }
+    }
+    ROS_DEBUG("estimation preempted");
+    return false;
+  }
+
+  for (size_t i = 0; i + 1 < num_images; ++i) {
+    for (size_t j = i + 1; j < num_images; ++j) {
+      if (!matched_pairs[i * num_images + j]) {
+        continue;
+      }
+
+      cv::detail::MatchesInfo& info = pairwise_matches[i * num_images + j];
+      info.src_img_idx = static_cast<int>(i);
+      info.dst_img_idx = static_cast<int>(j);
+      matches_cache.emplace(std::make_pair(features_cache_[i].generation,
+                                           features_cache_[j].generation),
+                            info);
+
+      cv::detail::MatchesInfo& dual_info =
+          pairwise_matches[j * num_images + i];
+      dual_info = info;
+      dual_info.src_img_idx = static_cast<int>(j);
+      dual_info.dst_img_idx = static_cast<int>(i);
+      if (!info.H.empty()) {
+        dual_info.H = info.H.inv();
+      }
+      for (auto& match : dual_info.matches) {
+        std::swap(match.queryIdx, match.trainIdx);
+      }
+    }
+  }
+  // keep only matches of current features
+  std::swap(matches_cache_, matches_cache);
+  ROS_DEBUG("matched %zu of %d grid pairs", pairs_to_match.size(), pair_idx);
 
 #ifndef NDEBUG
   internal::writeDebugMatchingInfo(images_, image_features, pairwise_matches);
@@ -155,54 +599,83 @@ static inline bool isIdentity(const cv::Mat& matrix)
 
 nav_msgs::OccupancyGrid::Ptr MergingPipeline::composeGrids()
 {
+  return composeGrids({}, true);
+}
+
+nav_msgs::OccupancyGrid::Ptr
+MergingPipeline::composeGrids(const std::vector<cv::Rect>& changed_regions)
+{
+  return composeGrids(changed_regions, false);
+}
+
+nav_msgs::OccupancyGrid::Ptr
+MergingPipeline::composeGrids(const std::vector<cv::Rect>& changed_regions,
+                              bool full)
+{
+  static stats::Histogram& latency = stats::histogram("composeGrids");
+  static stats::Counter& cells_composed = stats::counter("cells composed");
+  stats::ScopedTimer timer(latency);
   ROS_ASSERT(images_.size() == transforms_.size());
   ROS_ASSERT(images_.size() == grids_.size());
+  ROS_ASSERT(images_.size() == known_rois_.size());
 
   if (images_.empty()) {
+    composed_ = nullptr;
     return nullptr;
   }
 
-  ROS_DEBUG("warping grids");
   internal::GridWarper warper;
-  std::vector<cv::Mat> imgs_warped;
-  imgs_warped.reserve(images_.size());
-  std::vector<cv::Rect> rois;
-  rois.reserve(images_.size());
-
+  std::vector<cv::Rect> bounds(images_.size());
+  bool have_bounds = false;
   for (size_t i = 0; i < images_.size(); ++i) {
     if (!transforms_[i].empty() && !images_[i].empty()) {
-      imgs_warped.emplace_back();
-      rois.emplace_back(
-          warper.warp(images_[i], transforms_[i], imgs_warped.back()));
+      bounds[i] = warper.warpedRoi(images_[i], transforms_[i]);
+      have_bounds = true;
     }
   }
-
-  if (imgs_warped.empty()) {
+  if (!have_bounds) {
+    composed_ = nullptr;
     return nullptr;
   }
 
-  ROS_DEBUG("compositing result grid");
-  nav_msgs::OccupancyGrid::Ptr result;
-  internal::GridCompositor compositor;
-  result = compositor.compose(imgs_warped, rois);
+  // canvas can be updated only when it still has the same layout
+  full = full || !composed_ || bounds != composed_bounds_ ||
+         composed_transforms_.size() != transforms_.size();
+  for (size_t i = 0; !full && i < transforms_.size(); ++i) {
+    full = !transforms_[i].empty() &&
+           cv::countNonZero(transforms_[i] != composed_transforms_[i]) > 0;
+  }
+
+  if (full) {
+    composeAll(bounds);
+  } else {
+    composeChanged(changed_regions);
+  }
+  composed_grids_ = grids_;
+  composed_bounds_ = std::move(bounds);
+  composed_transforms_.clear();
+  for (auto& transform : transforms_) {
+    composed_transforms_.push_back(transform.clone());
+  }
+  cells_composed.add(static_cast<std::uint64_t>(changed_region_.area()));
 
   // set correct resolution to output grid. use resolution of identity (works
   // for estimated trasforms), or any resolution (works for know_init_positions)
   // - in that case all resolutions should be the same.
+  nav_msgs::OccupancyGrid::Ptr result = composed_;
+  float resolution = 0.0;
   float any_resolution = 0.0;
   for (size_t i = 0; i < transforms_.size(); ++i) {
     // check if this transform is the reference frame
     if (isIdentity(transforms_[i])) {
-      result->info.resolution = grids_[i]->info.resolution;
+      resolution = grids_[i]->info.resolution;
       break;
     }
     if (grids_[i]) {
       any_resolution = grids_[i]->info.resolution;
     }
   }
-  if (result->info.resolution <= 0.f) {
-    result->info.resolution = any_resolution;
-  }
+  result->info.resolution = resolution > 0.f ? resolution : any_resolution;
 
   // set grid origin to its centre
   result->info.origin.position.x =
@@ -214,6 +687,326 @@ nav_msgs::OccupancyGrid::Ptr MergingPipeline::composeGrids()
   return result;
 }
 
+// transform of the part of image starting at offset. Transforms map merged
+// coordinates to the image, cell p of the part is cell p + offset of the image.
+static cv::Mat offsetTransform(const cv::Mat& transform, const cv::Point& offset)
+{
+  cv::Mat result = transform.clone();
+  result.at<double>(0, 2) -= offset.x;
+  result.at<double>(1, 2) -= offset.y;
+  return result;
+}
+
+std::vector<cv::Rect> MergingPipeline::knownBounds()
+{
+  internal::GridWarper warper;
+  std::vector<cv::Rect> result(images_.size());
+  for (size_t i = 0; i < images_.size(); ++i) {
+    const cv::Rect& roi = known_rois_[i];
+    if (!transforms_[i].empty() && !roi.empty()) {
+      result[i] = warper.warpedRoi(images_[i](roi),
+                                   offsetTransform(transforms_[i], roi.tl()));
+    }
+  }
+  return result;
+}
+
+void MergingPipeline::composeAll(const std::vector<cv::Rect>& bounds)
+{
+  /* only known areas are warped, but the result covers whole grids (unknown
+   * outside of the known areas) */
+  composed_roi_ = cv::Rect();
+  for (auto& roi : bounds) {
+    if (roi.empty()) {
+      continue;
+    }
+    composed_roi_ = composed_roi_.empty() ? roi : (composed_roi_ | roi);
+  }
+  changed_region_ = cv::Rect(cv::Point(), composed_roi_.size());
+
+  ROS_DEBUG("warping and compositing grids");
+  // last result must not change while it is held, compose into the other one
+  if (composed_ && !composed_.unique()) {
+    std::swap(composed_, spare_);
+  }
+  if (!composed_ || !composed_.unique()) {
+    composed_.reset(new nav_msgs::OccupancyGrid());
+  }
+  spare_stale_ = changed_region_;
+  // memory of the buffer is reused, whole canvas is recomposed
+  composed_->info.width = static_cast<uint>(composed_roi_.width);
+  composed_->info.height = static_cast<uint>(composed_roi_.height);
+  composed_->data.resize(static_cast<size_t>(composed_roi_.area()));
+  cv::Mat canvas(composed_roi_.size(), CV_8S, composed_->data.data());
+  compositor().warpRecompose(images_, transforms_, knownBounds(),
+                             composed_roi_, composed_roi_.tl(), canvas);
+}
+
+void MergingPipeline::composeChanged(
+    const std::vector<cv::Rect>& changed_regions)
+{
+  /* map changed regions of grids to the canvas. Grids fed as a different
+   * message than at the last composition changed completely. */
+  internal::GridWarper warper;
+  std::vector<cv::Rect> dirty;
+  for (size_t i = 0; i < images_.size(); ++i) {
+    if (composed_bounds_[i].empty()) {
+      continue;
+    }
+    cv::Rect region(cv::Point(), images_[i].size());
+    if (grids_[i] == composed_grids_[i]) {
+      region = i < changed_regions.size() ? changed_regions[i] & region
+                                          : cv::Rect();
+    }
+    if (region.empty()) {
+      continue;
+    }
+    cv::Rect warped = warper.warpedRoi(
+        images_[i](region), offsetTransform(transforms_[i], region.tl()));
+    // nearest neighbour may pick changed cells also just outside of the warped
+    // region
+    warped.x -= 1;
+    warped.y -= 1;
+    warped.width += 2;
+    warped.height += 2;
+    warped &= composed_roi_;
+    if (!warped.empty()) {
+      dirty.push_back(warped);
+    }
+  }
+  ROS_DEBUG("recompositing %zu changed regions", dirty.size());
+
+  changed_region_ = cv::Rect();
+  for (const cv::Rect& region : dirty) {
+    cv::Rect changed = region - composed_roi_.tl();
+    changed_region_ = changed_region_.empty() ? changed
+                                              : (changed_region_ | changed);
+  }
+  if (composed_.unique()) {
+    // composed in place, the spare grid misses also these changes
+    if (!changed_region_.empty()) {
+      spare_stale_ = spare_stale_.empty() ? changed_region_
+                                          : (spare_stale_ | changed_region_);
+    }
+  } else {
+    /* last result is still held by somebody, it must not change while in
+     * use. The spare grid is brought up to date and composed into instead. */
+    std::swap(composed_, spare_);
+    if (composed_ && composed_.unique() &&
+        composed_->info.width == spare_->info.width &&
+        composed_->info.height == spare_->info.height) {
+      if (!spare_stale_.empty()) {
+        cv::Mat from(composed_roi_.size(), CV_8S, spare_->data.data());
+        cv::Mat to(composed_roi_.size(), CV_8S, composed_->data.data());
+        from(spare_stale_).copyTo(to(spare_stale_));
+      }
+      composed_->info = spare_->info;
+    } else {
+      composed_.reset(new nav_msgs::OccupancyGrid(*spare_));
+    }
+    spare_stale_ = changed_region_;
+  }
+
+  std::vector<cv::Rect> rois = knownBounds();
+  cv::Mat canvas(composed_roi_.size(), CV_8S, composed_->data.data());
+  // regions may overlap, each one is recomposed completely
+  for (const cv::Rect& region : dirty) {
+    compositor().warpRecompose(images_, transforms_, rois, region,
+                               composed_roi_.tl(), canvas);
+  }
+}
+
+explore_common::WorkerPool& MergingPipeline::workers()
+{
+  if (!pool_) {
+    pool_.reset(
+        new explore_common::WorkerPool(static_cast<unsigned int>(workers_)));
+  }
+  return *pool_;
+}
+
+internal::GridCompositor& MergingPipeline::compositor()
+{
+  if (!compositor_) {
+    compositor_.reset(new internal::GridCompositor(workers()));
+  }
+  return *compositor_;
+}
+
+// longer side of windows aligned by refinement, windows are downsampled to
+// fit
+static constexpr int refinement_window = 256;
+
+// ECC input from grid: known cells are occupancy probabilities, unknown cells
+// are 0 and out of the mask. Image is downsampled by scale.
+static void eccImage(const cv::Mat& grid, int scale, cv::Mat& image,
+                     cv::Mat* mask = nullptr)
+{
+  cv::Mat full;
+  grid.convertTo(full, CV_32F, 1.0 / 100.0);
+  cv::Mat unknown = grid == unknown_cell;
+  full.setTo(cv::Scalar::all(0), unknown);
+  cv::Size size(std::max(1, grid.cols / scale), std::max(1, grid.rows / scale));
+  cv::resize(full, image, size, 0, 0, cv::INTER_AREA);
+  if (mask) {
+    cv::resize(unknown, *mask, size, 0, 0, cv::INTER_NEAREST);
+    *mask = *mask == 0;
+  }
+}
+
+double MergingPipeline::refineTransform(size_t i,
+                                        std::vector<cv::Mat>& transforms) const
+{
+  internal::GridWarper warper;
+  auto knownBounds = [&](size_t j) {
+    const cv::Rect& roi = known_rois_[j];
+    if (transforms[j].empty() || roi.empty()) {
+      return cv::Rect();
+    }
+    return warper.warpedRoi(images_[j](roi),
+                            offsetTransform(transforms[j], roi.tl()));
+  };
+
+  // grid is aligned to the other grids where they overlap
+  const cv::Rect bounds = knownBounds(i);
+  cv::Rect others;
+  for (size_t j = 0; j < images_.size(); ++j) {
+    cv::Rect other = j == i ? cv::Rect() : knownBounds(j);
+    if (others.empty()) {
+      others = other;
+    } else if (!other.empty()) {
+      others |= other;
+    }
+  }
+  const cv::Rect window = bounds & others;
+  if (bounds.empty() || window.empty()) {
+    return 0.;
+  }
+  cv::Mat composed(window.size(), CV_8S, cv::Scalar::all(-1));
+  for (size_t j = 0; j < images_.size(); ++j) {
+    cv::Rect roi = j == i ? cv::Rect() : knownBounds(j) & window;
+    if (roi.empty()) {
+      continue;
+    }
+    cv::Mat composed_roi = composed(roi - window.tl());
+    warper.warpMax(images_[j], transforms[j], roi, composed_roi);
+  }
+
+  // part of the grid mapped to the window, with margin for the motion
+  const int scale =
+      std::max(1, std::max(window.width, window.height) / refinement_window);
+  const int margin = std::max(window.width, window.height) / 4;
+  std::vector<cv::Point2f> corners{
+      cv::Point2f(window.x, window.y), cv::Point2f(window.br().x, window.y),
+      cv::Point2f(window.x, window.br().y),
+      cv::Point2f(window.br().x, window.br().y)};
+  cv::perspectiveTransform(corners, corners, transforms[i]);
+  cv::Rect source = cv::boundingRect(corners);
+  source.x -= margin;
+  source.y -= margin;
+  source.width += 2 * margin;
+  source.height += 2 * margin;
+  source &= cv::Rect(cv::Point(), images_[i].size());
+  if (source.empty()) {
+    return 0.;
+  }
+
+  cv::Mat template_image, template_mask, input_image;
+  cv::Mat composed_unsigned(composed.size(), CV_8UC1, composed.ptr());
+  eccImage(composed_unsigned, scale, template_image, &template_mask);
+  eccImage(images_[i](source), scale, input_image);
+
+  // warp between downsampled windows: cell u of template is at
+  // window.tl + scale * u + c in the merged grid, the same for input
+  const double c = (scale - 1) / 2.;
+  auto shift = [](double x, double y) {
+    cv::Mat result = cv::Mat::eye(3, 3, CV_64F);
+    result.at<double>(0, 2) = x;
+    result.at<double>(1, 2) = y;
+    return result;
+  };
+  cv::Mat down = cv::Mat::eye(3, 3, CV_64F);
+  down.at<double>(0, 0) = down.at<double>(1, 1) = 1. / scale;
+  cv::Mat up = down.inv();
+  cv::Mat warp = down * shift(-source.x - c, -source.y - c) * transforms[i] *
+                 shift(window.x + c, window.y + c) * up;
+  cv::Mat ecc_warp;
+  warp.rowRange(0, 2).convertTo(ecc_warp, CV_32F);
+
+  double correlation = 0.;
+  try {
+    correlation = cv::findTransformECC(
+        template_image, input_image, ecc_warp, cv::MOTION_EUCLIDEAN,
+        cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 50,
+                         1e-4),
+        template_mask);
+  } catch (const cv::Exception& e) {
+    // images are uncorrelated
+    ROS_DEBUG("refinement of grid %zu failed: %s", i, e.what());
+    return 0.;
+  }
+
+  cv::Mat refined_warp = cv::Mat::eye(3, 3, CV_64F);
+  cv::Mat refined_rows = refined_warp.rowRange(0, 2);
+  ecc_warp.convertTo(refined_rows, CV_64F);
+  cv::Mat refined = shift(source.x + c, source.y + c) * up * refined_warp *
+                    down * shift(-window.x - c, -window.y - c);
+  // refinement is local, larger motion means it went astray
+  double dx = refined.at<double>(0, 2) - transforms[i].at<double>(0, 2);
+  double dy = refined.at<double>(1, 2) - transforms[i].at<double>(1, 2);
+  if (std::hypot(dx, dy) > margin) {
+    return 0.;
+  }
+  transforms[i] = refined;
+
+  if (correlation >= 1.) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::max(correlation, 0.) / (1. - correlation);
+}
+
+bool MergingPipeline::refineTransforms(double confidence)
+{
+  static stats::Histogram& latency = stats::histogram("refineTransforms");
+  stats::ScopedTimer timer(latency);
+  const size_t num_images = images_.size();
+  if (num_images == 0 || transforms_.size() != num_images) {
+    return false;
+  }
+  // all grids must be placed already, reference grid stays as it is
+  size_t reference = num_images;
+  for (size_t i = 0; i < num_images; ++i) {
+    if (!images_[i].empty() && transforms_[i].empty()) {
+      return false;
+    }
+    if (reference == num_images && isIdentity(transforms_[i])) {
+      reference = i;
+    }
+  }
+  if (reference == num_images) {
+    return false;
+  }
+
+  std::vector<cv::Mat> refined;
+  for (auto& transform : transforms_) {
+    refined.push_back(transform.clone());
+  }
+  for (size_t i = 0; i < num_images; ++i) {
+    if (i == reference || refined[i].empty() || known_rois_[i].empty()) {
+      continue;
+    }
+    double grid_confidence = refineTransform(i, refined);
+    ROS_DEBUG("refined transform of grid %zu, confidence %f", i,
+              grid_confidence);
+    if (grid_confidence < confidence) {
+      return false;
+    }
+  }
+
+  std::swap(transforms_, refined);
+  return true;
+}
+
 std::vector<geometry_msgs::Transform> MergingPipeline::getTransforms() const
 {
   std::vector<geometry_msgs::Transform> result;
@@ -0,0 +1,135 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+/*
+ * Relays map of a robot encoded by grid_codec. Runs next to the mapping node,
+ * so that only the compact encoding is sent to map_merge.
+ */
+
+#include <algorithm>
+
+#include <explore_common/grid_codec.h>
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <ros/ros.h>
+
+namespace map_merge
+{
+namespace grid_codec = explore_common::grid_codec;
+
+class MapCompressor
+{
+public:
+  MapCompressor()
+  {
+    ros::NodeHandle private_nh("~");
+    int tile_rows;
+    private_nh.param("occupied_threshold", occupied_threshold_, 65);
+    private_nh.param("tile_rows", tile_rows,
+                     static_cast<int>(grid_codec::default_tile_rows));
+    tile_rows_ = static_cast<unsigned int>(std::max(tile_rows, 1));
+
+    map_publisher_ =
+        node_.advertise<nav_msgs::OccupancyGrid>("map_compressed", 50, true);
+    map_updates_publisher_ = node_.advertise<map_msgs::OccupancyGridUpdate>(
+        "map_updates_compressed", 50);
+    map_sub_ = node_.subscribe<nav_msgs::OccupancyGrid>(
+        "map", 50,
+        [this](const nav_msgs::OccupancyGrid::ConstPtr& msg) { fullMap(msg); });
+    map_updates_sub_ = node_.subscribe<map_msgs::OccupancyGridUpdate>(
+        "map_updates", 50,
+        [this](const map_msgs::OccupancyGridUpdate::ConstPtr& msg) {
+          partialMap(msg);
+        });
+  }
+
+private:
+  void fullMap(const nav_msgs::OccupancyGrid::ConstPtr& msg)
+  {
+    if (msg->data.size() != size_t(msg->info.width) * msg->info.height) {
+      ROS_ERROR("map data size %zu doesn't match map size %ux%u, skipping.",
+                msg->data.size(), msg->info.width, msg->info.height);
+      return;
+    }
+    nav_msgs::OccupancyGrid::Ptr compressed(new nav_msgs::OccupancyGrid);
+    compressed->header = msg->header;
+    compressed->info = msg->info;
+    grid_codec::encode(msg->data.data(), msg->info.width, msg->info.width,
+                       msg->info.height, compressed->data, occupied_threshold_,
+                       tile_rows_);
+    ROS_DEBUG("map encoded from %zu to %zu bytes", msg->data.size(),
+              compressed->data.size());
+    map_publisher_.publish(compressed);
+  }
+
+  void partialMap(const map_msgs::OccupancyGridUpdate::ConstPtr& msg)
+  {
+    if (msg->data.size() != size_t(msg->width) * msg->height) {
+      ROS_ERROR("update data size %zu doesn't match update size %ux%u, "
+                "skipping.",
+                msg->data.size(), msg->width, msg->height);
+      return;
+    }
+    map_msgs::OccupancyGridUpdate::Ptr compressed(
+        new map_msgs::OccupancyGridUpdate);
+    compressed->header = msg->header;
+    compressed->x = msg->x;
+    compressed->y = msg->y;
+    compressed->width = msg->width;
+    compressed->height = msg->height;
+    grid_codec::encode(msg->data.data(), msg->width, msg->width, msg->height,
+                       compressed->data, occupied_threshold_, tile_rows_);
+    map_updates_publisher_.publish(compressed);
+  }
+
+  ros::NodeHandle node_;
+  int occupied_threshold_;
+  unsigned int tile_rows_;
+  ros::Publisher map_publisher_;
+  ros::Publisher map_updates_publisher_;
+  ros::Subscriber map_sub_;
+  ros::Subscriber map_updates_sub_;
+};
+
+}  // namespace map_merge
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "map_compressor");
+  map_merge::MapCompressor compressor;
+  ros::spin();
+  return 0;
+}
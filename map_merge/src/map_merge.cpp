@@ -35,8 +35,18 @@
  *
  *********************************************************************/
 
+#include <algorithm>
 #include <thread>
 
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <explore_common/grid_codec.h>
+#include <explore_common/stats.h>
 #include <map_merge/map_merge.h>
 #include <ros/assert.h>
 #include <ros/console.h>
@@ -44,27 +54,100 @@
 
 namespace map_merge
 {
-MapMerge::MapMerge() : subscriptions_size_(0)
+namespace grid_codec = explore_common::grid_codec;
+namespace stats = explore_common::stats;
+
+MapMerge::MapMerge()
+  : full_map_published_(false)
+  , full_map_requested_(false)
+  , subscriptions_size_(0)
+  , merge_pending_(false)
+  , estimation_pending_(false)
+  , composing_(false)
+  , shutting_down_(false)
 {
   ros::NodeHandle private_nh("~");
   std::string frame_id;
   std::string merged_map_topic;
+  std::string merged_map_updates_topic;
 
   private_nh.param("merging_rate", merging_rate_, 4.0);
+  private_nh.param("merging_min_latency", merging_min_latency_, 0.1);
+  private_nh.param("merging_max_latency", merging_max_latency_, 1.0);
   private_nh.param("discovery_rate", discovery_rate_, 0.05);
   private_nh.param("estimation_rate", estimation_rate_, 0.5);
   private_nh.param("known_init_poses", have_initial_poses_, true);
   private_nh.param("estimation_confidence", confidence_threshold_, 1.0);
+  private_nh.param("estimation_tracking", estimation_tracking_, false);
+  int estimation_threads;
+  private_nh.param("estimation_threads", estimation_threads, 0);
+  int estimation_neighbours;
+  private_nh.param("estimation_neighbours", estimation_neighbours, 0);
   private_nh.param<std::string>("robot_map_topic", robot_map_topic_, "map");
   private_nh.param<std::string>("robot_map_updates_topic",
                                 robot_map_updates_topic_, "map_updates");
   private_nh.param<std::string>("robot_namespace", robot_namespace_, "");
+  private_nh.param("compressed_maps", compressed_maps_, false);
   private_nh.param<std::string>("merged_map_topic", merged_map_topic, "map");
+  private_nh.param("publish_map_updates", publish_map_updates_, false);
+  private_nh.param<std::string>("merged_map_updates_topic",
+                                merged_map_updates_topic, "map_updates");
+  private_nh.param("publish_compressed", publish_compressed_, false);
   private_nh.param<std::string>("world_frame", world_frame_, "world");
+  private_nh.param("spinner_threads", spinner_threads_, 0);
+  double stats_rate;
+  private_nh.param("stats_rate", stats_rate, 0.0);
+
+  pipeline_.setWorkerCount(
+      static_cast<size_t>(std::max(estimation_threads, 0)));
+  estimation_pipeline_.setWorkerCount(
+      static_cast<size_t>(std::max(estimation_threads, 0)));
+  estimation_pipeline_.setMatchingNeighbours(
+      static_cast<size_t>(std::max(estimation_neighbours, 0)));
+  estimation_pipeline_.setPreemptionCheck(
+      [this]() { return estimationMayContinue(); });
+
+  // statistics are collected only when they are published
+  if (stats_rate > 0.) {
+    stats::setEnabled(true);
+    stats_publisher_ =
+        node_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    stats_timer_ = node_.createTimer(
+        ros::Duration(1. / stats_rate),
+        [this](const ros::TimerEvent&) { publishStats(); });
+  }
 
   /* publishing */
-  merged_map_publisher_ =
-      node_.advertise<nav_msgs::OccupancyGrid>(merged_map_topic, 50, true);
+  const std::string compressed_map_topic = merged_map_topic + "_compressed";
+  if (!publish_map_updates_) {
+    merged_map_publisher_ =
+        node_.advertise<nav_msgs::OccupancyGrid>(merged_map_topic, 50, true);
+    if (publish_compressed_) {
+      compressed_map_publisher_ = node_.advertise<nav_msgs::OccupancyGrid>(
+          compressed_map_topic, 50, true);
+    }
+    return;
+  }
+  // latched full map is outdated when updates were published after it, new
+  // subscribers get a fresh one
+  auto request_full_map = [this](const ros::SingleSubscriberPublisher&) {
+    full_map_requested_ = true;
+    // maps may not change for a long time, publish the full map now
+    requestMerge();
+  };
+  merged_map_publisher_ = node_.advertise<nav_msgs::OccupancyGrid>(
+      merged_map_topic, 50, request_full_map, ros::SubscriberStatusCallback(),
+      ros::VoidConstPtr(), true);
+  merged_map_updates_publisher_ = node_.advertise<map_msgs::OccupancyGridUpdate>(
+      merged_map_updates_topic, 50);
+  if (publish_compressed_) {
+    compressed_map_publisher_ = node_.advertise<nav_msgs::OccupancyGrid>(
+        compressed_map_topic, 50, request_full_map,
+        ros::SubscriberStatusCallback(), ros::VoidConstPtr(), true);
+    compressed_map_updates_publisher_ =
+        node_.advertise<map_msgs::OccupancyGridUpdate>(
+            merged_map_updates_topic + "_compressed", 50);
+  }
 }
 
 /*
@@ -140,68 +223,227 @@ void MapMerge::topicSubscribing()
   }
 }
 
+/*
+ * takeGrids()
+ */
+std::vector<nav_msgs::OccupancyGridConstPtr>
+MapMerge::takeGrids(std::vector<cv::Rect>& changed_regions,
+                    std::vector<geometry_msgs::Transform>* transforms)
+{
+  std::vector<nav_msgs::OccupancyGridConstPtr> grids;
+  grids.reserve(subscriptions_size_);
+  changed_regions.clear();
+  changed_regions.reserve(subscriptions_size_);
+  boost::shared_lock<boost::shared_mutex> lock(subscriptions_mutex_);
+  for (auto& subscription : subscriptions_) {
+    TiledGrid snapshot;
+    {
+      std::lock_guard<std::mutex> s_lock(subscription.mutex);
+      snapshot = subscription.map;
+      changed_regions.push_back(subscription.dirty_region);
+      subscription.dirty_region = cv::Rect();
+      if (transforms) {
+        transforms->push_back(subscription.initial_pose);
+      }
+    }
+    // snapshot is immutable, subscription can be updated meanwhile
+    grids.push_back(subscription.assembler.update(snapshot));
+  }
+  return grids;
+}
+
 /*
  * mapMerging()
  */
 void MapMerge::mapMerging()
 {
+  static stats::Histogram& latency = stats::histogram("mapMerging");
+  stats::ScopedTimer timer(latency);
   ROS_DEBUG("Map merging started.");
 
+  // without known initial poses grids are fed by poseEstimation
+  std::vector<cv::Rect> changed_regions;
   if (have_initial_poses_) {
-    std::vector<nav_msgs::OccupancyGridConstPtr> grids;
     std::vector<geometry_msgs::Transform> transforms;
-    grids.reserve(subscriptions_size_);
-    {
-      boost::shared_lock<boost::shared_mutex> lock(subscriptions_mutex_);
-      for (auto& subscription : subscriptions_) {
-        std::lock_guard<std::mutex> s_lock(subscription.mutex);
-        grids.push_back(subscription.readonly_map);
-        transforms.push_back(subscription.initial_pose);
-      }
-    }
+    transforms.reserve(subscriptions_size_);
+    auto grids = takeGrids(changed_regions, &transforms);
     // we don't need to lock here, because when have_initial_poses_ is true we
     // will not run concurrently on the pipeline
-    pipeline_.feed(grids.begin(), grids.end());
+    pipeline_.feed(grids.begin(), grids.end(), changed_regions);
     pipeline_.setTransforms(transforms.begin(), transforms.end());
   }
 
   nav_msgs::OccupancyGridPtr merged_map;
+  cv::Rect changed_region;
   {
     std::lock_guard<std::mutex> lock(pipeline_mutex_);
-    merged_map = pipeline_.composeGrids();
+    if (!have_initial_poses_) {
+      std::swap(changed_regions, changed_regions_);
+      changed_regions_.clear();
+    }
+    merged_map = pipeline_.composeGrids(changed_regions);
+    changed_region = pipeline_.changedRegion();
   }
   if (!merged_map) {
     return;
   }
 
   ROS_DEBUG("all maps merged, publishing");
+  ROS_ASSERT(merged_map->info.resolution > 0.f);
+  publishMergedMap(merged_map, changed_region);
+}
+
+static bool sameLayout(const nav_msgs::MapMetaData& a,
+                       const nav_msgs::MapMetaData& b)
+{
+  return a.width == b.width && a.height == b.height &&
+         a.resolution == b.resolution &&
+         a.origin.position.x == b.origin.position.x &&
+         a.origin.position.y == b.origin.position.y;
+}
+
+/*
+ * Publishes full merged map or only its changed region as an update
+ */
+void MapMerge::publishMergedMap(const nav_msgs::OccupancyGrid::Ptr& merged_map,
+                                const cv::Rect& changed_region)
+{
+  // the full map must be published first and again whenever its layout
+  // changes, updates can't describe that
+  bool full = !publish_map_updates_ || !full_map_published_ ||
+              !sameLayout(published_info_, merged_map->info) ||
+              full_map_requested_.exchange(false);
+  if (full) {
+    publishFullMap(merged_map);
+  } else if (!changed_region.empty()) {
+    publishMapUpdate(*merged_map, changed_region);
+  }
+}
+
+/*
+ * Hands merged map over to the (latched) publisher. Pipeline never composes
+ * into a map held by the publisher, so its header can be stamped here.
+ */
+void MapMerge::publishFullMap(const nav_msgs::OccupancyGrid::Ptr& merged_map)
+{
+  static stats::Counter& published_bytes = stats::counter("published bytes");
   ros::Time now = ros::Time::now();
   merged_map->info.map_load_time = now;
   merged_map->header.stamp = now;
   merged_map->header.frame_id = world_frame_;
-
-  ROS_ASSERT(merged_map->info.resolution > 0.f);
   merged_map_publisher_.publish(merged_map);
+  published_bytes.add(merged_map->data.size());
+  published_info_ = merged_map->info;
+  full_map_published_ = true;
+  if (publish_compressed_) {
+    nav_msgs::OccupancyGrid::Ptr compressed(new nav_msgs::OccupancyGrid);
+    compressed->header = merged_map->header;
+    compressed->info = merged_map->info;
+    grid_codec::encode(merged_map->data.data(), merged_map->info.width,
+                       merged_map->info.width, merged_map->info.height,
+                       compressed->data);
+    compressed_map_publisher_.publish(compressed);
+    published_bytes.add(compressed->data.size());
+  }
+}
+
+/*
+ * Publishes changed region of merged map, merged map is only read
+ */
+void MapMerge::publishMapUpdate(const nav_msgs::OccupancyGrid& merged_map,
+                                const cv::Rect& changed_region)
+{
+  static stats::Counter& published_bytes = stats::counter("published bytes");
+  map_msgs::OccupancyGridUpdate::Ptr update(new map_msgs::OccupancyGridUpdate);
+  update->header.stamp = ros::Time::now();
+  update->header.frame_id = world_frame_;
+  update->x = changed_region.x;
+  update->y = changed_region.y;
+  update->width = static_cast<uint32_t>(changed_region.width);
+  update->height = static_cast<uint32_t>(changed_region.height);
+  update->data.resize(static_cast<size_t>(changed_region.area()));
+  const size_t map_width = merged_map.info.width;
+  const size_t width = update->width;
+  for (size_t y = 0; y < update->height; ++y) {
+    const int8_t* row = merged_map.data.data() +
+                        (size_t(update->y) + y) * map_width + size_t(update->x);
+    std::copy(row, row + width, update->data.data() + y * width);
+  }
+  merged_map_updates_publisher_.publish(update);
+  published_bytes.add(update->data.size());
+  if (publish_compressed_) {
+    map_msgs::OccupancyGridUpdate::Ptr compressed(
+        new map_msgs::OccupancyGridUpdate(*update));
+    grid_codec::encode(update->data.data(), width, update->width,
+                       update->height, compressed->data);
+    compressed_map_updates_publisher_.publish(compressed);
+    published_bytes.add(compressed->data.size());
+  }
+}
+
+void MapMerge::publishStats()
+{
+  diagnostic_msgs::DiagnosticArray::Ptr msg(
+      new diagnostic_msgs::DiagnosticArray());
+  msg->header.stamp = ros::Time::now();
+  msg->status.push_back(stats::Registry::instance().toDiagnosticStatus());
+  msg->status.back().name = ros::this_node::getName() + ": statistics";
+  msg->status.back().message = "hot path latencies and counters";
+  stats_publisher_.publish(msg);
 }
 
 void MapMerge::poseEstimation()
 {
+  static stats::Histogram& latency = stats::histogram("poseEstimation");
+  stats::ScopedTimer timer(latency);
   ROS_DEBUG("Grid pose estimation started.");
+  std::vector<cv::Rect> changed_regions;
   std::vector<nav_msgs::OccupancyGridConstPtr> grids;
-  grids.reserve(subscriptions_size_);
   {
-    boost::shared_lock<boost::shared_mutex> lock(subscriptions_mutex_);
-    for (auto& subscription : subscriptions_) {
-      std::lock_guard<std::mutex> s_lock(subscription.mutex);
-      grids.push_back(subscription.readonly_map);
+    // grids are assembled under the lock, because they may be composed by
+    // mapMerging at the same time
+    std::lock_guard<std::mutex> lock(pipeline_mutex_);
+    grids = takeGrids(changed_regions);
+    // regions stay changed until mapMerging composes them
+    changed_regions_.resize(std::max(changed_regions_.size(), grids.size()));
+    for (size_t i = 0; i < changed_regions.size(); ++i) {
+      if (changed_regions_[i].empty()) {
+        changed_regions_[i] = changed_regions[i];
+      } else if (!changed_regions[i].empty()) {
+        changed_regions_[i] |= changed_regions[i];
+      }
     }
   }
 
-  std::lock_guard<std::mutex> lock(pipeline_mutex_);
-  pipeline_.feed(grids.begin(), grids.end());
-  // TODO allow user to change feature type
-  pipeline_.estimateTransforms(combine_grids::FeatureType::AKAZE,
-                               confidence_threshold_);
+  // grids are changed only by this thread, estimation can run without the lock
+  estimation_pipeline_.feed(grids.begin(), grids.end(), changed_regions);
+  // in tracking mode previous transforms are only refined, global estimation
+  // runs when refinement fails
+  bool estimated = estimation_tracking_ &&
+                   estimation_pipeline_.refineTransforms(confidence_threshold_);
+  if (estimated) {
+    ROS_DEBUG("Grid transforms refined by tracking.");
+  } else {
+    // TODO allow user to change feature type
+    estimated = estimation_pipeline_.estimateTransforms(
+        combine_grids::FeatureType::AKAZE, confidence_threshold_);
+  }
+  if (!estimated && !estimationMayContinue()) {
+    // shutting down
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(pipeline_mutex_);
+    // keep previous transforms when estimation fails
+    auto transforms = estimated ? estimation_pipeline_.getTransforms()
+                                : pipeline_.getTransforms();
+    transforms.resize(grids.size());
+    // both pipelines were fed last time by the previous estimation
+    pipeline_.feed(grids.begin(), grids.end(), changed_regions);
+    pipeline_.setTransforms(transforms.begin(), transforms.end());
+  }
+  requestMerge();
 }
 
 void MapMerge::fullMapUpdate(const nav_msgs::OccupancyGrid::ConstPtr& msg,
@@ -209,14 +451,21 @@ void MapMerge::fullMapUpdate(const nav_msgs::OccupancyGrid::ConstPtr& msg,
 {
   ROS_DEBUG("received full map update");
   std::lock_guard<std::mutex> lock(subscription.mutex);
-  if (subscription.readonly_map &&
-      subscription.readonly_map->header.stamp > msg->header.stamp) {
+  if (!subscription.map.empty() &&
+      subscription.map.header().stamp > msg->header.stamp) {
     // we have been overrunned by faster update. our work was useless.
     return;
   }
 
-  subscription.readonly_map = msg;
-  subscription.writable_map = nullptr;
+  if (!compressed_maps_) {
+    subscription.map.reset(msg);
+  } else if (!subscription.map.resetEncoded(*msg)) {
+    return;
+  }
+  subscription.dirty_region =
+      cv::Rect(0, 0, static_cast<int>(msg->info.width),
+               static_cast<int>(msg->info.height));
+  mapChanged();
 }
 
 void MapMerge::partialMapUpdate(
@@ -236,30 +485,20 @@ void MapMerge::partialMapUpdate(
   size_t xn = msg->width + x0;
   size_t yn = msg->height + y0;
 
-  nav_msgs::OccupancyGridPtr map;
-  nav_msgs::OccupancyGridConstPtr readonly_map;  // local copy
-  {
-    // load maps
-    std::lock_guard<std::mutex> lock(subscription.mutex);
-    map = subscription.writable_map;
-    readonly_map = subscription.readonly_map;
-  }
-
-  if (!readonly_map) {
+  // update copies only touched parts of the map, we can do it under the lock
+  std::lock_guard<std::mutex> lock(subscription.mutex);
+  if (subscription.map.empty()) {
     ROS_WARN("received partial map update, but don't have any full map to "
              "update. skipping.");
     return;
   }
-
-  // we don't have partial map to take update, we must copy readonly map and
-  // update new writable map
-  if (!map) {
-    map.reset(new nav_msgs::OccupancyGrid(*readonly_map));
+  if (subscription.map.header().stamp > msg->header.stamp) {
+    // we have been overrunned by faster update. our work was useless.
+    return;
   }
 
-  size_t grid_xn = map->info.width;
-  size_t grid_yn = map->info.height;
-
+  size_t grid_xn = subscription.map.info().width;
+  size_t grid_yn = subscription.map.info().height;
   if (xn > grid_xn || x0 > grid_xn || yn > grid_yn || y0 > grid_yn) {
     ROS_WARN("received update doesn't fully fit into existing map, "
              "only part will be copied. received: [%lu, %lu], [%lu, %lu] "
@@ -267,29 +506,21 @@ void MapMerge::partialMapUpdate(
              x0, xn, y0, yn, grid_xn, grid_yn);
   }
 
-  // update map with data
-  size_t i = 0;
-  for (size_t y = y0; y < yn && y < grid_yn; ++y) {
-    for (size_t x = x0; x < xn && x < grid_xn; ++x) {
-      size_t idx = y * grid_xn + x;  // index to grid for this specified cell
-      map->data[idx] = msg->data[i];
-      ++i;
+  cv::Rect updated = compressed_maps_ ? subscription.map.updateEncoded(*msg)
+                                     : subscription.map.update(*msg);
+  if (updated.empty()) {
+    if (compressed_maps_) {
+      ROS_WARN("encoded map update is malformed or doesn't fit into existing "
+               "map, skipping.");
     }
+    return;
   }
-  // update time stamp
-  map->header.stamp = msg->header.stamp;
-
-  {
-    // store back updated map
-    std::lock_guard<std::mutex> lock(subscription.mutex);
-    if (subscription.readonly_map &&
-        subscription.readonly_map->header.stamp > map->header.stamp) {
-      // we have been overrunned by faster update. our work was useless.
-      return;
-    }
-    subscription.writable_map = map;
-    subscription.readonly_map = map;
+  if (subscription.dirty_region.empty()) {
+    subscription.dirty_region = updated;
+  } else {
+    subscription.dirty_region |= updated;
   }
+  mapChanged();
 }
 
 std::string MapMerge::robotNameFromTopic(const std::string& topic)
@@ -348,12 +579,83 @@ bool MapMerge::getInitPose(const std::string& name,
 /*
  * execute()
  */
+/*
+ * Called whenever a map of some robot changed
+ */
+void MapMerge::mapChanged()
+{
+  // without known initial poses, maps are merged after their transforms are
+  // estimated
+  if (have_initial_poses_) {
+    requestMerge();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(schedule_mutex_);
+  estimation_pending_ = true;
+  schedule_cv_.notify_all();
+}
+
+void MapMerge::requestMerge()
+{
+  std::lock_guard<std::mutex> lock(schedule_mutex_);
+  auto now = std::chrono::steady_clock::now();
+  if (!merge_pending_) {
+    merge_pending_ = true;
+    first_change_ = now;
+  }
+  last_change_ = now;
+  schedule_cv_.notify_all();
+}
+
+/*
+ * Preemption point of estimation. Blocks while grids are composed.
+ */
+bool MapMerge::estimationMayContinue()
+{
+  std::unique_lock<std::mutex> lock(schedule_mutex_);
+  schedule_cv_.wait(lock, [this]() { return !composing_ || shutting_down_; });
+  return !shutting_down_;
+}
+
+static std::chrono::steady_clock::duration toDuration(double seconds)
+{
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(seconds));
+}
+
 void MapMerge::executemapMerging()
 {
-  ros::Rate r(merging_rate_);
-  while (node_.ok()) {
+  using clock = std::chrono::steady_clock;
+  const clock::duration min_period = toDuration(1.0 / merging_rate_);
+  const clock::duration min_latency = toDuration(merging_min_latency_);
+  const clock::duration max_latency = toDuration(merging_max_latency_);
+  clock::time_point last_merge;
+
+  std::unique_lock<std::mutex> lock(schedule_mutex_);
+  while (!shutting_down_) {
+    if (!merge_pending_) {
+      schedule_cv_.wait(lock);
+      continue;
+    }
+    // changes arriving shortly after each other are merged together, but no
+    // change waits longer than max latency. merging_rate limits merges
+    // further.
+    clock::time_point due = std::max(
+        std::min(last_change_ + min_latency, first_change_ + max_latency),
+        last_merge + min_period);
+    if (clock::now() < due) {
+      schedule_cv_.wait_until(lock, due);
+      continue;
+    }
+
+    merge_pending_ = false;
+    composing_ = true;
+    lock.unlock();
     mapMerging();
-    r.sleep();
+    lock.lock();
+    composing_ = false;
+    last_merge = clock::now();
+    schedule_cv_.notify_all();
   }
 }
 
@@ -371,10 +673,33 @@ void MapMerge::executeposeEstimation()
   if (have_initial_poses_)
     return;
 
-  ros::Rate r(estimation_rate_);
-  while (node_.ok()) {
+#ifdef __linux__
+  // estimation is a background task. Workers started by the pipeline inherit
+  // the priority.
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+
+  using clock = std::chrono::steady_clock;
+  const clock::duration min_period = toDuration(1.0 / estimation_rate_);
+  clock::time_point last_estimation;
+
+  std::unique_lock<std::mutex> lock(schedule_mutex_);
+  while (!shutting_down_) {
+    if (!estimation_pending_) {
+      schedule_cv_.wait(lock);
+      continue;
+    }
+    clock::time_point due = last_estimation + min_period;
+    if (clock::now() < due) {
+      schedule_cv_.wait_until(lock, due);
+      continue;
+    }
+
+    estimation_pending_ = false;
+    last_estimation = clock::now();
+    lock.unlock();
     poseEstimation();
-    r.sleep();
+    lock.lock();
   }
 }
 
@@ -387,7 +712,17 @@ void MapMerge::spin()
   std::thread merging_thr([this]() { executemapMerging(); });
   std::thread subscribing_thr([this]() { executetopicSubscribing(); });
   std::thread estimation_thr([this]() { executeposeEstimation(); });
-  ros::spin();
+  // callbacks of different maps are processed concurrently
+  ros::AsyncSpinner spinner(
+      static_cast<uint32_t>(std::max(spinner_threads_, 0)));
+  spinner.start();
+  ros::waitForShutdown();
+  spinner.stop();
+  {
+    std::lock_guard<std::mutex> lock(schedule_mutex_);
+    shutting_down_ = true;
+  }
+  schedule_cv_.notify_all();
   estimation_thr.join();
   merging_thr.join();
   subscribing_thr.join();
@@ -398,11 +733,6 @@ void MapMerge::spin()
 int main(int argc, char** argv)
 {
   ros::init(argc, argv, "map_merge");
-  // this package is still in development -- start wil debugging enabled
-  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
-                                     ros::console::levels::Debug)) {
-    ros::console::notifyLoggerLevelsChanged();
-  }
   map_merge::MapMerge map_merging;
   map_merging.spin();
   return 0;
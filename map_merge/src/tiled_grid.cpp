@@ -0,0 +1,231 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore_common/grid_codec.h>
+#include <map_merge/tiled_grid.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/make_shared.hpp>
+#include <ros/console.h>
+
+namespace map_merge
+{
+namespace grid_codec = explore_common::grid_codec;
+
+TiledGrid::TiledGrid(unsigned int band_rows)
+  : band_rows_(std::max(band_rows, 1u)), next_version_(0)
+{
+}
+
+void TiledGrid::reset(const nav_msgs::OccupancyGrid::ConstPtr& grid)
+{
+  header_ = grid->header;
+  info_ = grid->info;
+  source_ = grid;
+  bands_.clear();
+
+  const size_t width = info_.width;
+  if (grid->data.size() != width * info_.height) {
+    ROS_WARN("map data size %zu doesn't match map size %ux%u, map can't be "
+             "updated",
+             grid->data.size(), info_.width, info_.height);
+    return;
+  }
+  for (size_t y = 0; y < info_.height; y += band_rows_) {
+    // aliasing pointer keeps the message alive
+    bands_.push_back({boost::shared_ptr<const std::int8_t>(
+                          grid, grid->data.data() + y * width),
+                      false, ++next_version_});
+  }
+}
+
+std::int8_t* TiledGrid::writableBand(size_t band_idx)
+{
+  Band& band = bands_[band_idx];
+  if (!band.owned || band.data.use_count() > 1) {
+    size_t rows = std::min<size_t>(band_rows_,
+                                   info_.height - band_idx * band_rows_);
+    auto storage = boost::make_shared<std::vector<std::int8_t>>(
+        band.data.get(), band.data.get() + rows * info_.width);
+    band.data = boost::shared_ptr<const std::int8_t>(storage, storage->data());
+    band.owned = true;
+  }
+  band.version = ++next_version_;
+  // owned data are not shared with anyone
+  return const_cast<std::int8_t*>(band.data.get());
+}
+
+cv::Rect TiledGrid::update(const map_msgs::OccupancyGridUpdate& update)
+{
+  if (bands_.empty() || update.x < 0 || update.y < 0 ||
+      update.data.size() < size_t(update.width) * update.height) {
+    return cv::Rect();
+  }
+
+  const size_t width = info_.width;
+  const size_t x0 = static_cast<size_t>(update.x);
+  const size_t y0 = static_cast<size_t>(update.y);
+  const size_t xn = std::min(x0 + update.width, width);
+  const size_t yn = std::min(y0 + update.height, size_t(info_.height));
+  if (x0 >= xn || y0 >= yn) {
+    return cv::Rect();
+  }
+
+  for (size_t band = y0 / band_rows_; band * band_rows_ < yn; ++band) {
+    std::int8_t* data = writableBand(band);
+    size_t band_y0 = band * band_rows_;
+    size_t band_yn = std::min(band_y0 + band_rows_, yn);
+    for (size_t y = std::max(band_y0, y0); y < band_yn; ++y) {
+      std::memcpy(data + (y - band_y0) * width + x0,
+                  update.data.data() + (y - y0) * update.width, xn - x0);
+    }
+  }
+  header_.stamp = update.header.stamp;
+  source_ = nullptr;
+
+  return cv::Rect(static_cast<int>(x0), static_cast<int>(y0),
+                  static_cast<int>(xn - x0), static_cast<int>(yn - y0));
+}
+
+bool TiledGrid::resetEncoded(const nav_msgs::OccupancyGrid& grid)
+{
+  header_ = grid.header;
+  info_ = grid.info;
+  source_ = nullptr;
+  bands_.clear();
+
+  const size_t width = info_.width;
+  std::vector<std::int8_t*> rows;
+  rows.reserve(info_.height);
+  for (size_t y = 0; y < info_.height; y += band_rows_) {
+    size_t band_rows = std::min<size_t>(band_rows_, info_.height - y);
+    auto storage =
+        boost::make_shared<std::vector<std::int8_t>>(band_rows * width);
+    for (size_t i = 0; i < band_rows; ++i) {
+      rows.push_back(storage->data() + i * width);
+    }
+    bands_.push_back({boost::shared_ptr<const std::int8_t>(storage,
+                                                           storage->data()),
+                      true, ++next_version_});
+  }
+
+  if (!grid_codec::decode(grid.data, info_.width, info_.height,
+                          grid_codec::occupancy_values,
+                          [&rows](unsigned int y) { return rows[y]; })) {
+    ROS_WARN("encoded map %ux%u is malformed, map can't be updated",
+             info_.width, info_.height);
+    bands_.clear();
+    return false;
+  }
+  return true;
+}
+
+cv::Rect TiledGrid::updateEncoded(const map_msgs::OccupancyGridUpdate& update)
+{
+  if (bands_.empty() || update.x < 0 || update.y < 0 || update.width == 0 ||
+      update.height == 0 ||
+      size_t(update.x) + update.width > info_.width ||
+      size_t(update.y) + update.height > info_.height) {
+    return cv::Rect();
+  }
+
+  const size_t width = info_.width;
+  const size_t x0 = static_cast<size_t>(update.x);
+  const size_t y0 = static_cast<size_t>(update.y);
+  size_t band = bands_.size();
+  std::int8_t* data = nullptr;
+  auto row = [&](unsigned int y) {
+    size_t grid_y = y0 + y;
+    if (grid_y / band_rows_ != band) {
+      band = grid_y / band_rows_;
+      data = writableBand(band);
+    }
+    return data + (grid_y - band * band_rows_) * width + x0;
+  };
+  if (!grid_codec::decode(update.data, update.width, update.height,
+                          grid_codec::occupancy_values, row)) {
+    return cv::Rect();
+  }
+  header_.stamp = update.header.stamp;
+  source_ = nullptr;
+
+  return cv::Rect(update.x, update.y, static_cast<int>(update.width),
+                  static_cast<int>(update.height));
+}
+
+nav_msgs::OccupancyGrid::ConstPtr
+GridAssembler::update(const TiledGrid& snapshot)
+{
+  if (snapshot.source()) {
+    // grid will be copied completely next time
+    versions_.clear();
+    return snapshot.source();
+  }
+  if (snapshot.bands() == 0) {
+    return nullptr;
+  }
+
+  const nav_msgs::MapMetaData& info = snapshot.info();
+  if (!grid_ || grid_->info.width != info.width ||
+      grid_->info.height != info.height) {
+    grid_.reset(new nav_msgs::OccupancyGrid());
+    grid_->data.resize(size_t(info.width) * info.height);
+    versions_.clear();
+  }
+  grid_->header = snapshot.header();
+  grid_->info = info;
+
+  versions_.resize(snapshot.bands(), 0);
+  const size_t band_size = size_t(snapshot.bandRows()) * info.width;
+  size_t copied = 0;
+  for (size_t band = 0; band < snapshot.bands(); ++band) {
+    if (versions_[band] == snapshot.bandVersion(band)) {
+      continue;
+    }
+    size_t offset = band * band_size;
+    size_t size = std::min(band_size, grid_->data.size() - offset);
+    std::memcpy(grid_->data.data() + offset, snapshot.bandData(band), size);
+    versions_[band] = snapshot.bandVersion(band);
+    copied += size;
+  }
+  ROS_DEBUG("assembled grid, copied %zu bytes", copied);
+
+  return grid_;
+}
+
+}  // namespace map_merge
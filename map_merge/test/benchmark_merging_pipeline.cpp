@@ -0,0 +1,290 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <combine_grids/grid_warper.h>
+#include <combine_grids/merging_pipeline.h>
+#include <explore_common/allocation_counter.h>
+#include <opencv2/imgproc.hpp>
+#include "testing_helpers.h"
+
+/* benchmarks of estimation and composition on maps recorded for tests (in the
+ * current directory) and on their upscaled versions. All benchmarks report
+ * cells per second and allocations per call. */
+
+const std::array<const char*, 2> hector_maps = {
+    "map00.pgm",
+    "map05.pgm",
+};
+
+const std::array<const char*, 2> gmapping_maps = {
+    "2011-08-09-12-22-52.pgm",
+    "2012-01-28-11-12-01.pgm",
+};
+
+/* loads pair of recorded maps, upscaled by integer scale */
+static std::vector<nav_msgs::OccupancyGridConstPtr>
+loadScaledMaps(benchmark::State& state, int pair, int scale)
+{
+  std::vector<nav_msgs::OccupancyGridConstPtr> maps;
+  try {
+    maps = pair == 0 ? loadMaps(hector_maps.begin(), hector_maps.end())
+                     : loadMaps(gmapping_maps.begin(), gmapping_maps.end());
+  } catch (const std::runtime_error& e) {
+    state.SkipWithError(e.what());
+    return {};
+  }
+  if (scale == 1) {
+    return maps;
+  }
+
+  for (auto& map : maps) {
+    cv::Mat image(map->info.height, map->info.width, CV_8UC1,
+                  const_cast<signed char*>(map->data.data()));
+    cv::Mat scaled;
+    cv::resize(image, scaled, cv::Size(), scale, scale, cv::INTER_NEAREST);
+    nav_msgs::OccupancyGridPtr grid(new nav_msgs::OccupancyGrid());
+    grid->info = map->info;
+    grid->info.width = static_cast<uint>(scaled.cols);
+    grid->info.height = static_cast<uint>(scaled.rows);
+    grid->data.assign(scaled.ptr<signed char>(),
+                      scaled.ptr<signed char>() + scaled.total());
+    map = grid;
+  }
+  return maps;
+}
+
+static size_t
+cellCount(const std::vector<nav_msgs::OccupancyGridConstPtr>& maps)
+{
+  size_t cells = 0;
+  for (auto& map : maps) {
+    cells += map->data.size();
+  }
+  return cells;
+}
+
+/* estimation from scratch. Arguments are the map pair and scale. */
+static void BM_estimateTransforms(benchmark::State& state)
+{
+  auto maps = loadScaledMaps(state, static_cast<int>(state.range(0)),
+                             static_cast<int>(state.range(1)));
+  if (maps.empty()) {
+    return;
+  }
+
+  explore_common::AllocationCounter allocations;
+  for (auto _ : state) {
+    combine_grids::MergingPipeline merger;
+    merger.setWorkerCount(1);
+    merger.feed(maps.begin(), maps.end());
+    benchmark::DoNotOptimize(merger.estimateTransforms());
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() *
+                                               cellCount(maps)));
+}
+BENCHMARK(BM_estimateTransforms)
+    ->Args({0, 1})
+    ->Args({1, 1})
+    ->Args({0, 2})
+    ->Args({0, 4})
+    ->Unit(benchmark::kMillisecond);
+
+/* estimation from scratch with more robots, simulated by rotated copies of
+ * the recorded maps. Arguments are the number of robots and of workers, 0
+ * workers use one thread per core. */
+static void BM_parallelEstimation(benchmark::State& state)
+{
+  std::vector<nav_msgs::OccupancyGridConstPtr> base_maps;
+  for (int pair : {0, 1}) {
+    auto maps = loadScaledMaps(state, pair, 1);
+    if (maps.empty()) {
+      return;
+    }
+    base_maps.insert(base_maps.end(), maps.begin(), maps.end());
+  }
+
+  const size_t robots = static_cast<size_t>(state.range(0));
+  std::vector<nav_msgs::OccupancyGridConstPtr> maps;
+  combine_grids::internal::GridWarper warper;
+  for (size_t i = 0; i < robots; ++i) {
+    const auto& base = base_maps[i % base_maps.size()];
+    if (i < base_maps.size()) {
+      maps.push_back(base);
+      continue;
+    }
+    cv::Mat image(base->info.height, base->info.width, CV_8UC1,
+                  const_cast<signed char*>(base->data.data()));
+    cv::Mat warped;
+    warper.warp(image, randomTransformMatrix(), warped);
+    nav_msgs::OccupancyGridPtr grid(new nav_msgs::OccupancyGrid());
+    grid->info = base->info;
+    grid->info.width = static_cast<uint>(warped.cols);
+    grid->info.height = static_cast<uint>(warped.rows);
+    grid->data.assign(warped.ptr<signed char>(),
+                      warped.ptr<signed char>() + warped.total());
+    maps.push_back(grid);
+  }
+
+  for (auto _ : state) {
+    combine_grids::MergingPipeline merger;
+    merger.setWorkerCount(static_cast<size_t>(state.range(1)));
+    merger.feed(maps.begin(), maps.end());
+    benchmark::DoNotOptimize(merger.estimateTransforms());
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() *
+                                               cellCount(maps)));
+}
+BENCHMARK(BM_parallelEstimation)
+    ->Apply([](benchmark::internal::Benchmark* benchmark) {
+      for (int robots : {2, 4, 8}) {
+        benchmark->Args({robots, 1});
+        benchmark->Args({robots, 0});
+      }
+    })
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/* repeated estimation of unchanged grids, served by feature and match
+ * caches */
+static void BM_estimateTransformsCached(benchmark::State& state)
+{
+  auto maps = loadScaledMaps(state, static_cast<int>(state.range(0)), 1);
+  if (maps.empty()) {
+    return;
+  }
+  combine_grids::MergingPipeline merger;
+  merger.setWorkerCount(1);
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+
+  explore_common::AllocationCounter allocations;
+  for (auto _ : state) {
+    merger.feed(maps.begin(), maps.end());
+    benchmark::DoNotOptimize(merger.estimateTransforms());
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() *
+                                               cellCount(maps)));
+}
+BENCHMARK(BM_estimateTransformsCached)->Arg(0)->Arg(1);
+
+/* second grid is rotated by 30 degrees and shifted by half of its size */
+static void
+setTransforms(combine_grids::MergingPipeline& merger,
+              const std::vector<nav_msgs::OccupancyGridConstPtr>& maps)
+{
+  std::vector<geometry_msgs::Transform> transforms(maps.size());
+  for (size_t i = 0; i < maps.size(); ++i) {
+    double angle = i == 0 ? 0. : 0.523599;
+    transforms[i].rotation.z = std::sin(angle / 2);
+    transforms[i].rotation.w = std::cos(angle / 2);
+    if (i > 0) {
+      transforms[i].translation.x = maps[i]->info.width / 2.;
+      transforms[i].translation.y = maps[i]->info.height / 2.;
+    }
+  }
+  merger.setTransforms(transforms.begin(), transforms.end());
+}
+
+/* full composition. Arguments are the map pair and scale. */
+static void BM_composeGrids(benchmark::State& state)
+{
+  auto maps = loadScaledMaps(state, static_cast<int>(state.range(0)),
+                             static_cast<int>(state.range(1)));
+  if (maps.empty()) {
+    return;
+  }
+  combine_grids::MergingPipeline merger;
+  merger.setWorkerCount(1);
+  merger.feed(maps.begin(), maps.end());
+  setTransforms(merger, maps);
+  size_t merged_cells = merger.composeGrids()->data.size();
+
+  explore_common::AllocationCounter allocations;
+  for (auto _ : state) {
+    // result is released, so its buffer is reused by the next composition
+    benchmark::DoNotOptimize(merger.composeGrids().get());
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() *
+                                               merged_cells));
+}
+BENCHMARK(BM_composeGrids)
+    ->Args({0, 1})
+    ->Args({1, 1})
+    ->Args({0, 2})
+    ->Args({0, 4})
+    ->Unit(benchmark::kMillisecond);
+
+/* recomposition of a 64x64 region updated in the first grid. Argument is the
+ * scale of hector maps. */
+static void BM_composeGridsChanged(benchmark::State& state)
+{
+  auto maps = loadScaledMaps(state, 0, static_cast<int>(state.range(0)));
+  if (maps.empty()) {
+    return;
+  }
+  combine_grids::MergingPipeline merger;
+  merger.setWorkerCount(1);
+  merger.feed(maps.begin(), maps.end());
+  setTransforms(merger, maps);
+  merger.composeGrids();
+
+  std::vector<cv::Rect> changed_regions(maps.size());
+  changed_regions[0] =
+      cv::Rect(static_cast<int>(maps[0]->info.width / 2),
+               static_cast<int>(maps[0]->info.height / 2), 64, 64) &
+      cv::Rect(0, 0, static_cast<int>(maps[0]->info.width),
+               static_cast<int>(maps[0]->info.height));
+
+  explore_common::AllocationCounter allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(merger.composeGrids(changed_regions).get());
+  }
+  allocations.report(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() *
+                                               changed_regions[0].area()));
+}
+BENCHMARK(BM_composeGridsChanged)->Arg(1)->Arg(4);
+
+BENCHMARK_MAIN();
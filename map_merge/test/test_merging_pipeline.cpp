@@ -34,7 +34,12 @@
  *
  *********************************************************************/
 
-#include <combine_grids/grid_warper.h>
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
 #include <gtest/gtest.h>
 #include <ros/console.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
@@ -42,6 +47,8 @@
 #include "testing_helpers.h"
 
 #define private public
+#include <combine_grids/grid_compositor.h>
+#include <combine_grids/grid_warper.h>
 #include <combine_grids/merging_pipeline.h>
 
 const std::array<const char*, 2> hector_maps = {
@@ -149,6 +156,7 @@ TEST(MergingPipeline, estimationAccuracy)
   // this relies on internal implementation of merging pipeline
   merger.grids_.emplace_back();
   merger.images_.push_back(warped);
+  merger.known_rois_.push_back(merger.knownRoi(warped));
 
   merger.estimateTransforms();
   auto merged_grid = merger.composeGrids();
@@ -166,6 +174,585 @@ TEST(MergingPipeline, estimationAccuracy)
   EXPECT_NEAR(ty - roi.tl().y, t.getOrigin().y(), 2);
 }
 
+TEST(MergingPipeline, findsKnownRoi)
+{
+  nav_msgs::OccupancyGridPtr map(new nav_msgs::OccupancyGrid());
+  map->info.width = 300;
+  map->info.height = 200;
+  map->info.resolution = resolution;
+  map->data.resize(300 * 200, -1);
+
+  std::vector<nav_msgs::OccupancyGridConstPtr> maps{map};
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  ASSERT_EQ(merger.known_rois_.size(), 1);
+  EXPECT_TRUE(merger.known_rois_[0].empty());
+
+  // known cells at (100, 50), (150, 80) and (199, 120), the box is extended by
+  // the margin and clipped by the grid
+  map->data[50 * 300 + 100] = 0;
+  map->data[80 * 300 + 150] = 100;
+  map->data[120 * 300 + 199] = 0;
+  // grid changed in place, stamp tells it is to be scanned again
+  map->header.stamp = ros::Time(1.);
+  merger.feed(maps.begin(), maps.end());
+  EXPECT_EQ(merger.known_rois_[0],
+            cv::Rect(cv::Point(68, 18), cv::Point(232, 153)));
+
+  map->data[0] = 0;
+  map->data[map->data.size() - 1] = 0;
+  map->header.stamp = ros::Time(2.);
+  merger.feed(maps.begin(), maps.end());
+  EXPECT_EQ(merger.known_rois_[0], cv::Rect(0, 0, 300, 200));
+}
+
+TEST(MergingPipeline, growsKnownRoiFromChangedRegions)
+{
+  nav_msgs::OccupancyGridPtr map(new nav_msgs::OccupancyGrid());
+  map->info.width = 300;
+  map->info.height = 200;
+  map->info.resolution = resolution;
+  map->data.resize(300 * 200, -1);
+  map->data[100 * 300 + 150] = 0;
+
+  std::vector<nav_msgs::OccupancyGridConstPtr> maps{map};
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  EXPECT_EQ(merger.known_rois_[0],
+            cv::Rect(cv::Point(118, 68), cv::Point(183, 133)));
+
+  // only the changed region is scanned, margin is not clipped by it
+  map->data[40 * 300 + 60] = 100;
+  map->data[190 * 300 + 20] = 0;
+  map->header.stamp = ros::Time(1.);
+  merger.feed(maps.begin(), maps.end(), {cv::Rect(50, 30, 20, 20)});
+  EXPECT_EQ(merger.known_rois_[0],
+            cv::Rect(cv::Point(28, 8), cv::Point(183, 133)));
+
+  // the same message with the same stamp keeps its box
+  merger.feed(maps.begin(), maps.end());
+  EXPECT_EQ(merger.known_rois_[0],
+            cv::Rect(cv::Point(28, 8), cv::Point(183, 133)));
+
+  // a new message is scanned whole
+  maps[0] = nav_msgs::OccupancyGridPtr(new nav_msgs::OccupancyGrid(*map));
+  merger.feed(maps.begin(), maps.end(), {});
+  EXPECT_EQ(merger.known_rois_[0],
+            cv::Rect(cv::Point(0, 8), cv::Point(183, 200)));
+}
+
+TEST(MergingPipeline, cachesFeaturesOfUnchangedGrids)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(merger.estimateTransforms());
+  auto transforms = merger.getTransforms();
+  ASSERT_EQ(merger.features_cache_.size(), 2);
+  auto generation0 = merger.features_cache_[0].generation;
+  auto generation1 = merger.features_cache_[1].generation;
+  EXPECT_EQ(merger.matches_cache_.size(), 1);
+
+  // republished map with the same content keeps its features
+  nav_msgs::OccupancyGridPtr republished(new nav_msgs::OccupancyGrid(*maps[0]));
+  republished->header.stamp = ros::Time(10.);
+  maps[0] = republished;
+  merger.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(merger.estimateTransforms());
+  EXPECT_EQ(merger.features_cache_[0].generation, generation0);
+  EXPECT_EQ(merger.features_cache_[1].generation, generation1);
+  EXPECT_EQ(merger.matches_cache_.size(), 1);
+  auto cached_transforms = merger.getTransforms();
+  ASSERT_EQ(cached_transforms.size(), transforms.size());
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    EXPECT_DOUBLE_EQ(transforms[i].translation.x,
+                     cached_transforms[i].translation.x);
+    EXPECT_DOUBLE_EQ(transforms[i].translation.y,
+                     cached_transforms[i].translation.y);
+    EXPECT_DOUBLE_EQ(transforms[i].rotation.z, cached_transforms[i].rotation.z);
+  }
+
+  // changed map is processed again, the other one is not
+  nav_msgs::OccupancyGridPtr changed(new nav_msgs::OccupancyGrid(*maps[1]));
+  changed->data[changed->data.size() / 2] = 100;
+  maps[1] = changed;
+  merger.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(merger.estimateTransforms());
+  EXPECT_EQ(merger.features_cache_[0].generation, generation0);
+  EXPECT_NE(merger.features_cache_[1].generation, generation1);
+  EXPECT_EQ(merger.matches_cache_.size(), 1);
+}
+
+TEST(MergingPipeline, parallelEstimationMatchesSerial)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline serial;
+  serial.setWorkerCount(1);
+  serial.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(serial.estimateTransforms());
+  combine_grids::MergingPipeline parallel;
+  parallel.setWorkerCount(4);
+  parallel.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(parallel.estimateTransforms());
+
+  auto serial_transforms = serial.getTransforms();
+  auto parallel_transforms = parallel.getTransforms();
+  ASSERT_EQ(serial_transforms.size(), parallel_transforms.size());
+  for (size_t i = 0; i < serial_transforms.size(); ++i) {
+    EXPECT_DOUBLE_EQ(serial_transforms[i].translation.x,
+                     parallel_transforms[i].translation.x);
+    EXPECT_DOUBLE_EQ(serial_transforms[i].translation.y,
+                     parallel_transforms[i].translation.y);
+    EXPECT_DOUBLE_EQ(serial_transforms[i].rotation.z,
+                     parallel_transforms[i].rotation.z);
+  }
+}
+
+TEST(MergingPipeline, parallelCompositionMatchesSerial)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline serial;
+  serial.setWorkerCount(1);
+  serial.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(serial.estimateTransforms());
+  auto transforms = serial.getTransforms();
+  auto serial_merged = serial.composeGrids();
+
+  combine_grids::MergingPipeline parallel;
+  parallel.setWorkerCount(4);
+  parallel.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(parallel.setTransforms(transforms.begin(), transforms.end()));
+  auto parallel_merged = parallel.composeGrids();
+  ASSERT_TRUE(serial_merged && parallel_merged);
+  EXPECT_EQ(serial_merged->info.width, parallel_merged->info.width);
+  EXPECT_EQ(serial_merged->info.height, parallel_merged->info.height);
+  EXPECT_TRUE(serial_merged->data == parallel_merged->data);
+
+  // composition again from reused buffers gives the same result
+  parallel_merged = parallel.composeGrids();
+  EXPECT_TRUE(serial_merged->data == parallel_merged->data);
+  std::vector<cv::Rect> everything(maps.size(), cv::Rect(0, 0, 1 << 16,
+                                                         1 << 16));
+  parallel_merged = parallel.composeGrids(everything);
+  EXPECT_TRUE(serial_merged->data == parallel_merged->data);
+}
+
+TEST(GridCompositor, tilesCoverArea)
+{
+  cv::Rect area(-10, 5, 600, 257);
+  auto tiles = combine_grids::internal::GridCompositor::tiles(area);
+  // 3 tiles in a row, 2 rows
+  ASSERT_EQ(6u, tiles.size());
+  int covered = 0;
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    EXPECT_EQ(tiles[i], tiles[i] & area);
+    for (size_t j = i + 1; j < tiles.size(); ++j) {
+      EXPECT_TRUE((tiles[i] & tiles[j]).empty());
+    }
+    covered += tiles[i].area();
+  }
+  EXPECT_EQ(area.area(), covered);
+  EXPECT_TRUE(combine_grids::internal::GridCompositor::tiles(cv::Rect())
+                  .empty());
+}
+
+TEST(MergingPipeline, preemptedEstimationResumes)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline reference;
+  reference.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(reference.estimateTransforms());
+
+  combine_grids::MergingPipeline merger;
+  merger.setWorkerCount(1);
+  // let first grid through, preempt the rest
+  size_t checks = 0;
+  merger.setPreemptionCheck([&checks]() { return checks++ < 1; });
+  merger.feed(maps.begin(), maps.end());
+  EXPECT_FALSE(merger.estimateTransforms());
+  EXPECT_NE(merger.features_cache_[0].generation, 0u);
+  EXPECT_EQ(merger.features_cache_[1].generation, 0u);
+
+  merger.setPreemptionCheck({});
+  merger.feed(maps.begin(), maps.end());
+  ASSERT_TRUE(merger.estimateTransforms());
+  auto transforms = merger.getTransforms();
+  auto reference_transforms = reference.getTransforms();
+  ASSERT_EQ(reference_transforms.size(), transforms.size());
+  for (size_t i = 0; i < transforms.size(); ++i) {
+    EXPECT_DOUBLE_EQ(reference_transforms[i].translation.x,
+                     transforms[i].translation.x);
+    EXPECT_DOUBLE_EQ(reference_transforms[i].translation.y,
+                     transforms[i].translation.y);
+    EXPECT_DOUBLE_EQ(reference_transforms[i].rotation.z,
+                     transforms[i].rotation.z);
+  }
+}
+
+TEST(MergingPipeline, keepsWorkersBetweenEstimations)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline merger;
+  merger.setWorkerCount(3);
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  merger.setPreemptionCheck([&mutex, &threads]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.insert(std::this_thread::get_id());
+    return true;
+  });
+  for (size_t i = 0; i < 5; ++i) {
+    merger.feed(maps.begin(), maps.end());
+    merger.estimateTransforms();
+  }
+  // the caller and at most two pool threads, reused on every call
+  EXPECT_LE(threads.size(), 3u);
+
+  // exceptions thrown in workers reach the caller
+  merger.setPreemptionCheck(
+      []() -> bool { throw std::runtime_error("preempted"); });
+  EXPECT_THROW(merger.estimateTransforms(), std::runtime_error);
+  merger.setPreemptionCheck({});
+  EXPECT_TRUE(merger.estimateTransforms());
+}
+
+TEST(MergingPipeline, refinesPerturbedTransforms)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  // nothing to track before the first estimation
+  EXPECT_FALSE(merger.refineTransforms());
+  ASSERT_TRUE(merger.estimateTransforms());
+  auto estimated = merger.getTransforms();
+
+  // this relies on internal implementation of merging pipeline
+  size_t moved = isIdentity(estimated[0]) ? 1 : 0;
+  double angle = 0.02;
+  cv::Mat perturbation = (cv::Mat_<double>(3, 3) << std::cos(angle),
+                          -std::sin(angle), 3, std::sin(angle),
+                          std::cos(angle), -2, 0, 0, 1);
+  merger.transforms_[moved] = perturbation * merger.transforms_[moved];
+
+  ASSERT_TRUE(merger.refineTransforms());
+  auto refined = merger.getTransforms();
+  ASSERT_EQ(estimated.size(), refined.size());
+  EXPECT_TRUE(isIdentity(refined[1 - moved]));
+  tf2::Transform t_estimated, t_refined;
+  tf2::fromMsg(estimated[moved], t_estimated);
+  tf2::fromMsg(refined[moved], t_refined);
+  EXPECT_NEAR(t_estimated.getOrigin().x(), t_refined.getOrigin().x(), 2);
+  EXPECT_NEAR(t_estimated.getOrigin().y(), t_refined.getOrigin().y(), 2);
+  EXPECT_NEAR(0., t_estimated.getRotation().angleShortestPath(
+                      t_refined.getRotation()),
+              1e-2);
+}
+
+TEST(MergingPipeline, prunesPairsToNeighbours)
+{
+  std::vector<const char*> files(hector_maps.begin(), hector_maps.end());
+  files.insert(files.end(), gmapping_maps.begin(), gmapping_maps.end());
+  auto maps = loadMaps(files.begin(), files.end());
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  // ignore prior from estimated transforms
+  merger.transforms_.clear();
+  const size_t n = maps.size();
+
+  auto all_pairs = merger.matchMask();
+  EXPECT_EQ(n * (n - 1) / 2, size_t(std::count(all_pairs.begin(),
+                                               all_pairs.end(), 1)));
+
+  merger.setMatchingNeighbours(1);
+  auto mask = merger.matchMask();
+  size_t pairs = size_t(std::count(mask.begin(), mask.end(), 1));
+  EXPECT_LE(pairs, n);
+  for (size_t i = 0; i < n; ++i) {
+    size_t neighbours = 0;
+    for (size_t j = 0; j < n; ++j) {
+      neighbours += mask[std::min(i, j) * n + std::max(i, j)] && i != j;
+      // only upper triangle is used
+      EXPECT_TRUE(j > i || !mask[i * n + j]);
+    }
+    EXPECT_GE(neighbours, 1u);
+  }
+}
+
+// number of cells that differ in merged grids of the same size
+static size_t countDifferences(const nav_msgs::OccupancyGrid& grid1,
+                               const nav_msgs::OccupancyGrid& grid2)
+{
+  EXPECT_EQ(grid1.data.size(), grid2.data.size());
+  size_t differences = 0;
+  for (size_t i = 0; i < grid1.data.size() && i < grid2.data.size(); ++i) {
+    differences += grid1.data[i] != grid2.data[i];
+  }
+  return differences;
+}
+
+TEST(MergingPipeline, recomposesChangedRegions)
+{
+  auto loaded = loadMaps(gmapping_maps.begin(), gmapping_maps.end());
+  std::vector<nav_msgs::OccupancyGridPtr> writable;
+  for (auto& map : loaded) {
+    writable.emplace_back(new nav_msgs::OccupancyGrid(*map));
+  }
+  std::vector<nav_msgs::OccupancyGridConstPtr> maps(writable.begin(),
+                                                    writable.end());
+
+  std::vector<geometry_msgs::Transform> translations(2);
+  translations[0].rotation.w = 1;
+  translations[1].rotation.w = 1;
+  translations[1].translation.x = 120;
+  translations[1].translation.y = -80;
+  std::vector<geometry_msgs::Transform> rotations{randomTransform(),
+                                                  randomTransform()};
+
+  for (auto* transforms : {&translations, &rotations}) {
+    combine_grids::MergingPipeline merger;
+    merger.feed(maps.begin(), maps.end());
+    merger.setTransforms(transforms->begin(), transforms->end());
+    EXPECT_VALID_GRID(merger.composeGrids(std::vector<cv::Rect>()));
+
+    // change a patch of the first grid in place, as partial map updates do.
+    // Each round writes a different pattern.
+    int phase = transforms == &translations ? 0 : 1;
+    cv::Rect patch(writable[0]->info.width / 2, writable[0]->info.height / 2,
+                   40, 30);
+    for (int y = patch.y; y < patch.br().y; ++y) {
+      for (int x = patch.x; x < patch.br().x; ++x) {
+        writable[0]->data[size_t(y) * writable[0]->info.width + size_t(x)] =
+            (x + y + phase) % 2 ? 0 : 100;
+      }
+    }
+    merger.feed(maps.begin(), maps.end(), {patch, cv::Rect()});
+    merger.setTransforms(transforms->begin(), transforms->end());
+    auto updated = merger.composeGrids({patch, cv::Rect()});
+    EXPECT_VALID_GRID(updated);
+
+    combine_grids::MergingPipeline reference;
+    reference.feed(maps.begin(), maps.end());
+    reference.setTransforms(transforms->begin(), transforms->end());
+    auto expected = reference.composeGrids();
+    EXPECT_VALID_GRID(expected);
+    ASSERT_EQ(updated->info.width, expected->info.width);
+    ASSERT_EQ(updated->info.height, expected->info.height);
+    // cells are sampled in absolute coordinates, so recomposed regions match
+    // also for rotated grids
+    EXPECT_EQ(countDifferences(*updated, *expected), 0);
+  }
+}
+
+TEST(MergingPipeline, reusesReleasedResult)
+{
+  auto maps = loadMaps(gmapping_maps.begin(), gmapping_maps.end());
+  std::vector<geometry_msgs::Transform> transforms{randomTransform(),
+                                                   randomTransform()};
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(transforms.begin(), transforms.end());
+
+  auto merged_grid = merger.composeGrids();
+  EXPECT_VALID_GRID(merged_grid);
+  cv::Rect whole(0, 0, int(merged_grid->info.width),
+                 int(merged_grid->info.height));
+  EXPECT_EQ(whole, merger.changedRegion());
+  const int8_t* data = merged_grid->data.data();
+  auto expected = merged_grid->data;
+  merged_grid.reset();
+
+  // released result is composed in place
+  merged_grid = merger.composeGrids();
+  EXPECT_EQ(data, merged_grid->data.data());
+  EXPECT_TRUE(expected == merged_grid->data);
+  merged_grid.reset();
+  merged_grid = merger.composeGrids(std::vector<cv::Rect>());
+  EXPECT_EQ(data, merged_grid->data.data());
+  EXPECT_TRUE(merger.changedRegion().empty());
+
+  // held result is left intact
+  auto held = merged_grid;
+  merged_grid = merger.composeGrids();
+  EXPECT_NE(held->data.data(), merged_grid->data.data());
+  EXPECT_TRUE(held->data == merged_grid->data);
+}
+
+TEST(MergingPipeline, composesBesideLatchedResult)
+{
+  auto loaded = loadMaps(gmapping_maps.begin(), gmapping_maps.end());
+  std::vector<nav_msgs::OccupancyGridPtr> writable;
+  for (auto& map : loaded) {
+    writable.emplace_back(new nav_msgs::OccupancyGrid(*map));
+  }
+  std::vector<nav_msgs::OccupancyGridConstPtr> maps(writable.begin(),
+                                                    writable.end());
+  std::vector<geometry_msgs::Transform> transforms{randomTransform(),
+                                                   randomTransform()};
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(transforms.begin(), transforms.end());
+
+  // latched publisher holds the last published result
+  nav_msgs::OccupancyGridPtr latched = merger.composeGrids();
+  EXPECT_VALID_GRID(latched);
+  std::vector<const nav_msgs::OccupancyGrid*> buffers{latched.get()};
+  std::vector<const int8_t*> data{latched->data.data()};
+  const uint width = writable[0]->info.width;
+  for (int tick = 1; tick < 7; ++tick) {
+    // each tick changes a different patch of the first grid in place
+    cv::Rect patch(int(width) / 4 + tick * 20,
+                   int(writable[0]->info.height) / 4 + tick * 10, 30, 20);
+    for (int y = patch.y; y < patch.br().y; ++y) {
+      for (int x = patch.x; x < patch.br().x; ++x) {
+        writable[0]->data[size_t(y) * width + size_t(x)] =
+            (x + y + tick) % 2 ? 0 : 100;
+      }
+    }
+    const std::vector<int8_t> held = latched->data;
+    merger.feed(maps.begin(), maps.end(), {patch, cv::Rect()});
+    merger.setTransforms(transforms.begin(), transforms.end());
+    nav_msgs::OccupancyGridPtr merged =
+        tick == 4 ? merger.composeGrids()
+                  : merger.composeGrids({patch, cv::Rect()});
+    EXPECT_VALID_GRID(merged);
+    EXPECT_TRUE(held == latched->data);
+    EXPECT_NE(latched.get(), merged.get());
+    if (tick == 1) {
+      buffers.push_back(merged.get());
+      data.push_back(merged->data.data());
+    }
+    // results alternate between two buffers, no grid is allocated
+    EXPECT_EQ(buffers[size_t(tick) % 2], merged.get());
+    EXPECT_EQ(data[size_t(tick) % 2], merged->data.data());
+
+    combine_grids::MergingPipeline reference;
+    reference.feed(maps.begin(), maps.end());
+    reference.setTransforms(transforms.begin(), transforms.end());
+    auto expected = reference.composeGrids();
+    ASSERT_EQ(expected->info.width, merged->info.width);
+    ASSERT_EQ(expected->info.height, merged->info.height);
+    EXPECT_EQ(countDifferences(*merged, *expected), 0);
+    latched = merged;
+  }
+}
+
+TEST(GridWarper, fusedWarpMatchesWarp)
+{
+  auto map = loadMap(hector_maps[1]);
+  combine_grids::MergingPipeline merger;
+  merger.feed(&map, &map + 1);
+  const cv::Mat& grid = merger.images_[0];
+
+  cv::Mat translation = cv::Mat::eye(3, 3, CV_64F);
+  translation.at<double>(0, 2) = 35;
+  translation.at<double>(1, 2) = -20;
+  cv::Mat rotation = (cv::Mat_<double>(3, 3) << 0, -1, 10, 1, 0, 5, 0, 0, 1);
+  cv::Mat random = randomTransformMatrix();
+
+  combine_grids::internal::GridWarper warper;
+  for (const cv::Mat* transform : {&translation, &rotation, &random}) {
+    cv::Mat warped;
+    cv::Rect roi = warper.warp(grid, *transform, warped);
+    cv::Mat fused(roi.size(), CV_8S, cv::Scalar::all(-1));
+    warper.warpMax(grid, *transform, roi, fused);
+
+    // reinterpret warped matrix as signed
+    cv::Mat warped_signed(warped.size(), CV_8S, warped.ptr());
+    size_t differences = size_t(cv::countNonZero(fused != warped_signed));
+    if (transform == &random) {
+      // warpAffine rounds relative to roi, fused kernel in absolute coordinates
+      EXPECT_LT(differences, fused.total() / 1000);
+    } else {
+      EXPECT_EQ(differences, 0u);
+    }
+  }
+}
+
+TEST(GridWarper, reusesScratchBetweenCalls)
+{
+  auto map = loadMap(hector_maps[1]);
+  combine_grids::MergingPipeline merger;
+  merger.feed(&map, &map + 1);
+  const cv::Mat& grid = merger.images_[0];
+  cv::Mat random = randomTransformMatrix();
+
+  combine_grids::internal::GridWarper warper;
+  cv::Rect roi = warper.warpedRoi(grid, random);
+  cv::Mat composed(roi.size(), CV_8S, cv::Scalar::all(-1));
+  warper.warpMax(grid, random, roi, composed);
+  const int* adelta = warper.adelta_.data();
+  const schar* row = warper.row_.data();
+
+  // smaller areas fit the scratch of the first call
+  cv::Rect tile(roi.tl(), cv::Size(roi.width / 2, roi.height / 2));
+  cv::Mat tile_composed(tile.size(), CV_8S, cv::Scalar::all(-1));
+  warper.warpMax(grid, random, tile, tile_composed);
+  EXPECT_EQ(adelta, warper.adelta_.data());
+  EXPECT_EQ(row, warper.row_.data());
+}
+
+TEST(MergingPipeline, composesCroppedKnownArea)
+{
+  // known area does not start at (0, 0)
+  nav_msgs::OccupancyGridPtr map(new nav_msgs::OccupancyGrid());
+  map->info.width = 300;
+  map->info.height = 200;
+  map->info.resolution = resolution;
+  map->data.resize(300 * 200, -1);
+  for (size_t y = 60; y < 120; ++y) {
+    for (size_t x = 100; x < 180; ++x) {
+      map->data[y * 300 + x] = (x * 7 + y * 3) % 5 ? 0 : 100;
+    }
+  }
+  std::vector<nav_msgs::OccupancyGridConstPtr> maps{map};
+
+  cv::Mat identity = cv::Mat::eye(3, 3, CV_64F);
+  cv::Mat translation = cv::Mat::eye(3, 3, CV_64F);
+  translation.at<double>(0, 2) = 35;
+  translation.at<double>(1, 2) = -20;
+  cv::Mat rotation = (cv::Mat_<double>(3, 3) << 0, -1, 10, 1, 0, 5, 0, 0, 1);
+  for (const cv::Mat* transform : {&identity, &translation, &rotation}) {
+    combine_grids::MergingPipeline merger;
+    merger.feed(maps.begin(), maps.end());
+    ASSERT_FALSE(merger.known_rois_[0].empty());
+    ASSERT_NE(merger.known_rois_[0].tl(), cv::Point());
+    merger.transforms_ = {*transform};
+
+    // uncropped warp is the reference
+    cv::Mat warped;
+    combine_grids::internal::GridWarper warper;
+    cv::Rect roi = warper.warp(merger.images_[0], *transform, warped);
+    cv::Mat expected(warped.size(), CV_8S, warped.ptr());
+    auto checkComposed = [&](const nav_msgs::OccupancyGrid& composed) {
+      const cv::Rect& composed_roi = merger.composed_roi_;
+      ASSERT_EQ(composed.info.width, size_t(composed_roi.width));
+      ASSERT_EQ(composed.info.height, size_t(composed_roi.height));
+      ASSERT_EQ(composed_roi & roi, composed_roi);
+      cv::Mat result(composed_roi.size(), CV_8S,
+                     const_cast<std::int8_t*>(composed.data.data()));
+      cv::Mat reference = expected(composed_roi - roi.tl());
+      EXPECT_EQ(cv::countNonZero(result != reference), 0);
+      // all known cells of the grid are composed
+      EXPECT_EQ(cv::countNonZero(result != -1),
+                cv::countNonZero(expected != -1));
+    };
+    auto composed = merger.composeGrids();
+    EXPECT_VALID_GRID(composed);
+    checkComposed(*composed);
+
+    // update inside the known area recomposes the same cells
+    map->data[90 * 300 + 140] = map->data[90 * 300 + 140] ? 0 : 100;
+    merger.feed(maps.begin(), maps.end());
+    merger.transforms_ = {*transform};
+    warper.warp(merger.images_[0], *transform, warped);
+    expected = cv::Mat(warped.size(), CV_8S, warped.ptr());
+    composed = merger.composeGrids({cv::Rect(140, 90, 1, 1)});
+    EXPECT_VALID_GRID(composed);
+    checkComposed(*composed);
+  }
+}
+
 TEST(MergingPipeline, transformsRoundTrip)
 {
   auto map = loadMap(hector_maps[0]);
@@ -0,0 +1,214 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore_common/grid_codec.h>
+#include <map_merge/tiled_grid.h>
+#include <gtest/gtest.h>
+
+static nav_msgs::OccupancyGridConstPtr makeMap(unsigned int width,
+                                               unsigned int height)
+{
+  nav_msgs::OccupancyGridPtr map(new nav_msgs::OccupancyGrid());
+  map->info.width = width;
+  map->info.height = height;
+  map->info.resolution = 0.05f;
+  map->data.resize(size_t(width) * height);
+  for (size_t i = 0; i < map->data.size(); ++i) {
+    map->data[i] = static_cast<signed char>(i % 101);
+  }
+  return map;
+}
+
+static map_msgs::OccupancyGridUpdate makeUpdate(int x, int y,
+                                                unsigned int width,
+                                                unsigned int height,
+                                                signed char value)
+{
+  map_msgs::OccupancyGridUpdate update;
+  update.x = x;
+  update.y = y;
+  update.width = width;
+  update.height = height;
+  update.data.assign(size_t(width) * height, value);
+  update.header.stamp = ros::Time(1.);
+  return update;
+}
+
+TEST(TiledGrid, aliasesFullMap)
+{
+  auto map = makeMap(100, 70);
+  map_merge::TiledGrid grid(16);
+  EXPECT_TRUE(grid.empty());
+  grid.reset(map);
+  EXPECT_FALSE(grid.empty());
+  ASSERT_EQ(grid.bands(), 5);
+  for (size_t band = 0; band < grid.bands(); ++band) {
+    EXPECT_EQ(grid.bandData(band), map->data.data() + band * 16 * 100);
+  }
+
+  // unmodified map is not copied
+  map_merge::GridAssembler assembler;
+  EXPECT_EQ(assembler.update(grid), map);
+}
+
+TEST(TiledGrid, clonesOnlySharedTouchedBands)
+{
+  auto map = makeMap(100, 70);
+  map_merge::TiledGrid grid(16);
+  grid.reset(map);
+
+  // update in the second band, bands of the message are never written
+  EXPECT_EQ(grid.update(makeUpdate(10, 20, 5, 4, 42)), cv::Rect(10, 20, 5, 4));
+  EXPECT_EQ(grid.source(), nullptr);
+  EXPECT_EQ(grid.bandData(0), map->data.data());
+  EXPECT_NE(grid.bandData(1), map->data.data() + 16 * 100);
+  EXPECT_EQ(map->data[20 * 100 + 10], static_cast<signed char>(2010 % 101));
+  EXPECT_EQ(grid.bandData(1)[4 * 100 + 10], 42);
+
+  // owned band is written in place
+  const std::int8_t* owned = grid.bandData(1);
+  grid.update(makeUpdate(0, 16, 3, 1, 7));
+  EXPECT_EQ(grid.bandData(1), owned);
+
+  // band shared with a snapshot is cloned, snapshot keeps its content
+  map_merge::TiledGrid snapshot = grid;
+  auto version = snapshot.bandVersion(1);
+  grid.update(makeUpdate(0, 16, 3, 1, 9));
+  EXPECT_NE(grid.bandData(1), owned);
+  EXPECT_EQ(snapshot.bandData(1), owned);
+  EXPECT_EQ(snapshot.bandVersion(1), version);
+  EXPECT_EQ(snapshot.bandData(1)[0], 7);
+  EXPECT_EQ(grid.bandData(1)[0], 9);
+  EXPECT_EQ(grid.bandData(2), snapshot.bandData(2));
+}
+
+TEST(TiledGrid, clipsUpdates)
+{
+  auto map = makeMap(100, 70);
+  map_merge::TiledGrid grid(16);
+  EXPECT_TRUE(grid.update(makeUpdate(0, 0, 1, 1, 1)).empty());
+  grid.reset(map);
+
+  EXPECT_EQ(grid.update(makeUpdate(95, 60, 10, 20, 1)),
+            cv::Rect(95, 60, 5, 10));
+  EXPECT_EQ(grid.bandData(4)[(69 - 64) * 100 + 99], 1);
+  EXPECT_TRUE(grid.update(makeUpdate(100, 0, 10, 10, 1)).empty());
+  EXPECT_TRUE(grid.update(makeUpdate(-1, 0, 10, 10, 1)).empty());
+}
+
+TEST(TiledGrid, assemblesChangedBands)
+{
+  auto map = makeMap(100, 70);
+  map_merge::TiledGrid grid(16);
+  grid.reset(map);
+  grid.update(makeUpdate(10, 20, 5, 4, 42));
+
+  map_merge::GridAssembler assembler;
+  auto assembled = assembler.update(grid);
+  ASSERT_TRUE(static_cast<bool>(assembled));
+  ASSERT_EQ(assembled->data.size(), map->data.size());
+  EXPECT_EQ(assembled->info.width, 100);
+  EXPECT_EQ(assembled->header.stamp, ros::Time(1.));
+
+  std::vector<signed char> expected = map->data;
+  for (size_t y = 20; y < 24; ++y) {
+    for (size_t x = 10; x < 15; ++x) {
+      expected[y * 100 + x] = 42;
+    }
+  }
+  EXPECT_EQ(assembled->data, expected);
+
+  // later updates are copied into the same grid
+  grid.update(makeUpdate(0, 69, 100, 1, -1));
+  auto reassembled = assembler.update(grid);
+  EXPECT_EQ(reassembled, assembled);
+  std::fill(expected.begin() + 69 * 100, expected.end(), -1);
+  EXPECT_EQ(reassembled->data, expected);
+
+  // new full map is returned as is
+  auto new_map = makeMap(50, 50);
+  grid.reset(new_map);
+  EXPECT_EQ(assembler.update(grid), new_map);
+  grid.update(makeUpdate(0, 0, 1, 1, 5));
+  auto resized = assembler.update(grid);
+  ASSERT_EQ(resized->data.size(), 2500);
+  EXPECT_EQ(resized->data[0], 5);
+  EXPECT_EQ(resized->data[2499], new_map->data[2499]);
+}
+
+TEST(TiledGrid, decodesEncodedMaps)
+{
+  auto map = makeMap(100, 70);
+  nav_msgs::OccupancyGrid encoded;
+  encoded.info = map->info;
+  explore_common::grid_codec::encode(map->data.data(), 100, 100, 70,
+                                     encoded.data, 50, 10);
+  map_merge::TiledGrid grid(16);
+  ASSERT_TRUE(grid.resetEncoded(encoded));
+  EXPECT_EQ(grid.source(), nullptr);
+  ASSERT_EQ(grid.bands(), 5);
+  EXPECT_EQ(grid.bandData(0)[1], 0);
+  EXPECT_EQ(grid.bandData(0)[60], 100);
+
+  // update rows span two bands
+  map_msgs::OccupancyGridUpdate update = makeUpdate(10, 14, 5, 4, -1);
+  map_msgs::OccupancyGridUpdate encoded_update = update;
+  explore_common::grid_codec::encode(update.data.data(), 5, 5, 4,
+                                     encoded_update.data);
+  map_merge::TiledGrid snapshot = grid;
+  EXPECT_EQ(grid.updateEncoded(encoded_update), cv::Rect(10, 14, 5, 4));
+  EXPECT_EQ(grid.bandData(0)[14 * 100 + 10], -1);
+  EXPECT_EQ(grid.bandData(1)[1 * 100 + 14], -1);
+  EXPECT_EQ(grid.bandData(1)[1 * 100 + 15], 100);
+  EXPECT_NE(snapshot.bandData(0)[14 * 100 + 10], -1);
+  EXPECT_EQ(grid.bandData(2), snapshot.bandData(2));
+
+  // updates outside of the grid and malformed payloads are rejected
+  encoded_update.x = 97;
+  EXPECT_TRUE(grid.updateEncoded(encoded_update).empty());
+  encoded_update.x = 10;
+  encoded_update.data.pop_back();
+  EXPECT_TRUE(grid.updateEncoded(encoded_update).empty());
+  encoded.data.resize(encoded.data.size() / 2);
+  EXPECT_FALSE(grid.resetEncoded(encoded));
+  EXPECT_EQ(grid.bands(), 0);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}